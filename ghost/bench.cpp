@@ -0,0 +1,697 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+
+// bench - checks and benchmarks the hot code paths that have more than one implementation
+// usage: bench [crc32|sha1|bytebuffer]
+// each test compares the fast paths against a simple reference implementation on random data and prints the throughput of each, it returns 1 if any result differs
+
+#include "ghost.h"
+#include "crc32.h"
+#include "sha1.h"
+#include "socket.h"
+
+#include <stdio.h>
+#include <time.h>
+
+// the socket code needs these but we never run the main loop so they don't have to be accurate
+
+uint32_t GetTime( )
+{
+	return time( NULL );
+}
+
+uint32_t GetTicks( )
+{
+	return (uint32_t)( (double)clock( ) * 1000 / CLOCKS_PER_SEC );
+}
+
+// a small xorshift generator so every run tests the same data no matter what rand( ) does on this platform
+
+uint32_t g_Random = 2463534242UL;
+
+uint32_t Random( )
+{
+	g_Random ^= g_Random << 13;
+	g_Random ^= g_Random >> 17;
+	g_Random ^= g_Random << 5;
+	return g_Random;
+}
+
+void RandomFill( unsigned char *data, uint32_t length )
+{
+	for( uint32_t i = 0; i < length; ++i )
+		data[i] = Random( ) & 0xFF;
+}
+
+double GetSeconds( clock_t start )
+{
+	return (double)( clock( ) - start ) / CLOCKS_PER_SEC;
+}
+
+void PrintThroughput( string name, double bytes, double seconds )
+{
+	if( seconds > 0.0 )
+		printf( "  %-24s %10.1f MB/s\n", name.c_str( ), bytes / seconds / 1048576.0 );
+	else
+		printf( "  %-24s (too fast to measure)\n", name.c_str( ) );
+}
+
+//
+// crc32
+//
+
+// the reference CRC, one bit at a time with the reflected polynomial
+
+uint32_t ReferenceCRC( uint32_t crc, const unsigned char *data, uint32_t length )
+{
+	for( uint32_t i = 0; i < length; ++i )
+	{
+		crc ^= data[i];
+
+		for( int j = 0; j < 8; ++j )
+			crc = ( crc >> 1 ) ^ ( 0xEDB88320 & ( 0 - ( crc & 1 ) ) );
+	}
+
+	return crc;
+}
+
+uint32_t CheckCRC( CCRC32 &CRC, BYTEARRAY &data )
+{
+	uint32_t Errors = 0;
+
+	// random offsets (so every alignment is tested) and lengths (short ones to test the tails, long ones to test the folding)
+
+	for( uint32_t i = 0; i < 20000; ++i )
+	{
+		uint32_t Length = ( i % 4 == 0 ) ? Random( ) % 65536 : Random( ) % 512;
+		uint32_t Offset = Random( ) % ( data.size( ) - Length );
+		uint32_t Expected = ReferenceCRC( 0xFFFFFFFF, &data[Offset], Length ) ^ 0xFFFFFFFF;
+
+		if( CRC.FullCRC( &data[Offset], Length ) != Expected )
+		{
+			if( Errors++ < 10 )
+				printf( "  FullCRC mismatch at offset %u length %u\n", Offset, Length );
+		}
+	}
+
+	// chained PartialCRC calls with random split points must give the same CRC as one call
+
+	for( uint32_t i = 0; i < 2000; ++i )
+	{
+		uint32_t Length = Random( ) % 262144;
+		uint32_t Offset = Random( ) % ( data.size( ) - Length );
+		uint32_t Expected = ReferenceCRC( 0xFFFFFFFF, &data[Offset], Length ) ^ 0xFFFFFFFF;
+		uint32_t CRCValue = 0xFFFFFFFF;
+		uint32_t Done = 0;
+
+		while( Done < Length )
+		{
+			uint32_t Part = ( Random( ) % 2 ) ? Random( ) % 64 : Random( ) % 16384;
+
+			if( Part > Length - Done )
+				Part = Length - Done;
+
+			CRC.PartialCRC( &CRCValue, &data[Offset + Done], Part );
+			Done += Part;
+		}
+
+		if( ( CRCValue ^ 0xFFFFFFFF ) != Expected )
+		{
+			if( Errors++ < 10 )
+				printf( "  chained PartialCRC mismatch at offset %u length %u\n", Offset, Length );
+		}
+	}
+
+	return Errors;
+}
+
+double BenchCRC( CCRC32 &CRC, BYTEARRAY &data, uint32_t rounds )
+{
+	uint32_t Sum = 0;
+	clock_t Start = clock( );
+
+	for( uint32_t i = 0; i < rounds; ++i )
+		Sum += CRC.FullCRC( &data[0], data.size( ) );
+
+	double Seconds = GetSeconds( Start );
+
+	// use the result so the compiler can't throw the loop away
+
+	if( Sum == 1 )
+		printf( "\n" );
+
+	return Seconds;
+}
+
+uint32_t TestCRC32( )
+{
+	printf( "crc32\n" );
+
+	BYTEARRAY Data( 1048576 );
+	RandomFill( &Data[0], Data.size( ) );
+	uint32_t Errors = 0;
+
+	// the well known check value of "123456789"
+
+	CCRC32 CRC;
+	CRC.Initialize( );
+	unsigned char Check[] = "123456789";
+
+	if( CRC.FullCRC( Check, 9 ) != 0xCBF43926 )
+	{
+		printf( "  check value mismatch\n" );
+		++Errors;
+	}
+
+	CCRC32 Slice;
+	Slice.Initialize( false );
+	uint32_t SliceErrors = CheckCRC( Slice, Data );
+	printf( "  slice-by-8               %s\n", SliceErrors ? "FAILED" : "ok" );
+	Errors += SliceErrors;
+
+	if( CRC.GetCLMUL( ) )
+	{
+		uint32_t CLMULErrors = CheckCRC( CRC, Data );
+		printf( "  carry-less multiply      %s\n", CLMULErrors ? "FAILED" : "ok" );
+		Errors += CLMULErrors;
+	}
+	else
+		printf( "  carry-less multiply      not supported by this CPU\n" );
+
+	// throughput over a 1 MB buffer
+
+	uint32_t Rounds = 256;
+	clock_t Start = clock( );
+	uint32_t Sum = 0;
+
+	for( uint32_t i = 0; i < Rounds / 16; ++i )
+		Sum += ReferenceCRC( 0xFFFFFFFF, &Data[0], Data.size( ) );
+
+	PrintThroughput( "reference", (double)Data.size( ) * ( Rounds / 16 ) + ( Sum == 1 ? 1 : 0 ), GetSeconds( Start ) );
+	PrintThroughput( "slice-by-8", (double)Data.size( ) * Rounds, BenchCRC( Slice, Data, Rounds ) );
+
+	if( CRC.GetCLMUL( ) )
+		PrintThroughput( "carry-less multiply", (double)Data.size( ) * Rounds, BenchCRC( CRC, Data, Rounds ) );
+
+	return Errors;
+}
+
+//
+// sha1
+//
+
+// the SHA1 implementation we used before the SHA extensions and multiple block versions were added, one block at a time with the macro rounds from sha1.h
+
+class COldSHA1
+{
+public:
+	typedef CSHA1 :: SHA1_WORKSPACE_BLOCK SHA1_WORKSPACE_BLOCK;
+
+	uint32_t m_state[5];
+	uint32_t m_count[2];
+	unsigned char m_buffer[64];
+	unsigned char m_digest[20];
+
+	COldSHA1( )
+	{
+		m_state[0] = 0x67452301;
+		m_state[1] = 0xEFCDAB89;
+		m_state[2] = 0x98BADCFE;
+		m_state[3] = 0x10325476;
+		m_state[4] = 0xC3D2E1F0;
+		m_count[0] = 0;
+		m_count[1] = 0;
+	}
+
+	void Transform( uint32_t state[5], unsigned char buffer[64] )
+	{
+		uint32_t a = 0, b = 0, c = 0, d = 0, e = 0;
+
+		SHA1_WORKSPACE_BLOCK *block;
+		static unsigned char workspace[64];
+		block = (SHA1_WORKSPACE_BLOCK *)workspace;
+		memcpy( block, buffer, 64 );
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+
+		R0(a,b,c,d,e, 0); R0(e,a,b,c,d, 1); R0(d,e,a,b,c, 2); R0(c,d,e,a,b, 3);
+		R0(b,c,d,e,a, 4); R0(a,b,c,d,e, 5); R0(e,a,b,c,d, 6); R0(d,e,a,b,c, 7);
+		R0(c,d,e,a,b, 8); R0(b,c,d,e,a, 9); R0(a,b,c,d,e,10); R0(e,a,b,c,d,11);
+		R0(d,e,a,b,c,12); R0(c,d,e,a,b,13); R0(b,c,d,e,a,14); R0(a,b,c,d,e,15);
+		R1(e,a,b,c,d,16); R1(d,e,a,b,c,17); R1(c,d,e,a,b,18); R1(b,c,d,e,a,19);
+		R2(a,b,c,d,e,20); R2(e,a,b,c,d,21); R2(d,e,a,b,c,22); R2(c,d,e,a,b,23);
+		R2(b,c,d,e,a,24); R2(a,b,c,d,e,25); R2(e,a,b,c,d,26); R2(d,e,a,b,c,27);
+		R2(c,d,e,a,b,28); R2(b,c,d,e,a,29); R2(a,b,c,d,e,30); R2(e,a,b,c,d,31);
+		R2(d,e,a,b,c,32); R2(c,d,e,a,b,33); R2(b,c,d,e,a,34); R2(a,b,c,d,e,35);
+		R2(e,a,b,c,d,36); R2(d,e,a,b,c,37); R2(c,d,e,a,b,38); R2(b,c,d,e,a,39);
+		R3(a,b,c,d,e,40); R3(e,a,b,c,d,41); R3(d,e,a,b,c,42); R3(c,d,e,a,b,43);
+		R3(b,c,d,e,a,44); R3(a,b,c,d,e,45); R3(e,a,b,c,d,46); R3(d,e,a,b,c,47);
+		R3(c,d,e,a,b,48); R3(b,c,d,e,a,49); R3(a,b,c,d,e,50); R3(e,a,b,c,d,51);
+		R3(d,e,a,b,c,52); R3(c,d,e,a,b,53); R3(b,c,d,e,a,54); R3(a,b,c,d,e,55);
+		R3(e,a,b,c,d,56); R3(d,e,a,b,c,57); R3(c,d,e,a,b,58); R3(b,c,d,e,a,59);
+		R4(a,b,c,d,e,60); R4(e,a,b,c,d,61); R4(d,e,a,b,c,62); R4(c,d,e,a,b,63);
+		R4(b,c,d,e,a,64); R4(a,b,c,d,e,65); R4(e,a,b,c,d,66); R4(d,e,a,b,c,67);
+		R4(c,d,e,a,b,68); R4(b,c,d,e,a,69); R4(a,b,c,d,e,70); R4(e,a,b,c,d,71);
+		R4(d,e,a,b,c,72); R4(c,d,e,a,b,73); R4(b,c,d,e,a,74); R4(a,b,c,d,e,75);
+		R4(e,a,b,c,d,76); R4(d,e,a,b,c,77); R4(c,d,e,a,b,78); R4(b,c,d,e,a,79);
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+	}
+
+	void Update( unsigned char *data, unsigned int len )
+	{
+		uint32_t i = 0, j = 0;
+
+		j = ( m_count[0] >> 3 ) & 63;
+
+		if( ( m_count[0] += len << 3 ) < ( len << 3 ) )
+			m_count[1]++;
+
+		m_count[1] += ( len >> 29 );
+
+		if( ( j + len ) > 63 )
+		{
+			memcpy( &m_buffer[j], data, ( i = 64 - j ) );
+			Transform( m_state, m_buffer );
+
+			for( ; i + 63 < len; i += 64 )
+				Transform( m_state, &data[i] );
+
+			j = 0;
+		}
+		else
+			i = 0;
+
+		memcpy( &m_buffer[j], &data[i], len - i );
+	}
+
+	void Final( )
+	{
+		unsigned char finalcount[8];
+
+		for( uint32_t i = 0; i < 8; ++i )
+			finalcount[i] = (unsigned char)( ( m_count[( i >= 4 ? 0 : 1 )] >> ( ( 3 - ( i & 3 ) ) * 8 ) ) & 255 );
+
+		Update( (unsigned char *)"\200", 1 );
+
+		while( ( m_count[0] & 504 ) != 448 )
+			Update( (unsigned char *)"\0", 1 );
+
+		Update( finalcount, 8 );
+
+		for( uint32_t i = 0; i < 20; ++i )
+			m_digest[i] = (unsigned char)( ( m_state[i >> 2] >> ( ( 3 - ( i & 3 ) ) * 8 ) ) & 255 );
+	}
+};
+
+string DigestToHex( const unsigned char *digest )
+{
+	char Hex[41];
+
+	for( int i = 0; i < 20; ++i )
+		sprintf( Hex + i * 2, "%02x", digest[i] );
+
+	return string( Hex, 40 );
+}
+
+string HashSHA1( CSHA1 &SHA, unsigned char *data, uint32_t length )
+{
+	unsigned char Digest[20];
+	SHA.Reset( );
+	SHA.Update( data, length );
+	SHA.Final( );
+	SHA.GetHash( Digest );
+	return DigestToHex( Digest );
+}
+
+string HashOldSHA1( unsigned char *data, uint32_t length )
+{
+	COldSHA1 SHA;
+	SHA.Update( data, length );
+	SHA.Final( );
+	return DigestToHex( SHA.m_digest );
+}
+
+uint32_t CheckSHA1( CSHA1 &SHA, BYTEARRAY &data )
+{
+	uint32_t Errors = 0;
+
+	// the test vectors from FIPS PUB 180-1
+
+	string Million( 1000000, 'a' );
+	string Vectors[3][2] = {
+		{ "abc", "a9993e364706816aba3e25717850c26c9cd0d89d" },
+		{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "84983e441c3bd26ebaae4aa1f95129e5e54670f1" },
+		{ Million, "34aa973cd4c4daa4f61eeb2bdbad27316534016f" } };
+
+	for( int i = 0; i < 3; ++i )
+	{
+		if( HashSHA1( SHA, (unsigned char *)Vectors[i][0].data( ), Vectors[i][0].size( ) ) != Vectors[i][1] )
+		{
+			++Errors;
+			printf( "  test vector %d mismatch\n", i + 1 );
+		}
+	}
+
+	// random lengths hashed with Update called on random pieces must match the old implementation hashing everything at once
+
+	for( uint32_t i = 0; i < 2000; ++i )
+	{
+		uint32_t Length = ( i % 4 == 0 ) ? Random( ) % 65536 : Random( ) % 1024;
+		uint32_t Offset = Random( ) % ( data.size( ) - Length );
+		string Expected = HashOldSHA1( &data[Offset], Length );
+		unsigned char Digest[20];
+		uint32_t Done = 0;
+		SHA.Reset( );
+
+		while( Done < Length )
+		{
+			uint32_t Part = ( Random( ) % 2 ) ? Random( ) % 80 : Random( ) % 8192;
+
+			if( Part > Length - Done )
+				Part = Length - Done;
+
+			SHA.Update( &data[Offset + Done], Part );
+			Done += Part;
+		}
+
+		SHA.Final( );
+		SHA.GetHash( Digest );
+
+		if( DigestToHex( Digest ) != Expected )
+		{
+			if( Errors++ < 10 )
+				printf( "  split Update mismatch at offset %u length %u\n", Offset, Length );
+		}
+	}
+
+	return Errors;
+}
+
+double BenchSHA1( CSHA1 &SHA, BYTEARRAY &data, uint32_t rounds )
+{
+	clock_t Start = clock( );
+	string Sum;
+
+	for( uint32_t i = 0; i < rounds; ++i )
+		Sum = HashSHA1( SHA, &data[0], data.size( ) );
+
+	return GetSeconds( Start );
+}
+
+uint32_t TestSHA1( )
+{
+	printf( "sha1\n" );
+
+	BYTEARRAY Data( 1048576 );
+	RandomFill( &Data[0], Data.size( ) );
+	uint32_t Errors = 0;
+
+	// the old implementation is the reference for the split tests so check it against the test vectors too
+
+	if( HashOldSHA1( (unsigned char *)"abc", 3 ) != "a9993e364706816aba3e25717850c26c9cd0d89d" )
+	{
+		printf( "  old implementation test vector mismatch\n" );
+		++Errors;
+	}
+
+	CSHA1 Scalar( false );
+	uint32_t ScalarErrors = CheckSHA1( Scalar, Data );
+	printf( "  scalar                   %s\n", ScalarErrors ? "FAILED" : "ok" );
+	Errors += ScalarErrors;
+
+	CSHA1 SHANI;
+
+	if( SHANI.GetSHANI( ) )
+	{
+		uint32_t SHANIErrors = CheckSHA1( SHANI, Data );
+		printf( "  SHA extensions           %s\n", SHANIErrors ? "FAILED" : "ok" );
+		Errors += SHANIErrors;
+	}
+	else
+		printf( "  SHA extensions           not supported by this CPU\n" );
+
+	// throughput over a 1 MB buffer
+
+	uint32_t Rounds = 64;
+	clock_t Start = clock( );
+	string Sum;
+
+	for( uint32_t i = 0; i < Rounds; ++i )
+		Sum = HashOldSHA1( &Data[0], Data.size( ) );
+
+	PrintThroughput( "old", (double)Data.size( ) * Rounds, GetSeconds( Start ) );
+	PrintThroughput( "scalar", (double)Data.size( ) * Rounds, BenchSHA1( Scalar, Data, Rounds ) );
+
+	if( SHANI.GetSHANI( ) )
+		PrintThroughput( "SHA extensions", (double)Data.size( ) * Rounds, BenchSHA1( SHANI, Data, Rounds ) );
+
+	return Errors;
+}
+
+//
+// bytebuffer
+//
+
+// a socket's receive and send queues before and after CByteBuffer
+// the receive test appends what recv returned and parses as many packets as are complete, the send test keeps a backlog queued (like a map download) and removes whatever a partial send took
+// both return a checksum of the bytes in the order they were consumed so the two versions can be compared
+
+uint32_t StringReceive( BYTEARRAY &data, vector<uint32_t> &chunks, vector<uint32_t> &packets )
+{
+	string Buffer;
+	uint32_t Sum = 0;
+	uint32_t Position = 0;
+	uint32_t Packet = 0;
+
+	for( vector<uint32_t> :: iterator i = chunks.begin( ); i != chunks.end( ); ++i )
+	{
+		Buffer += string( (char *)&data[Position], *i );
+		Position += *i;
+
+		while( Packet < packets.size( ) && Buffer.size( ) >= packets[Packet] )
+		{
+			Sum = Sum * 31 + (unsigned char)Buffer[0] + (unsigned char)Buffer[packets[Packet] - 1];
+			Buffer = Buffer.substr( packets[Packet] );
+			++Packet;
+		}
+	}
+
+	return Sum;
+}
+
+uint32_t ByteBufferReceive( BYTEARRAY &data, vector<uint32_t> &chunks, vector<uint32_t> &packets )
+{
+	CByteBuffer Buffer;
+	uint32_t Sum = 0;
+	uint32_t Position = 0;
+	uint32_t Packet = 0;
+
+	for( vector<uint32_t> :: iterator i = chunks.begin( ); i != chunks.end( ); ++i )
+	{
+		memcpy( Buffer.Reserve( *i ), &data[Position], *i );
+		Buffer.Commit( *i );
+		Position += *i;
+
+		while( Packet < packets.size( ) && Buffer.GetSize( ) >= packets[Packet] )
+		{
+			unsigned char *Bytes = (unsigned char *)Buffer.GetData( );
+			Sum = Sum * 31 + Bytes[0] + Bytes[packets[Packet] - 1];
+			Buffer.Consume( packets[Packet] );
+			++Packet;
+		}
+	}
+
+	return Sum;
+}
+
+uint32_t StringSend( BYTEARRAY &data, vector<uint32_t> &packets, vector<uint32_t> &sends, uint32_t backlog )
+{
+	string Buffer;
+	uint32_t Sum = 0;
+	uint32_t Position = 0;
+	uint32_t Packet = 0;
+
+	for( vector<uint32_t> :: iterator i = sends.begin( ); i != sends.end( ); ++i )
+	{
+		while( Packet < packets.size( ) && Buffer.size( ) < backlog )
+		{
+			Buffer += string( (char *)&data[Position], packets[Packet] );
+			Position += packets[Packet++];
+		}
+
+		uint32_t Sent = *i < Buffer.size( ) ? *i : Buffer.size( );
+
+		if( Sent > 0 )
+		{
+			Sum = Sum * 31 + (unsigned char)Buffer[0] + (unsigned char)Buffer[Sent - 1];
+			Buffer = Buffer.substr( Sent );
+		}
+	}
+
+	return Sum;
+}
+
+uint32_t ByteBufferSend( BYTEARRAY &data, vector<uint32_t> &packets, vector<uint32_t> &sends, uint32_t backlog )
+{
+	CByteBuffer Buffer;
+	uint32_t Sum = 0;
+	uint32_t Position = 0;
+	uint32_t Packet = 0;
+
+	for( vector<uint32_t> :: iterator i = sends.begin( ); i != sends.end( ); ++i )
+	{
+		while( Packet < packets.size( ) && Buffer.GetSize( ) < backlog )
+		{
+			Buffer.Append( (char *)&data[Position], packets[Packet] );
+			Position += packets[Packet++];
+		}
+
+		uint32_t Sent = *i < Buffer.GetSize( ) ? *i : Buffer.GetSize( );
+
+		if( Sent > 0 )
+		{
+			unsigned char *Bytes = (unsigned char *)Buffer.GetData( );
+			Sum = Sum * 31 + Bytes[0] + Bytes[Sent - 1];
+			Buffer.Consume( Sent );
+		}
+	}
+
+	return Sum;
+}
+
+uint32_t TestByteBuffer( )
+{
+	printf( "bytebuffer\n" );
+
+	BYTEARRAY Data( 16777216 );
+	RandomFill( &Data[0], Data.size( ) );
+	uint32_t Errors = 0;
+
+	// split the data into packets of 4 to 1500 bytes
+
+	vector<uint32_t> Packets;
+	uint32_t Total = 0;
+
+	while( true )
+	{
+		uint32_t Length = 4 + Random( ) % 1497;
+
+		if( Total + Length > Data.size( ) )
+			break;
+
+		Packets.push_back( Length );
+		Total += Length;
+	}
+
+	// receive it in chunks of up to 1024 bytes (the old receive buffer size) like a busy connection
+
+	vector<uint32_t> Chunks;
+	uint32_t Received = 0;
+
+	while( Received < Total )
+	{
+		uint32_t Length = 1 + Random( ) % 1024;
+
+		if( Length > Total - Received )
+			Length = Total - Received;
+
+		Chunks.push_back( Length );
+		Received += Length;
+	}
+
+	clock_t Start = clock( );
+	uint32_t StringSum = StringReceive( Data, Chunks, Packets );
+	PrintThroughput( "receive string", Total, GetSeconds( Start ) );
+	Start = clock( );
+	uint32_t ByteBufferSum = ByteBufferReceive( Data, Chunks, Packets );
+	PrintThroughput( "receive CByteBuffer", Total, GetSeconds( Start ) );
+
+	if( StringSum != ByteBufferSum )
+	{
+		printf( "  receive checksum mismatch\n" );
+		++Errors;
+	}
+
+	// send it with up to 256 KB queued (a map download) in partial sends of up to 16 KB
+
+	vector<uint32_t> Sends;
+	uint32_t Sent = 0;
+
+	while( Sent < Total )
+	{
+		uint32_t Length = 1 + Random( ) % 16384;
+		Sends.push_back( Length );
+		Sent += Length;
+	}
+
+	// and a few more to drain what's left of the backlog
+
+	for( uint32_t i = 0; i < 64; ++i )
+		Sends.push_back( 16384 );
+
+	Start = clock( );
+	StringSum = StringSend( Data, Packets, Sends, 262144 );
+	PrintThroughput( "send string", Total, GetSeconds( Start ) );
+	Start = clock( );
+	ByteBufferSum = ByteBufferSend( Data, Packets, Sends, 262144 );
+	PrintThroughput( "send CByteBuffer", Total, GetSeconds( Start ) );
+
+	if( StringSum != ByteBufferSum )
+	{
+		printf( "  send checksum mismatch\n" );
+		++Errors;
+	}
+
+	return Errors;
+}
+
+int main( int argc, char **argv )
+{
+	string Test = argc > 1 ? argv[1] : string( );
+	uint32_t Errors = 0;
+
+	if( !Test.empty( ) && Test != "crc32" && Test != "sha1" && Test != "bytebuffer" )
+	{
+		fprintf( stderr, "usage: bench [crc32|sha1|bytebuffer]\n" );
+		return 1;
+	}
+
+	if( Test.empty( ) || Test == "crc32" )
+		Errors += TestCRC32( );
+
+	if( Test.empty( ) || Test == "sha1" )
+		Errors += TestSHA1( );
+
+	if( Test.empty( ) || Test == "bytebuffer" )
+		Errors += TestByteBuffer( );
+
+	printf( Errors ? "FAILED\n" : "ok\n" );
+	return Errors ? 1 : 0;
+}
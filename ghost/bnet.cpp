@@ -23,6 +23,7 @@
 #include "config.h"
 #include "language.h"
 #include "socket.h"
+#include "reactor.h"
 #include "commandpacket.h"
 #include "ghostdb.h"
 #include "bncsutilinterface.h"
@@ -30,11 +31,14 @@
 #include "bnetprotocol.h"
 #include "bnet.h"
 #include "map.h"
+#include "maploader.h"
 #include "packed.h"
 #include "savegame.h"
 #include "replay.h"
 #include "gameprotocol.h"
 #include "game_base.h"
+#include "gameworker.h"
+#include "governor.h"
 
 #include <boost/filesystem.hpp>
 #include <iostream>
@@ -207,23 +211,7 @@ BYTEARRAY CBNET :: GetUniqueName( )
 	return m_Protocol->GetUniqueName( );
 }
 
-unsigned int CBNET :: SetFD( void *fd, void *send_fd, int *nfds )
-{
-	unsigned int NumFDs = 0;
-
-	if( !m_Socket->HasError( ) && m_Socket->GetConnected( ) )
-	{
-		m_Socket->SetFD( (fd_set *)fd, (fd_set *)send_fd, nfds );
-		++NumFDs;
-
-		if( m_BNLSClient )
-			NumFDs += m_BNLSClient->SetFD( fd, send_fd, nfds );
-	}
-
-	return NumFDs;
-}
-
-bool CBNET :: Update( void *fd, void *send_fd )
+bool CBNET :: Update( )
 {
 	//
 	// update callables
@@ -502,7 +490,7 @@ bool CBNET :: Update( void *fd, void *send_fd )
 	{
 		// the socket is connected and everything appears to be working properly
 
-		m_Socket->DoRecv( (fd_set *)fd );
+		m_Socket->DoRecv( );
 		ExtractPackets( );
 		ProcessPackets( );
 
@@ -510,7 +498,7 @@ bool CBNET :: Update( void *fd, void *send_fd )
 
 		if( m_BNLSClient )
 		{
-			if( m_BNLSClient->Update( fd, send_fd ) )
+			if( m_BNLSClient->Update( ) )
 			{
 				BOOST_LOG_TRIVIAL(info) << m_ServerAlias + ": deleting BNLS client";
 				delete m_BNLSClient;
@@ -576,7 +564,7 @@ bool CBNET :: Update( void *fd, void *send_fd )
 			m_LastNullTime = GetTime( );
 		}
 
-		m_Socket->DoSend( (fd_set *)send_fd );
+		m_Socket->DoSend( );
 		return m_Exiting;
 	}
 
@@ -589,10 +577,11 @@ bool CBNET :: Update( void *fd, void *send_fd )
 			// the connection attempt completed
 
 			BOOST_LOG_TRIVIAL(info) << "[BNET: " + m_ServerAlias + "] connected";
+			m_GHost->m_Reactor->Add( m_Socket );
 			m_GHost->EventBNETConnected( this );
 			m_Socket->PutBytes( m_Protocol->SEND_PROTOCOL_INITIALIZE_SELECTOR( ) );
 			m_Socket->PutBytes( m_Protocol->SEND_SID_AUTH_INFO( m_War3Version, m_GHost->m_TFT, m_LocaleID, m_CountryAbbrev, m_Country ) );
-			m_Socket->DoSend( (fd_set *)send_fd );
+			m_Socket->DoSend( );
 			m_LastNullTime = GetTime( );
 			m_LastOutPacketTicks = GetTicks( );
 
@@ -669,29 +658,31 @@ bool CBNET :: Update( void *fd, void *send_fd )
 void CBNET :: ExtractPackets( )
 {
 	// extract as many packets as possible from the socket's receive buffer and put them in the m_Packets queue
+	// the packets are framed in place so each packet's bytes are only copied once, into its CCommandPacket
 
-	string *RecvBuffer = m_Socket->GetBytes( );
-	BYTEARRAY Bytes = UTIL_CreateByteArray( (unsigned char *)RecvBuffer->c_str( ), RecvBuffer->size( ) );
+	CByteBuffer *RecvBuffer = m_Socket->GetBytes( );
 
 	// a packet is at least 4 bytes so loop as long as the buffer contains 4 bytes
 
-	while( Bytes.size( ) >= 4 )
+	while( true )
 	{
+		CPacketView Packet( RecvBuffer );
+
+		if( !Packet.GetHeaderComplete( ) )
+			return;
+
 		// byte 0 is always 255
 
-		if( Bytes[0] == BNET_HEADER_CONSTANT )
+		if( Packet.GetHeader( ) == BNET_HEADER_CONSTANT )
 		{
 			// bytes 2 and 3 contain the length of the packet
 
-			uint16_t Length = UTIL_ByteArrayToUInt16( Bytes, false, 2 );
-
-			if( Length >= 4 )
+			if( Packet.GetValidLength( ) )
 			{
-				if( Bytes.size( ) >= Length )
+				if( Packet.GetComplete( ) )
 				{
-					m_Packets.push( new CCommandPacket( BNET_HEADER_CONSTANT, Bytes[1], BYTEARRAY( Bytes.begin( ), Bytes.begin( ) + Length ) ) );
-					*RecvBuffer = RecvBuffer->substr( Length );
-					Bytes = BYTEARRAY( Bytes.begin( ) + Length, Bytes.end( ) );
+					m_Packets.push( new CCommandPacket( Packet ) );
+					RecvBuffer->Consume( Packet.GetLength( ) );
 				}
 				else
 					return;
@@ -845,7 +836,7 @@ void CBNET :: ProcessPackets( )
 						{
 							BOOST_LOG_TRIVIAL(info) << "[BNET: " + m_ServerAlias + "] creating BNLS client";
 							delete m_BNLSClient;
-							m_BNLSClient = new CBNLSClient( m_BNLSServer, m_BNLSPort, m_BNLSWardenCookie );
+							m_BNLSClient = new CBNLSClient( m_BNLSServer, m_BNLSPort, m_BNLSWardenCookie, m_GHost->m_Reactor );
 							m_BNLSClient->QueueWardenSeed( UTIL_ByteArrayToUInt32( m_BNCSUtil->GetKeyInfoROC( ), false, 16 ) );
 						}
 					}
@@ -1085,6 +1076,7 @@ void CBNET :: ProcessChatEvent( CIncomingChatEvent *chatEvent )
 				boost::mutex::scoped_lock spoofLock( m_GHost->m_CurrentGame->m_SpoofAddMutex );
 				m_GHost->m_CurrentGame->m_DoSpoofAdd.push_back( SpoofAdd );
 				spoofLock.unlock( );
+				m_GHost->m_CurrentGame->Wake( );
 			}
 		}
 		
@@ -1149,6 +1141,7 @@ void CBNET :: ProcessChatEvent( CIncomingChatEvent *chatEvent )
 				boost::mutex::scoped_lock sayLock( m_GHost->m_CurrentGame->m_SayGamesMutex );
 				m_GHost->m_CurrentGame->m_DoSayGames.push_back( FailMessage );
 				sayLock.unlock( );
+				m_GHost->m_CurrentGame->Wake( );
 			}
 
 			if( Message.find( "is using Warcraft III The Frozen Throne in game" ) != string :: npos || Message.find( "is using Warcraft III Frozen Throne and is currently in  game" ) != string :: npos )
@@ -1169,6 +1162,7 @@ void CBNET :: ProcessChatEvent( CIncomingChatEvent *chatEvent )
 				boost::mutex::scoped_lock spoofLock( m_GHost->m_CurrentGame->m_SpoofAddMutex );
 				m_GHost->m_CurrentGame->m_DoSpoofAdd.push_back( SpoofAdd );
 				spoofLock.unlock( );
+				m_GHost->m_CurrentGame->Wake( );
 			}
 		}
 		
@@ -1322,18 +1316,25 @@ void CBNET :: BotCommand( string Message, string User, bool Whisper, bool ForceR
 								if( Start != string :: npos )
 									GameName = GameName.substr( Start );
 
-								QueueChatCommand( m_GHost->m_Language->AutoHostEnabled( ), User, Whisper );
-								delete m_GHost->m_AutoHostMap;
-								m_GHost->m_AutoHostMap = new CMap( *m_GHost->m_Map );
-								m_GHost->m_AutoHostGameName = GameName;
-								m_GHost->m_AutoHostOwner = User;
-								m_GHost->m_AutoHostServer = m_Server;
-								m_GHost->m_AutoHostMaximumGames = MaximumGames;
-								m_GHost->m_AutoHostAutoStartPlayers = AutoStartPlayers;
-								m_GHost->m_LastAutoHostTime = GetTime( );
-								m_GHost->m_AutoHostMatchMaking = false;
-								m_GHost->m_AutoHostMinimumScore = 0.0;
-								m_GHost->m_AutoHostMaximumScore = 0.0;
+								// the autohost map is a copy of m_Map so don't take it while a map requested with !map or !load is still loading
+
+								if( m_GHost->m_MapLoader->GetNumPendingMaps( ) > 0 )
+									QueueChatCommand( m_GHost->m_Language->UnableToCreateGameMapLoading( GameName ), User, Whisper );
+								else
+								{
+									QueueChatCommand( m_GHost->m_Language->AutoHostEnabled( ), User, Whisper );
+									delete m_GHost->m_AutoHostMap;
+									m_GHost->m_AutoHostMap = new CMap( *m_GHost->m_Map );
+									m_GHost->m_AutoHostGameName = GameName;
+									m_GHost->m_AutoHostOwner = User;
+									m_GHost->m_AutoHostServer = m_Server;
+									m_GHost->m_AutoHostMaximumGames = MaximumGames;
+									m_GHost->m_AutoHostAutoStartPlayers = AutoStartPlayers;
+									m_GHost->m_LastAutoHostTime = GetTime( );
+									m_GHost->m_AutoHostMatchMaking = false;
+									m_GHost->m_AutoHostMinimumScore = 0.0;
+									m_GHost->m_AutoHostMaximumScore = 0.0;
+								}
 							}
 						}
 					}
@@ -1410,18 +1411,25 @@ void CBNET :: BotCommand( string Message, string User, bool Whisper, bool ForceR
 										if( Start != string :: npos )
 											GameName = GameName.substr( Start );
 
-										QueueChatCommand( m_GHost->m_Language->AutoHostEnabled( ), User, Whisper );
-										delete m_GHost->m_AutoHostMap;
-										m_GHost->m_AutoHostMap = new CMap( *m_GHost->m_Map );
-										m_GHost->m_AutoHostGameName = GameName;
-										m_GHost->m_AutoHostOwner = User;
-										m_GHost->m_AutoHostServer = m_Server;
-										m_GHost->m_AutoHostMaximumGames = MaximumGames;
-										m_GHost->m_AutoHostAutoStartPlayers = AutoStartPlayers;
-										m_GHost->m_LastAutoHostTime = GetTime( );
-										m_GHost->m_AutoHostMatchMaking = true;
-										m_GHost->m_AutoHostMinimumScore = MinimumScore;
-										m_GHost->m_AutoHostMaximumScore = MaximumScore;
+										// the autohost map is a copy of m_Map so don't take it while a map requested with !map or !load is still loading
+
+										if( m_GHost->m_MapLoader->GetNumPendingMaps( ) > 0 )
+											QueueChatCommand( m_GHost->m_Language->UnableToCreateGameMapLoading( GameName ), User, Whisper );
+										else
+										{
+											QueueChatCommand( m_GHost->m_Language->AutoHostEnabled( ), User, Whisper );
+											delete m_GHost->m_AutoHostMap;
+											m_GHost->m_AutoHostMap = new CMap( *m_GHost->m_Map );
+											m_GHost->m_AutoHostGameName = GameName;
+											m_GHost->m_AutoHostOwner = User;
+											m_GHost->m_AutoHostServer = m_Server;
+											m_GHost->m_AutoHostMaximumGames = MaximumGames;
+											m_GHost->m_AutoHostAutoStartPlayers = AutoStartPlayers;
+											m_GHost->m_LastAutoHostTime = GetTime( );
+											m_GHost->m_AutoHostMatchMaking = true;
+											m_GHost->m_AutoHostMinimumScore = MinimumScore;
+											m_GHost->m_AutoHostMaximumScore = MaximumScore;
+										}
 									}
 								}
 							}
@@ -1880,6 +1888,7 @@ void CBNET :: BotCommand( string Message, string User, bool Whisper, bool ForceR
 					boost::mutex::scoped_lock sayLock( m_GHost->m_CurrentGame->m_SayGamesMutex );
 					m_GHost->m_CurrentGame->m_DoSayGames.push_back( Payload );
 					sayLock.unlock( );
+					m_GHost->m_CurrentGame->Wake( );
 				}
 
 				for( vector<CBaseGame *> :: iterator i = m_GHost->m_Games.begin( ); i != m_GHost->m_Games.end( ); ++i )
@@ -1887,6 +1896,7 @@ void CBNET :: BotCommand( string Message, string User, bool Whisper, bool ForceR
 					boost::mutex::scoped_lock sayLock( (*i)->m_SayGamesMutex );
 					(*i)->m_DoSayGames.push_back( Payload );
 					sayLock.unlock( );
+					(*i)->Wake( );
 				}
 		
 				lock.unlock( );
@@ -1940,6 +1950,23 @@ void CBNET :: BotCommand( string Message, string User, bool Whisper, bool ForceR
 				QueueChatCommand( "WARDEN STATUS --- Not connected to BNLS server.", User, Whisper );
 		}
 
+		//
+		// !WORKERSTATUS
+		//
+
+		else if( Command == "workerstatus" )
+		{
+			for( vector<CGameWorker *> :: iterator i = m_GHost->m_Workers.begin( ); i != m_GHost->m_Workers.end( ); ++i )
+				QueueChatCommand( "WORKER STATUS --- " + (*i)->GetStatus( ) + ".", User, Whisper );
+		}
+
+		//
+		// !BANDWIDTH
+		//
+
+		else if( Command == "bandwidth" )
+			QueueChatCommand( "BANDWIDTH --- " + m_GHost->m_DownloadGovernor->GetStatus( ) + ".", User, Whisper );
+
 		/**
 		 * Command: !downloadmap
 		 * Alias: !dlmap
@@ -1955,16 +1982,57 @@ void CBNET :: BotCommand( string Message, string User, bool Whisper, bool ForceR
 				BOOST_LOG_TRIVIAL(info) << "[GHOST] downloading map from " + Payload + " requested by user " + User + "!";
 				QueueChatCommand( "Starting download of the map requested by " + User + ". [Link: " + Payload + "]", User, Whisper );
 
+				// the maps are memory mapped by CMapData so we must never write into an existing map file, that would change (or truncate) the data under a running game
+				// instead download into a temporary directory next to the maps and rename the file over the target, the old file stays alive until nothing maps it anymore
+				// the temporary directory has to be on the same filesystem for rename to work which is why it lives inside the map directory
+
+				string MapDir = "/opt/ghostpp/data/maps/";
+				string TempDir = MapDir + ".dlmap-" + UTIL_ToString( GetTicks( ) );
+				uint32_t Downloaded = 0;
+
 				try {
+					create_directory( TempDir );
+
 					// download map
 					// TODO: use libcurl instread of system
-					string curlCommmand = "(cd /opt/ghostpp/data/maps; curl -O -J -L \"" + Payload + "\")";
-					system(curlCommmand.c_str());
+					string curlCommmand = "(cd \"" + TempDir + "\"; curl -f -O -J -L \"" + Payload + "\")";
+
+					if( system(curlCommmand.c_str()) == 0 )
+					{
+						directory_iterator EndIterator;
+
+						for( directory_iterator i( TempDir ); i != EndIterator; ++i )
+						{
+							if( !is_regular_file( i->status( ) ) )
+								continue;
+
+							string FileName = i->path( ).filename( ).string( );
+
+							if( rename( i->path( ).string( ).c_str( ), ( MapDir + FileName ).c_str( ) ) == 0 )
+							{
+								BOOST_LOG_TRIVIAL(info) << "[GHOST] downloaded map [" + MapDir + FileName + "]";
+								++Downloaded;
+							}
+							else
+								BOOST_LOG_TRIVIAL(warning) << "[GHOST] error moving downloaded map [" + FileName + "] into [" + MapDir + "]";
+						}
+					}
+
 				} catch (...) {
+					Downloaded = 0;
+				}
+
+				// always clean up the temporary directory (and any partial download left in it), even if something above threw
+
+				boost::system::error_code ec;
+				remove_all( TempDir, ec );
+
+				if( Downloaded == 0 )
+				{
 					QueueChatCommand( "Map could not be downloaded!", User, Whisper );
 					return;
 				}
-				
+
 				QueueChatCommand( "Map was downloaded successfully.", User, Whisper );
 			}
 			else
@@ -38,7 +38,7 @@ CBNETProtocol :: ~CBNETProtocol( )
 // RECEIVE FUNCTIONS //
 ///////////////////////
 
-bool CBNETProtocol :: RECEIVE_SID_NULL( BYTEARRAY data )
+bool CBNETProtocol :: RECEIVE_SID_NULL( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_NULL" );
 	// DEBUG_Print( data );
@@ -49,7 +49,7 @@ bool CBNETProtocol :: RECEIVE_SID_NULL( BYTEARRAY data )
 	return ValidateLength( data );
 }
 
-CIncomingGameHost *CBNETProtocol :: RECEIVE_SID_GETADVLISTEX( BYTEARRAY data )
+CIncomingGameHost *CBNETProtocol :: RECEIVE_SID_GETADVLISTEX( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_GETADVLISTEX" );
 	// DEBUG_Print( data );
@@ -93,7 +93,7 @@ CIncomingGameHost *CBNETProtocol :: RECEIVE_SID_GETADVLISTEX( BYTEARRAY data )
 	return NULL;
 }
 
-bool CBNETProtocol :: RECEIVE_SID_ENTERCHAT( BYTEARRAY data )
+bool CBNETProtocol :: RECEIVE_SID_ENTERCHAT( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_ENTERCHAT" );
 	// DEBUG_Print( data );
@@ -111,7 +111,7 @@ bool CBNETProtocol :: RECEIVE_SID_ENTERCHAT( BYTEARRAY data )
 	return false;
 }
 
-CIncomingChatEvent *CBNETProtocol :: RECEIVE_SID_CHATEVENT( BYTEARRAY data )
+CIncomingChatEvent *CBNETProtocol :: RECEIVE_SID_CHATEVENT( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_CHATEVENT" );
 	// DEBUG_Print( data );
@@ -160,7 +160,7 @@ CIncomingChatEvent *CBNETProtocol :: RECEIVE_SID_CHATEVENT( BYTEARRAY data )
 	return NULL;
 }
 
-bool CBNETProtocol :: RECEIVE_SID_CHECKAD( BYTEARRAY data )
+bool CBNETProtocol :: RECEIVE_SID_CHECKAD( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_CHECKAD" );
 	// DEBUG_Print( data );
@@ -171,7 +171,7 @@ bool CBNETProtocol :: RECEIVE_SID_CHECKAD( BYTEARRAY data )
 	return ValidateLength( data );
 }
 
-bool CBNETProtocol :: RECEIVE_SID_STARTADVEX3( BYTEARRAY data )
+bool CBNETProtocol :: RECEIVE_SID_STARTADVEX3( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_STARTADVEX3" );
 	// DEBUG_Print( data );
@@ -191,7 +191,7 @@ bool CBNETProtocol :: RECEIVE_SID_STARTADVEX3( BYTEARRAY data )
 	return false;
 }
 
-BYTEARRAY CBNETProtocol :: RECEIVE_SID_PING( BYTEARRAY data )
+BYTEARRAY CBNETProtocol :: RECEIVE_SID_PING( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_PING" );
 	// DEBUG_Print( data );
@@ -206,7 +206,7 @@ BYTEARRAY CBNETProtocol :: RECEIVE_SID_PING( BYTEARRAY data )
 	return BYTEARRAY( );
 }
 
-bool CBNETProtocol :: RECEIVE_SID_LOGONRESPONSE( BYTEARRAY data )
+bool CBNETProtocol :: RECEIVE_SID_LOGONRESPONSE( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_LOGONRESPONSE" );
 	// DEBUG_Print( data );
@@ -226,7 +226,7 @@ bool CBNETProtocol :: RECEIVE_SID_LOGONRESPONSE( BYTEARRAY data )
 	return false;
 }
 
-bool CBNETProtocol :: RECEIVE_SID_AUTH_INFO( BYTEARRAY data )
+bool CBNETProtocol :: RECEIVE_SID_AUTH_INFO( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_AUTH_INFO" );
 	// DEBUG_Print( data );
@@ -253,7 +253,7 @@ bool CBNETProtocol :: RECEIVE_SID_AUTH_INFO( BYTEARRAY data )
 	return false;
 }
 
-bool CBNETProtocol :: RECEIVE_SID_AUTH_CHECK( BYTEARRAY data )
+bool CBNETProtocol :: RECEIVE_SID_AUTH_CHECK( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_AUTH_CHECK" );
 	// DEBUG_Print( data );
@@ -275,7 +275,7 @@ bool CBNETProtocol :: RECEIVE_SID_AUTH_CHECK( BYTEARRAY data )
 	return false;
 }
 
-bool CBNETProtocol :: RECEIVE_SID_AUTH_ACCOUNTLOGON( BYTEARRAY data )
+bool CBNETProtocol :: RECEIVE_SID_AUTH_ACCOUNTLOGON( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_AUTH_ACCOUNTLOGON" );
 	// DEBUG_Print( data );
@@ -302,7 +302,7 @@ bool CBNETProtocol :: RECEIVE_SID_AUTH_ACCOUNTLOGON( BYTEARRAY data )
 	return false;
 }
 
-bool CBNETProtocol :: RECEIVE_SID_AUTH_ACCOUNTLOGONPROOF( BYTEARRAY data )
+bool CBNETProtocol :: RECEIVE_SID_AUTH_ACCOUNTLOGONPROOF( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_AUTH_ACCOUNTLOGONPROOF" );
 	// DEBUG_Print( data );
@@ -322,7 +322,7 @@ bool CBNETProtocol :: RECEIVE_SID_AUTH_ACCOUNTLOGONPROOF( BYTEARRAY data )
 	return false;
 }
 
-BYTEARRAY CBNETProtocol :: RECEIVE_SID_WARDEN( BYTEARRAY data )
+BYTEARRAY CBNETProtocol :: RECEIVE_SID_WARDEN( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_WARDEN" );
 	// DEBUG_PRINT( data );
@@ -337,7 +337,7 @@ BYTEARRAY CBNETProtocol :: RECEIVE_SID_WARDEN( BYTEARRAY data )
 	return BYTEARRAY( );
 }
 
-vector<CIncomingFriendList *> CBNETProtocol :: RECEIVE_SID_FRIENDSLIST( BYTEARRAY data )
+vector<CIncomingFriendList *> CBNETProtocol :: RECEIVE_SID_FRIENDSLIST( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_FRIENDSLIST" );
 	// DEBUG_Print( data );
@@ -387,7 +387,7 @@ vector<CIncomingFriendList *> CBNETProtocol :: RECEIVE_SID_FRIENDSLIST( BYTEARRA
 	return Friends;
 }
 
-vector<CIncomingClanList *> CBNETProtocol :: RECEIVE_SID_CLANMEMBERLIST( BYTEARRAY data )
+vector<CIncomingClanList *> CBNETProtocol :: RECEIVE_SID_CLANMEMBERLIST( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_CLANMEMBERLIST" );
 	// DEBUG_Print( data );
@@ -439,7 +439,7 @@ vector<CIncomingClanList *> CBNETProtocol :: RECEIVE_SID_CLANMEMBERLIST( BYTEARR
 	return ClanList;
 }
 
-CIncomingClanList *CBNETProtocol :: RECEIVE_SID_CLANMEMBERSTATUSCHANGE( BYTEARRAY data )
+CIncomingClanList *CBNETProtocol :: RECEIVE_SID_CLANMEMBERSTATUSCHANGE( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED SID_CLANMEMBERSTATUSCHANGE" );
 	// DEBUG_Print( data );
@@ -472,7 +472,7 @@ CIncomingClanList *CBNETProtocol :: RECEIVE_SID_CLANMEMBERSTATUSCHANGE( BYTEARRA
 	return NULL;
 }
 
-string CBNETProtocol :: RECEIVE_SID_CLANCREATIONINVITATION( BYTEARRAY data )
+string CBNETProtocol :: RECEIVE_SID_CLANCREATIONINVITATION( BYTEARRAY &data )
 {
 	if( ValidateLength( data ) && data.size( ) >= 12 )
 	{
@@ -487,7 +487,7 @@ string CBNETProtocol :: RECEIVE_SID_CLANCREATIONINVITATION( BYTEARRAY data )
 	return NULL;
 }
 
-string CBNETProtocol :: RECEIVE_SID_CLANINVITATIONRESPONSE( BYTEARRAY data )
+string CBNETProtocol :: RECEIVE_SID_CLANINVITATIONRESPONSE( BYTEARRAY &data )
 {
 	if( ValidateLength( data ) && data.size( ) >= 12 )
 	{
@@ -136,24 +136,24 @@ public:
 
 	// receive functions
 
-	bool RECEIVE_SID_NULL( BYTEARRAY data );
-	CIncomingGameHost *RECEIVE_SID_GETADVLISTEX( BYTEARRAY data );
-	bool RECEIVE_SID_ENTERCHAT( BYTEARRAY data );
-	CIncomingChatEvent *RECEIVE_SID_CHATEVENT( BYTEARRAY data );
-	bool RECEIVE_SID_CHECKAD( BYTEARRAY data );
-	bool RECEIVE_SID_STARTADVEX3( BYTEARRAY data );
-	BYTEARRAY RECEIVE_SID_PING( BYTEARRAY data );
-	bool RECEIVE_SID_LOGONRESPONSE( BYTEARRAY data );
-	bool RECEIVE_SID_AUTH_INFO( BYTEARRAY data );
-	bool RECEIVE_SID_AUTH_CHECK( BYTEARRAY data );
-	bool RECEIVE_SID_AUTH_ACCOUNTLOGON( BYTEARRAY data );
-	bool RECEIVE_SID_AUTH_ACCOUNTLOGONPROOF( BYTEARRAY data );
-	BYTEARRAY RECEIVE_SID_WARDEN( BYTEARRAY data );
-	vector<CIncomingFriendList *> RECEIVE_SID_FRIENDSLIST( BYTEARRAY data );
-	vector<CIncomingClanList *> RECEIVE_SID_CLANMEMBERLIST( BYTEARRAY data );
-	CIncomingClanList *RECEIVE_SID_CLANMEMBERSTATUSCHANGE( BYTEARRAY data );
-	string RECEIVE_SID_CLANCREATIONINVITATION( BYTEARRAY data );
-	string RECEIVE_SID_CLANINVITATIONRESPONSE( BYTEARRAY data );
+	bool RECEIVE_SID_NULL( BYTEARRAY &data );
+	CIncomingGameHost *RECEIVE_SID_GETADVLISTEX( BYTEARRAY &data );
+	bool RECEIVE_SID_ENTERCHAT( BYTEARRAY &data );
+	CIncomingChatEvent *RECEIVE_SID_CHATEVENT( BYTEARRAY &data );
+	bool RECEIVE_SID_CHECKAD( BYTEARRAY &data );
+	bool RECEIVE_SID_STARTADVEX3( BYTEARRAY &data );
+	BYTEARRAY RECEIVE_SID_PING( BYTEARRAY &data );
+	bool RECEIVE_SID_LOGONRESPONSE( BYTEARRAY &data );
+	bool RECEIVE_SID_AUTH_INFO( BYTEARRAY &data );
+	bool RECEIVE_SID_AUTH_CHECK( BYTEARRAY &data );
+	bool RECEIVE_SID_AUTH_ACCOUNTLOGON( BYTEARRAY &data );
+	bool RECEIVE_SID_AUTH_ACCOUNTLOGONPROOF( BYTEARRAY &data );
+	BYTEARRAY RECEIVE_SID_WARDEN( BYTEARRAY &data );
+	vector<CIncomingFriendList *> RECEIVE_SID_FRIENDSLIST( BYTEARRAY &data );
+	vector<CIncomingClanList *> RECEIVE_SID_CLANMEMBERLIST( BYTEARRAY &data );
+	CIncomingClanList *RECEIVE_SID_CLANMEMBERSTATUSCHANGE( BYTEARRAY &data );
+	string RECEIVE_SID_CLANCREATIONINVITATION( BYTEARRAY &data );
+	string RECEIVE_SID_CLANINVITATIONRESPONSE( BYTEARRAY &data );
 
 	// send functions
 
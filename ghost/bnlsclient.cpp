@@ -21,6 +21,7 @@
 #include "ghost.h"
 #include "util.h"
 #include "socket.h"
+#include "reactor.h"
 #include "commandpacket.h"
 #include "bnlsprotocol.h"
 #include "bnlsclient.h"
@@ -29,7 +30,7 @@
 // CBNLSClient
 //
 
-CBNLSClient :: CBNLSClient( string nServer, uint16_t nPort, uint32_t nWardenCookie ) : m_WasConnected( false ), m_Server( nServer ), m_Port( nPort ), m_LastNullTime( 0 ), m_WardenCookie( nWardenCookie ), m_TotalWardenIn( 0 ), m_TotalWardenOut( 0 )
+CBNLSClient :: CBNLSClient( string nServer, uint16_t nPort, uint32_t nWardenCookie, CSocketReactor *nReactor ) : m_Reactor( nReactor ), m_WasConnected( false ), m_Server( nServer ), m_Port( nPort ), m_LastNullTime( 0 ), m_WardenCookie( nWardenCookie ), m_TotalWardenIn( 0 ), m_TotalWardenOut( 0 )
 {
 	m_Socket = new CTCPClient( );
 	m_Protocol = new CBNLSProtocol( );
@@ -61,18 +62,7 @@ BYTEARRAY CBNLSClient :: GetWardenResponse( )
 	return WardenResponse;
 }
 
-unsigned int CBNLSClient :: SetFD( void *fd, void *send_fd, int *nfds )
-{
-	if( !m_Socket->HasError( ) && m_Socket->GetConnected( ) )
-	{
-		m_Socket->SetFD( (fd_set *)fd, (fd_set *)send_fd, nfds );
-		return 1;
-	}
-
-	return 0;
-}
-
-bool CBNLSClient :: Update( void *fd, void *send_fd )
+bool CBNLSClient :: Update( )
 {
 	if( m_Socket->HasError( ) )
 	{
@@ -88,7 +78,7 @@ bool CBNLSClient :: Update( void *fd, void *send_fd )
 
 	if( m_Socket->GetConnected( ) )
 	{
-		m_Socket->DoRecv( (fd_set *)fd );
+		m_Socket->DoRecv( );
 		ExtractPackets( );
 		ProcessPackets( );
 
@@ -104,7 +94,7 @@ bool CBNLSClient :: Update( void *fd, void *send_fd )
 			m_OutPackets.pop( );
 		}
 
-		m_Socket->DoSend( (fd_set *)send_fd );
+		m_Socket->DoSend( );
 		return false;
 	}
 
@@ -113,6 +103,10 @@ bool CBNLSClient :: Update( void *fd, void *send_fd )
 		BOOST_LOG_TRIVIAL(warning) << "[BNLSC: " + m_Server + ":" + UTIL_ToString( m_Port ) + ":C" + UTIL_ToString( m_WardenCookie ) + "] connected";
 		m_WasConnected = true;
 		m_LastNullTime = GetTime( );
+
+		if( m_Reactor )
+			m_Reactor->Add( m_Socket );
+
 		return false;
 	}
 
@@ -128,20 +122,23 @@ bool CBNLSClient :: Update( void *fd, void *send_fd )
 
 void CBNLSClient :: ExtractPackets( )
 {
-	string *RecvBuffer = m_Socket->GetBytes( );
-	BYTEARRAY Bytes = UTIL_CreateByteArray( (unsigned char *)RecvBuffer->c_str( ), RecvBuffer->size( ) );
+	CByteBuffer *RecvBuffer = m_Socket->GetBytes( );
 
-	while( Bytes.size( ) >= 3 )
+	while( true )
 	{
-		uint16_t Length = UTIL_ByteArrayToUInt16( Bytes, false );
+		// BNLS packets start with the length so the header is only 3 bytes
+
+		CPacketView Packet( RecvBuffer, true );
+
+		if( !Packet.GetHeaderComplete( ) )
+			return;
 
-		if( Length >= 3 )
+		if( Packet.GetValidLength( ) )
 		{
-			if( Bytes.size( ) >= Length )
+			if( Packet.GetComplete( ) )
 			{
-				m_Packets.push( new CCommandPacket( 0, Bytes[2], BYTEARRAY( Bytes.begin( ), Bytes.begin( ) + Length ) ) );
-				*RecvBuffer = RecvBuffer->substr( Length );
-				Bytes = BYTEARRAY( Bytes.begin( ) + Length, Bytes.end( ) );
+				m_Packets.push( new CCommandPacket( Packet ) );
+				RecvBuffer->Consume( Packet.GetLength( ) );
 			}
 			else
 				return;
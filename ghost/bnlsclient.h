@@ -28,11 +28,13 @@
 class CTCPClient;
 class CBNLSProtocol;
 class CCommandPacket;
+class CSocketReactor;
 
 class CBNLSClient
 {
 private:
 	CTCPClient *m_Socket;							// the connection to the BNLS server
+	CSocketReactor *m_Reactor;						// the reactor to register the connection with once it's established
 	CBNLSProtocol *m_Protocol;						// battle.net protocol
 	queue<CCommandPacket *> m_Packets;				// queue of incoming packets
 	bool m_WasConnected;
@@ -46,7 +48,7 @@ private:
 	uint32_t m_TotalWardenOut;
 
 public:
-	CBNLSClient( string nServer, uint16_t nPort, uint32_t nWardenCookie );
+	CBNLSClient( string nServer, uint16_t nPort, uint32_t nWardenCookie, CSocketReactor *nReactor );
 	~CBNLSClient( );
 
 	BYTEARRAY GetWardenResponse( );
@@ -55,8 +57,7 @@ public:
 
 	// processing functions
 
-	unsigned int SetFD( void *fd, void *send_fd, int *nfds );
-	bool Update( void *fd, void *send_fd );
+	bool Update( );
 	void ExtractPackets( );
 	void ProcessPackets( );
 
@@ -36,7 +36,7 @@ CBNLSProtocol :: ~CBNLSProtocol( )
 // RECEIVE FUNCTIONS //
 ///////////////////////
 
-BYTEARRAY CBNLSProtocol :: RECEIVE_BNLS_WARDEN( BYTEARRAY data )
+BYTEARRAY CBNLSProtocol :: RECEIVE_BNLS_WARDEN( BYTEARRAY &data )
 {
 	// 2 bytes					-> Length
 	// 1 byte					-> ID
@@ -65,7 +65,7 @@ public:
 
 	// receive functions
 
-	BYTEARRAY RECEIVE_BNLS_WARDEN( BYTEARRAY data );
+	BYTEARRAY RECEIVE_BNLS_WARDEN( BYTEARRAY &data );
 
 	// send functions
 
@@ -0,0 +1,213 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+// capdump - prints a packet capture file written by ghost++ (see bot_capturefile and capture.h)
+// usage: capdump [-p] [-c connection] <file>
+//  -p	reassemble each connection's data and print it as W3GS/GPS/BNCS packets instead of raw records
+//  -c	only print the given connection
+
+#include "ghost.h"
+#include "capture.h"
+
+#include <stdio.h>
+#include <time.h>
+
+uint32_t ReadUInt32( const unsigned char *data )
+{
+	return (uint32_t)data[0] | ( (uint32_t)data[1] << 8 ) | ( (uint32_t)data[2] << 16 ) | ( (uint32_t)data[3] << 24 );
+}
+
+uint16_t ReadUInt16( const unsigned char *data )
+{
+	return (uint16_t)( data[0] | ( data[1] << 8 ) );
+}
+
+string FormatTime( uint32_t startTime, uint32_t startTicks, uint32_t ticks )
+{
+	uint32_t Elapsed = ticks - startTicks;
+	time_t Time = startTime + Elapsed / 1000;
+	char Buffer[64];
+	strftime( Buffer, sizeof( Buffer ), "%Y-%m-%d %H:%M:%S", localtime( &Time ) );
+	char Millis[8];
+	sprintf( Millis, ".%03u", Elapsed % 1000 );
+	return string( Buffer ) + Millis;
+}
+
+void PrintHex( const unsigned char *data, uint32_t length )
+{
+	for( uint32_t i = 0; i < length; i += 16 )
+	{
+		printf( "    %04x ", i );
+
+		for( uint32_t j = i; j < i + 16; ++j )
+		{
+			if( j < length )
+				printf( " %02x", data[j] );
+			else
+				printf( "   " );
+		}
+
+		printf( "  " );
+
+		for( uint32_t j = i; j < i + 16 && j < length; ++j )
+			printf( "%c", data[j] >= 32 && data[j] < 127 ? data[j] : '.' );
+
+		printf( "\n" );
+	}
+}
+
+string HeaderName( unsigned char header )
+{
+	if( header == 247 )
+		return "W3GS";
+	else if( header == 248 )
+		return "GPS";
+	else if( header == 255 )
+		return "BNCS";
+
+	return string( );
+}
+
+int main( int argc, char **argv )
+{
+	bool Packets = false;
+	bool FilterConnection = false;
+	uint32_t Connection = 0;
+	string File;
+
+	for( int i = 1; i < argc; ++i )
+	{
+		string Arg = argv[i];
+
+		if( Arg == "-p" )
+			Packets = true;
+		else if( Arg == "-c" && i + 1 < argc )
+		{
+			FilterConnection = true;
+			Connection = atoi( argv[++i] );
+		}
+		else
+			File = Arg;
+	}
+
+	if( File.empty( ) )
+	{
+		fprintf( stderr, "usage: capdump [-p] [-c connection] <file>\n" );
+		return 1;
+	}
+
+	ifstream In;
+	In.open( File.c_str( ), ios :: binary );
+
+	if( In.fail( ) )
+	{
+		fprintf( stderr, "error opening [%s]\n", File.c_str( ) );
+		return 1;
+	}
+
+	unsigned char Header[CAPTURE_HEADER_SIZE];
+
+	if( !In.read( (char *)Header, CAPTURE_HEADER_SIZE ) || memcmp( Header, "GCAP", 4 ) || ReadUInt32( Header + 4 ) != CAPTURE_VERSION )
+	{
+		fprintf( stderr, "[%s] isn't a version %u capture file\n", File.c_str( ), CAPTURE_VERSION );
+		return 1;
+	}
+
+	uint32_t StartTime = ReadUInt32( Header + 8 );
+	uint32_t StartTicks = ReadUInt32( Header + 12 );
+
+	// the unframed data of each connection and direction when printing packets
+
+	map<pair<uint32_t, unsigned char>, BYTEARRAY> Streams;
+	unsigned char Record[CAPTURE_RECORD_SIZE];
+	unsigned char Data[65536];
+
+	while( In.read( (char *)Record, CAPTURE_RECORD_SIZE ) )
+	{
+		uint32_t Ticks = ReadUInt32( Record );
+		uint32_t RecordConnection = ReadUInt32( Record + 4 );
+		unsigned char Direction = Record[8];
+		uint16_t Port = ReadUInt16( Record + 13 );
+		uint16_t Length = ReadUInt16( Record + 15 );
+		char IP[32];
+		sprintf( IP, "%u.%u.%u.%u:%u", Record[9], Record[10], Record[11], Record[12], Port );
+
+		if( Direction == CAPTURE_DROPPED )
+		{
+			printf( "%s DROPPED %u records\n", FormatTime( StartTime, StartTicks, Ticks ).c_str( ), Length );
+
+			// some data is missing so the partial packets we're holding can't be completed anymore
+
+			Streams.clear( );
+			continue;
+		}
+
+		if( !In.read( (char *)Data, Length ) )
+		{
+			fprintf( stderr, "capture file is truncated\n" );
+			break;
+		}
+
+		if( FilterConnection && RecordConnection != Connection )
+			continue;
+
+		char ConnectionString[16];
+		sprintf( ConnectionString, " #%u ", RecordConnection );
+		string Prefix = FormatTime( StartTime, StartTicks, Ticks ) + ConnectionString + IP + ( Direction == CAPTURE_SEND ? " SEND >>> " : " RECV <<< " );
+
+		if( !Packets )
+		{
+			printf( "%s%u bytes\n", Prefix.c_str( ), Length );
+			PrintHex( Data, Length );
+			continue;
+		}
+
+		BYTEARRAY &Stream = Streams[make_pair( RecordConnection, Direction )];
+		Stream.insert( Stream.end( ), Data, Data + Length );
+		uint32_t Offset = 0;
+
+		while( Stream.size( ) - Offset >= 4 )
+		{
+			uint16_t PacketLength = ReadUInt16( &Stream[Offset + 2] );
+			string Name = HeaderName( Stream[Offset] );
+
+			if( Name.empty( ) || PacketLength < 4 )
+			{
+				// not a packet we know how to frame (e.g. BNLS or the initial protocol byte sent to battle.net) so print it raw and start over
+
+				printf( "%sunframed %u bytes\n", Prefix.c_str( ), (uint32_t)( Stream.size( ) - Offset ) );
+				PrintHex( &Stream[Offset], Stream.size( ) - Offset );
+				Offset = Stream.size( );
+				break;
+			}
+
+			if( Stream.size( ) - Offset < PacketLength )
+				break;
+
+			printf( "%s%s 0x%02x %u bytes\n", Prefix.c_str( ), Name.c_str( ), Stream[Offset + 1], PacketLength );
+			PrintHex( &Stream[Offset], PacketLength );
+			Offset += PacketLength;
+		}
+
+		Stream.erase( Stream.begin( ), Stream.begin( ) + Offset );
+	}
+
+	return 0;
+}
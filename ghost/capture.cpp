@@ -0,0 +1,191 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#include "ghost.h"
+#include "util.h"
+#include "capture.h"
+
+#include <time.h>
+
+//
+// CPacketCapture
+//
+
+CPacketCapture :: CPacketCapture( string nFile ) : m_File( nFile ), m_WritePosition( 0 ), m_ReadPosition( 0 ), m_Dropped( 0 ), m_NextConnection( 0 ), m_Exiting( false ), m_TotalRecords( 0 ), m_TotalDropped( 0 )
+{
+	// every slot starts out writable at its own position
+
+	m_Slots = new CCaptureSlot[CAPTURE_SLOTS];
+
+	for( uint32_t i = 0; i < CAPTURE_SLOTS; ++i )
+		m_Slots[i].m_Sequence.store( i, boost::memory_order_relaxed );
+
+	m_Thread = new boost::thread( &CPacketCapture :: loop, this );
+}
+
+CPacketCapture :: ~CPacketCapture( )
+{
+	// the writer thread empties the ring before it exits
+
+	m_Exiting = true;
+	m_Thread->join( );
+	delete m_Thread;
+	delete [] m_Slots;
+	BOOST_LOG_TRIVIAL(info) << "[CAPTURE] wrote " + UTIL_ToString( m_TotalRecords ) + " records to [" + m_File + "], " + UTIL_ToString( m_TotalDropped ) + " records were dropped";
+}
+
+void CPacketCapture :: Capture( uint32_t connection, unsigned char direction, uint32_t ip, uint16_t port, const unsigned char *data, uint32_t length )
+{
+	if( m_Exiting )
+		return;
+
+	// split the data into records of at most CAPTURE_SNAPLEN bytes
+
+	while( length > 0 )
+	{
+		uint16_t Length = length > CAPTURE_SNAPLEN ? CAPTURE_SNAPLEN : length;
+		Push( connection, direction, ip, port, data, Length );
+		data += Length;
+		length -= Length;
+	}
+}
+
+void CPacketCapture :: Push( uint32_t connection, unsigned char direction, uint32_t ip, uint16_t port, const unsigned char *data, uint16_t length )
+{
+	// claim the next ring position, the slot is free when its sequence equals the position
+	// if the slot still holds a record from the previous lap the ring is full and the record is dropped
+
+	uint32_t Position = m_WritePosition.load( boost::memory_order_relaxed );
+	CCaptureSlot *Slot = NULL;
+
+	while( true )
+	{
+		Slot = &m_Slots[Position & ( CAPTURE_SLOTS - 1 )];
+		int32_t Difference = (int32_t)( Slot->m_Sequence.load( boost::memory_order_acquire ) - Position );
+
+		if( Difference == 0 )
+		{
+			// the position is updated with the current write position if another producer claimed it first
+
+			if( m_WritePosition.compare_exchange_weak( Position, Position + 1, boost::memory_order_relaxed ) )
+				break;
+		}
+		else if( Difference < 0 )
+		{
+			++m_Dropped;
+			return;
+		}
+		else
+			Position = m_WritePosition.load( boost::memory_order_relaxed );
+	}
+
+	Slot->m_Ticks = GetTicks( );
+	Slot->m_Connection = connection;
+	Slot->m_Direction = direction;
+	memcpy( Slot->m_IP, &ip, 4 );
+	Slot->m_Port = port;
+	Slot->m_Length = length;
+	memcpy( Slot->m_Data, data, length );
+
+	// publish the record to the writer thread
+
+	Slot->m_Sequence.store( Position + 1, boost::memory_order_release );
+}
+
+void CPacketCapture :: loop( )
+{
+	ofstream File;
+	File.open( m_File.c_str( ), ios :: binary | ios :: trunc );
+
+	if( File.fail( ) )
+	{
+		BOOST_LOG_TRIVIAL(warning) << "[CAPTURE] error opening capture file [" + m_File + "], packet capture disabled";
+		m_Exiting = true;
+		return;
+	}
+
+	BOOST_LOG_TRIVIAL(info) << "[CAPTURE] capturing packets to [" + m_File + "]";
+	BYTEARRAY Header;
+	UTIL_AppendByteArray( Header, string( "GCAP" ), false );
+	UTIL_AppendByteArray( Header, (uint32_t)CAPTURE_VERSION, false );
+	UTIL_AppendByteArray( Header, (uint32_t)time( NULL ), false );
+	UTIL_AppendByteArray( Header, GetTicks( ), false );
+	File.write( (char *)&Header[0], Header.size( ) );
+
+	while( true )
+	{
+		// read the exiting flag first so everything pushed before it was set is written
+
+		bool Exiting = m_Exiting;
+		uint32_t Written = 0;
+
+		while( true )
+		{
+			CCaptureSlot *Slot = &m_Slots[m_ReadPosition & ( CAPTURE_SLOTS - 1 )];
+
+			if( Slot->m_Sequence.load( boost::memory_order_acquire ) != m_ReadPosition + 1 )
+				break;
+
+			BYTEARRAY Record;
+			UTIL_AppendByteArray( Record, Slot->m_Ticks, false );
+			UTIL_AppendByteArray( Record, Slot->m_Connection, false );
+			Record.push_back( Slot->m_Direction );
+			UTIL_AppendByteArray( Record, Slot->m_IP, 4 );
+			UTIL_AppendByteArray( Record, Slot->m_Port, false );
+			UTIL_AppendByteArray( Record, Slot->m_Length, false );
+			File.write( (char *)&Record[0], Record.size( ) );
+			File.write( (char *)Slot->m_Data, Slot->m_Length );
+
+			// hand the slot back to the producers for the next lap
+
+			Slot->m_Sequence.store( m_ReadPosition + CAPTURE_SLOTS, boost::memory_order_release );
+			++m_ReadPosition;
+			++m_TotalRecords;
+			++Written;
+		}
+
+		uint32_t Dropped = m_Dropped.exchange( 0 );
+
+		if( Dropped > 0 )
+		{
+			BYTEARRAY Record;
+			UTIL_AppendByteArray( Record, GetTicks( ), false );
+			UTIL_AppendByteArray( Record, (uint32_t)0, false );
+			Record.push_back( CAPTURE_DROPPED );
+			UTIL_AppendByteArray( Record, (uint32_t)0, false );
+			UTIL_AppendByteArray( Record, (uint16_t)0, false );
+			UTIL_AppendByteArray( Record, (uint16_t)( Dropped > 65535 ? 65535 : Dropped ), false );
+			File.write( (char *)&Record[0], Record.size( ) );
+			m_TotalDropped += Dropped;
+			++Written;
+		}
+
+		if( Written > 0 )
+			File.flush( );
+
+		if( Exiting )
+			break;
+
+		if( Written == 0 )
+			MILLISLEEP( 10 );
+	}
+
+	File.close( );
+}
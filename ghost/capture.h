@@ -0,0 +1,105 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+// capture file format (all integers are little endian)
+// the file starts with a header:
+//  4 bytes		magic "GCAP"
+//  uint32		version (CAPTURE_VERSION)
+//  uint32		unix time when the capture started
+//  uint32		GetTicks when the capture started, the record timestamps are relative to this
+// followed by any number of records:
+//  uint32		GetTicks when the data was captured
+//  uint32		connection ID, unique for every TCP socket while the bot is running
+//  uint8		direction (CAPTURE_RECV, CAPTURE_SEND, or CAPTURE_DROPPED)
+//  4 bytes		remote IP address
+//  uint16		remote port
+//  uint16		data length
+//  data		the bytes received or sent in the order they went over the connection
+// each record holds at most CAPTURE_SNAPLEN bytes, larger sends and receives are split into several records so nothing is lost
+// a CAPTURE_DROPPED record means the ring was full, it has no data and its data length field holds the number of records which were dropped (capped at 65535)
+
+#define CAPTURE_VERSION			1
+#define CAPTURE_HEADER_SIZE		16
+#define CAPTURE_RECORD_SIZE		17
+
+#define CAPTURE_RECV			0
+#define CAPTURE_SEND			1
+#define CAPTURE_DROPPED			2
+
+#define CAPTURE_SNAPLEN			2048
+#define CAPTURE_SLOTS			4096
+
+//
+// CPacketCapture
+//
+
+// captures the raw data sent and received on every TCP socket and writes it to a binary capture file (see above)
+// the sockets push records into a lock free ring which is emptied by a background thread so capturing never blocks a game on file I/O
+// the ring is a bounded multi producer queue since sockets on every game worker and the main thread push to it at the same time
+// when the writer can't keep up the newest records are dropped instead of blocking the sender, the number of dropped records is written to the file
+// use the capdump tool to read a capture file
+
+class CPacketCapture
+{
+private:
+	struct CCaptureSlot
+	{
+		boost::atomic<uint32_t> m_Sequence;		// the ring position this slot can be written (== position) or read (== position + 1) at
+		uint32_t m_Ticks;
+		uint32_t m_Connection;
+		unsigned char m_Direction;
+		unsigned char m_IP[4];
+		uint16_t m_Port;
+		uint16_t m_Length;
+		unsigned char m_Data[CAPTURE_SNAPLEN];
+	};
+
+	string m_File;
+	CCaptureSlot *m_Slots;
+	boost::atomic<uint32_t> m_WritePosition;	// the next ring position to be claimed by a producer
+	uint32_t m_ReadPosition;					// the next ring position to be written to the file (only touched by the writer thread)
+	boost::atomic<uint32_t> m_Dropped;			// number of records dropped since the writer last checked
+	boost::atomic<uint32_t> m_NextConnection;
+	boost::atomic<bool> m_Exiting;				// set to stop the writer thread, also set if the capture file can't be opened
+	boost::thread *m_Thread;
+	uint32_t m_TotalRecords;
+	uint32_t m_TotalDropped;
+
+	void Push( uint32_t connection, unsigned char direction, uint32_t ip, uint16_t port, const unsigned char *data, uint16_t length );
+
+public:
+	CPacketCapture( string nFile );
+	~CPacketCapture( );
+
+	string GetFile( )					{ return m_File; }
+	uint32_t GetNewConnectionID( )		{ return ++m_NextConnection; }
+
+	// called from any thread, ip is in network byte order and port is in host byte order
+
+	void Capture( uint32_t connection, unsigned char direction, uint32_t ip, uint16_t port, const unsigned char *data, uint32_t length );
+
+private:
+	void loop( );
+};
+
+#endif
@@ -19,8 +19,23 @@
 */
 
 #include "ghost.h"
+#include "socket.h"
 #include "commandpacket.h"
 
+//
+// CPacketView
+//
+
+CPacketView :: CPacketView( CByteBuffer *buffer, bool lengthFirst ) : m_Data( (unsigned char *)buffer->GetData( ) ), m_Size( buffer->GetSize( ) ), m_HeaderSize( lengthFirst ? 3 : 4 ), m_LengthFirst( lengthFirst )
+{
+
+}
+
+CPacketView :: ~CPacketView( )
+{
+
+}
+
 //
 // CCommandPacket
 //
@@ -30,7 +45,19 @@ CCommandPacket :: CCommandPacket( unsigned char nPacketType, int nID, BYTEARRAY
 
 }
 
+CCommandPacket :: CCommandPacket( CPacketView &view ) : m_PacketType( view.GetHeader( ) ), m_ID( view.GetID( ) ), m_Data( view.GetData( ), view.GetData( ) + view.GetLength( ) )
+{
+	// this is the only copy of the packet's bytes between the socket's receive buffer and the handler
+}
+
 CCommandPacket :: ~CCommandPacket( )
 {
 
 }
+
+void CCommandPacket :: Assign( CPacketView &view )
+{
+	m_PacketType = view.GetHeader( );
+	m_ID = view.GetID( );
+	m_Data.assign( view.GetData( ), view.GetData( ) + view.GetLength( ) );
+}
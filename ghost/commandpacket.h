@@ -21,6 +21,44 @@
 #ifndef COMMANDPACKET_H
 #define COMMANDPACKET_H
 
+class CByteBuffer;
+
+//
+// CPacketView
+//
+
+// a view of the packet at the front of a socket's receive buffer, the header is parsed in place without copying anything
+// W3GS, GPS and BNCS packets start with a header constant, the packet ID, and the 16 bit little endian length of the whole packet
+// BNLS packets start with the 16 bit little endian length of the whole packet followed by the packet ID
+// warning: the view points into the receive buffer so it's only valid until the buffer is consumed or received into again
+
+class CPacketView
+{
+private:
+	unsigned char *m_Data;
+	uint32_t m_Size;				// number of bytes available at m_Data, this can be more or less than the packet length
+	uint32_t m_HeaderSize;			// 4 for W3GS/GPS/BNCS packets, 3 for BNLS packets
+	bool m_LengthFirst;				// true for BNLS packets
+
+public:
+	CPacketView( CByteBuffer *buffer, bool lengthFirst = false );
+	~CPacketView( );
+
+	bool GetHeaderComplete( )		{ return m_Size >= m_HeaderSize; }
+	unsigned char GetHeader( )		{ return m_LengthFirst ? 0 : m_Data[0]; }
+	unsigned char GetID( )			{ return m_LengthFirst ? m_Data[2] : m_Data[1]; }
+	uint16_t GetLength( )			{ return m_LengthFirst ? GetUInt16( 0 ) : GetUInt16( 2 ); }
+	bool GetValidLength( )			{ return GetLength( ) >= m_HeaderSize; }
+	bool GetComplete( )				{ return GetHeaderComplete( ) && GetValidLength( ) && m_Size >= GetLength( ); }
+	unsigned char *GetData( )		{ return m_Data; }
+
+	// little endian reads at an offset from the start of the packet, the caller must make sure the packet is long enough
+
+	unsigned char GetByte( uint32_t start )		{ return m_Data[start]; }
+	uint16_t GetUInt16( uint32_t start )		{ return (uint16_t)( m_Data[start] | ( m_Data[start + 1] << 8 ) ); }
+	uint32_t GetUInt32( uint32_t start )		{ return (uint32_t)m_Data[start] | ( (uint32_t)m_Data[start + 1] << 8 ) | ( (uint32_t)m_Data[start + 2] << 16 ) | ( (uint32_t)m_Data[start + 3] << 24 ); }
+};
+
 //
 // CCommandPacket
 //
@@ -34,11 +72,16 @@ private:
 
 public:
 	CCommandPacket( unsigned char nPacketType, int nID, BYTEARRAY nData );
+	CCommandPacket( CPacketView &view );
 	~CCommandPacket( );
 
 	unsigned char GetPacketType( )	{ return m_PacketType; }
 	int GetID( )					{ return m_ID; }
-	BYTEARRAY GetData( )			{ return m_Data; }
+	BYTEARRAY &GetData( )			{ return m_Data; }
+
+	// reuse this packet for another packet, the byte storage is kept (see CGamePool)
+
+	void Assign( CPacketView &view );
 };
 
 #endif
@@ -1,17 +1,154 @@
 #include "ghost.h"
 #include "crc32.h"
 
-void CCRC32 :: Initialize( )
+#ifdef CRC32_CLMUL
+ #ifdef _MSC_VER
+  #include <intrin.h>
+ #else
+  #include <cpuid.h>
+ #endif
+
+ #include <emmintrin.h>
+ #include <smmintrin.h>
+ #include <wmmintrin.h>
+
+ #ifdef __GNUC__
+  #define CRC32_CLMUL_TARGET __attribute__(( target( "pclmul,sse4.1" ) ))
+ #else
+  #define CRC32_CLMUL_TARGET
+ #endif
+
+//
+// carry-less multiply CRC32
+// from "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" by Gopal, Ozturk, Guilford, et al. (Intel)
+// the constants are the bit reflected folding constants and Barrett reduction constants for CRC32_POLYNOMIAL given in the paper
+// ulLength must be at least CRC32_CLMUL_MIN and a multiple of 16, ulCRC is the CRC register (not the finished CRC)
+//
+
+CRC32_CLMUL_TARGET static uint32_t CLMULCRC( uint32_t ulCRC, unsigned char *sData, uint32_t ulLength )
+{
+	const __m128i k1k2 = _mm_set_epi64x( 0x01c6e41596LL, 0x0154442bd4LL );
+	const __m128i k3k4 = _mm_set_epi64x( 0x00ccaa009eLL, 0x01751997d0LL );
+	const __m128i k5k0 = _mm_set_epi64x( 0x0000000000LL, 0x0163cd6124LL );
+	const __m128i poly = _mm_set_epi64x( 0x01f7011641LL, 0x01db710641LL );
+	const __m128i mask = _mm_setr_epi32( ~0, 0, ~0, 0 );
+
+	__m128i x1 = _mm_loadu_si128( (__m128i *)( sData + 0x00 ) );
+	__m128i x2 = _mm_loadu_si128( (__m128i *)( sData + 0x10 ) );
+	__m128i x3 = _mm_loadu_si128( (__m128i *)( sData + 0x20 ) );
+	__m128i x4 = _mm_loadu_si128( (__m128i *)( sData + 0x30 ) );
+	__m128i x5;
+	x1 = _mm_xor_si128( x1, _mm_cvtsi32_si128( ulCRC ) );
+	sData += 64;
+	ulLength -= 64;
+
+	// fold four 128 bit lanes in parallel while there are 64 byte blocks left
+
+	while( ulLength >= 64 )
+	{
+		__m128i x6, x7, x8;
+		x5 = _mm_clmulepi64_si128( x1, k1k2, 0x00 );
+		x6 = _mm_clmulepi64_si128( x2, k1k2, 0x00 );
+		x7 = _mm_clmulepi64_si128( x3, k1k2, 0x00 );
+		x8 = _mm_clmulepi64_si128( x4, k1k2, 0x00 );
+		x1 = _mm_clmulepi64_si128( x1, k1k2, 0x11 );
+		x2 = _mm_clmulepi64_si128( x2, k1k2, 0x11 );
+		x3 = _mm_clmulepi64_si128( x3, k1k2, 0x11 );
+		x4 = _mm_clmulepi64_si128( x4, k1k2, 0x11 );
+		x1 = _mm_xor_si128( _mm_xor_si128( x1, x5 ), _mm_loadu_si128( (__m128i *)( sData + 0x00 ) ) );
+		x2 = _mm_xor_si128( _mm_xor_si128( x2, x6 ), _mm_loadu_si128( (__m128i *)( sData + 0x10 ) ) );
+		x3 = _mm_xor_si128( _mm_xor_si128( x3, x7 ), _mm_loadu_si128( (__m128i *)( sData + 0x20 ) ) );
+		x4 = _mm_xor_si128( _mm_xor_si128( x4, x8 ), _mm_loadu_si128( (__m128i *)( sData + 0x30 ) ) );
+		sData += 64;
+		ulLength -= 64;
+	}
+
+	// fold the four lanes into one
+
+	x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+	x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+	x1 = _mm_xor_si128( _mm_xor_si128( x1, x2 ), x5 );
+	x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+	x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+	x1 = _mm_xor_si128( _mm_xor_si128( x1, x3 ), x5 );
+	x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+	x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+	x1 = _mm_xor_si128( _mm_xor_si128( x1, x4 ), x5 );
+
+	// fold in any 16 byte blocks left
+
+	while( ulLength >= 16 )
+	{
+		x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+		x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+		x1 = _mm_xor_si128( _mm_xor_si128( x1, _mm_loadu_si128( (__m128i *)sData ) ), x5 );
+		sData += 16;
+		ulLength -= 16;
+	}
+
+	// fold 128 bits down to 64 bits
+
+	x2 = _mm_clmulepi64_si128( x1, k3k4, 0x10 );
+	x1 = _mm_xor_si128( _mm_srli_si128( x1, 8 ), x2 );
+	x2 = _mm_srli_si128( x1, 4 );
+	x1 = _mm_and_si128( x1, mask );
+	x1 = _mm_clmulepi64_si128( x1, k5k0, 0x00 );
+	x1 = _mm_xor_si128( x1, x2 );
+
+	// Barrett reduce to 32 bits
+
+	x2 = _mm_and_si128( x1, mask );
+	x2 = _mm_clmulepi64_si128( x2, poly, 0x10 );
+	x2 = _mm_and_si128( x2, mask );
+	x2 = _mm_clmulepi64_si128( x2, poly, 0x00 );
+	x1 = _mm_xor_si128( x1, x2 );
+	return _mm_extract_epi32( x1, 1 );
+}
+
+static bool CLMULSupported( )
+{
+	// CPUID leaf 1, ECX bit 1 is PCLMULQDQ and bit 19 is SSE4.1
+
+ #ifdef _MSC_VER
+	int CPUInfo[4];
+	__cpuid( CPUInfo, 1 );
+	unsigned int ECX = CPUInfo[2];
+ #else
+	unsigned int EAX, EBX, ECX, EDX;
+
+	if( !__get_cpuid( 1, &EAX, &EBX, &ECX, &EDX ) )
+		return false;
+ #endif
+
+	return ( ECX & ( 1 << 1 ) ) && ( ECX & ( 1 << 19 ) );
+}
+#endif
+
+void CCRC32 :: Initialize( bool useCLMUL )
 {
 	for( int iCodes = 0; iCodes <= 0xFF; ++iCodes )
 	{
-		ulTable[iCodes] = Reflect( iCodes, 8 ) << 24;
+		ulTable[0][iCodes] = Reflect( iCodes, 8 ) << 24;
 
 		for( int iPos = 0; iPos < 8; iPos++ )
-			ulTable[iCodes] = ( ulTable[iCodes] << 1 ) ^ ( ulTable[iCodes] & (1 << 31) ? CRC32_POLYNOMIAL : 0 );
+			ulTable[0][iCodes] = ( ulTable[0][iCodes] << 1 ) ^ ( ulTable[0][iCodes] & (1 << 31) ? CRC32_POLYNOMIAL : 0 );
+
+		ulTable[0][iCodes] = Reflect( ulTable[0][iCodes], 32 );
+	}
 
-		ulTable[iCodes] = Reflect( ulTable[iCodes], 32 );
+	// the slice-by-8 tables, each one is the previous one followed by a zero byte
+
+	for( int iSlice = 1; iSlice < 8; ++iSlice )
+	{
+		for( int iCodes = 0; iCodes <= 0xFF; ++iCodes )
+			ulTable[iSlice][iCodes] = ( ulTable[iSlice - 1][iCodes] >> 8 ) ^ ulTable[0][ulTable[iSlice - 1][iCodes] & 0xFF];
 	}
+
+#ifdef CRC32_CLMUL
+	bCLMUL = useCLMUL && CLMULSupported( );
+#else
+	bCLMUL = false;
+#endif
 }
 
 uint32_t CCRC32 :: Reflect( uint32_t ulReflect, char cChar )
@@ -38,6 +175,32 @@ uint32_t CCRC32 :: FullCRC( unsigned char *sData, uint32_t ulLength )
 
 void CCRC32 :: PartialCRC( uint32_t *ulInCRC, unsigned char *sData, uint32_t ulLength )
 {
+	uint32_t ulCRC = *ulInCRC;
+
+#ifdef CRC32_CLMUL
+	if( bCLMUL && ulLength >= CRC32_CLMUL_MIN )
+	{
+		uint32_t ulBlocks = ulLength & ~15;
+		ulCRC = CLMULCRC( ulCRC, sData, ulBlocks );
+		sData += ulBlocks;
+		ulLength -= ulBlocks;
+	}
+#endif
+
+	// slice-by-8, the bytes are loaded one at a time so this works on any byte order
+
+	while( ulLength >= 8 )
+	{
+		uint32_t ulOne = ulCRC ^ ( sData[0] | ( sData[1] << 8 ) | ( sData[2] << 16 ) | ( (uint32_t)sData[3] << 24 ) );
+		uint32_t ulTwo = sData[4] | ( sData[5] << 8 ) | ( sData[6] << 16 ) | ( (uint32_t)sData[7] << 24 );
+		ulCRC = ulTable[7][ulOne & 0xFF] ^ ulTable[6][( ulOne >> 8 ) & 0xFF] ^ ulTable[5][( ulOne >> 16 ) & 0xFF] ^ ulTable[4][ulOne >> 24] ^
+				ulTable[3][ulTwo & 0xFF] ^ ulTable[2][( ulTwo >> 8 ) & 0xFF] ^ ulTable[1][( ulTwo >> 16 ) & 0xFF] ^ ulTable[0][ulTwo >> 24];
+		sData += 8;
+		ulLength -= 8;
+	}
+
 	while( ulLength-- )
-		*ulInCRC = ( *ulInCRC >> 8 ) ^ ulTable[( *ulInCRC & 0xFF ) ^ *sData++];
+		ulCRC = ( ulCRC >> 8 ) ^ ulTable[0][( ulCRC & 0xFF ) ^ *sData++];
+
+	*ulInCRC = ulCRC;
 }
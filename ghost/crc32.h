@@ -3,16 +3,29 @@
 
 #define CRC32_POLYNOMIAL 0x04c11db7
 
+// CRC32_CLMUL is defined when we know how to build the carry-less multiply version for this compiler and CPU architecture
+// whether the CPU we're running on actually supports it is checked in Initialize
+
+#if ( defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) ) ) || ( defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) ) )
+ #define CRC32_CLMUL
+#endif
+
+// the carry-less multiply version folds 64 bytes at a time so it's only used for buffers at least this big
+
+#define CRC32_CLMUL_MIN 64
+
 class CCRC32
 {
 public:
-	void Initialize( );
+	void Initialize( bool useCLMUL = true );		// useCLMUL false forces the slice-by-8 version (for testing)
 	uint32_t FullCRC( unsigned char *sData, uint32_t ulLength );
 	void PartialCRC( uint32_t *ulInCRC, unsigned char *sData, uint32_t ulLength );
+	bool GetCLMUL( )		{ return bCLMUL; }
 
 private:
 	uint32_t Reflect( uint32_t ulReflect, char cChar );
-	uint32_t ulTable[256];
+	uint32_t ulTable[8][256];		// ulTable[0] is the usual byte at a time table, ulTable[n] advances the CRC over a byte followed by n zero bytes (for slice-by-8)
+	bool bCLMUL;					// true if the CPU supports the carry-less multiply version
 };
 
 #endif
@@ -32,6 +32,9 @@
 #include "gameprotocol.h"
 #include "game_base.h"
 #include "game.h"
+#include "gamepool.h"
+#include "latency.h"
+#include "timerwheel.h"
 #include "stats.h"
 #include "statsdota.h"
 #include "statsw3mmd.h"
@@ -142,7 +145,19 @@ CGame :: ~CGame( )
 	}
 }
 
-bool CGame :: Update( void *fd, void *send_fd )
+uint32_t CGame :: GetNextTimerTicks( )
+{
+	// threaded database calls are polled in Update so keep polling while any of them are in progress
+
+	uint32_t Ticks = CBaseGame :: GetNextTimerTicks( );
+
+	if( !m_PairedBanChecks.empty( ) || !m_PairedBanAdds.empty( ) || !m_PairedGPSChecks.empty( ) || !m_PairedDPSChecks.empty( ) )
+		Ticks = min( Ticks, (uint32_t)TIMERWHEEL_OVERDUE );
+
+	return Ticks;
+}
+
+bool CGame :: Update( )
 {
 	// update callables
 
@@ -289,7 +304,7 @@ bool CGame :: Update( void *fd, void *send_fd )
 			++i;
 	}
 
-	return CBaseGame :: Update( fd, send_fd );
+	return CBaseGame :: Update( );
 }
 
 void CGame :: EventPlayerDeleted( CGamePlayer *player )
@@ -968,10 +983,8 @@ bool CGame :: EventPlayerBotCommand( CGamePlayer *player, string command, string
 
 			else if( Command == "fppause" && m_FakePlayerPID != 255 && m_GameLoaded )
 			{
-				BYTEARRAY CRC;
-				BYTEARRAY Action;
-				Action.push_back( 1 );
-				m_Actions.push( new CIncomingAction( m_FakePlayerPID, CRC, Action ) );
+				unsigned char Action = 1;
+				m_Actions.push_back( m_Pool->NewIncomingAction( m_FakePlayerPID, NULL, 0, &Action, 1 ) );
 			}
 
 			//
@@ -980,10 +993,8 @@ bool CGame :: EventPlayerBotCommand( CGamePlayer *player, string command, string
 
 			else if( Command == "fpresume" && m_FakePlayerPID != 255 && m_GameLoaded )
 			{
-				BYTEARRAY CRC;
-				BYTEARRAY Action;
-				Action.push_back( 2 );
-				m_Actions.push( new CIncomingAction( m_FakePlayerPID, CRC, Action ) );
+				unsigned char Action = 2;
+				m_Actions.push_back( m_Pool->NewIncomingAction( m_FakePlayerPID, NULL, 0, &Action, 1 ) );
 			}
 
 			//
@@ -1110,9 +1121,26 @@ bool CGame :: EventPlayerBotCommand( CGamePlayer *player, string command, string
 			else if( Command == "latency" )
 			{
 				if( Payload.empty( ) )
-					SendAllChat( m_GHost->m_Language->LatencyIs( UTIL_ToString( m_Latency ) ) );
+				{
+					if( m_LatencyController )
+						SendAllChat( m_GHost->m_Language->LatencyIsAutomatic( UTIL_ToString( m_Latency ), UTIL_ToString( m_LatencyController->GetMinimum( ) ), UTIL_ToString( m_LatencyController->GetMaximum( ) ) ) );
+					else
+						SendAllChat( m_GHost->m_Language->LatencyIs( UTIL_ToString( m_Latency ) ) );
+				}
+				else if( Payload == "auto" )
+				{
+					if( !m_LatencyController )
+						m_LatencyController = new CLatencyController( m_GHost->m_AutoLatencyMin, m_GHost->m_AutoLatencyMax );
+
+					m_Latency = m_LatencyController->Clamp( m_Latency );
+					SendAllChat( m_GHost->m_Language->SettingLatencyToAutomatic( UTIL_ToString( m_LatencyController->GetMinimum( ) ), UTIL_ToString( m_LatencyController->GetMaximum( ) ) ) );
+				}
 				else
 				{
+					// setting the latency by hand turns off the latency controller
+
+					delete m_LatencyController;
+					m_LatencyController = NULL;
 					m_Latency = UTIL_ToUInt32( Payload );
 
 					if( m_Latency <= 20 )
@@ -1130,6 +1158,13 @@ bool CGame :: EventPlayerBotCommand( CGamePlayer *player, string command, string
 				}
 			}
 
+			//
+			// !JITTER (show how late the action updates were sent)
+			//
+
+			else if( Command == "jitter" )
+				SendAllChat( m_TickHistogram->GetStatus( ) );
+
 			//
 			// !LOCK
 			//
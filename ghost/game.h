@@ -58,7 +58,8 @@ public:
 	CGame( CGHost *nGHost, CMap *nMap, CSaveGame *nSaveGame, uint16_t nHostPort, unsigned char nGameState, string nGameName, string nOwnerName, string nCreatorName, string nCreatorServer );
 	virtual ~CGame( );
 
-	virtual bool Update( void *fd, void *send_fd );
+	virtual uint32_t GetNextTimerTicks( );
+	virtual bool Update( );
 	virtual void EventPlayerDeleted( CGamePlayer *player );
 	virtual bool EventPlayerAction( CGamePlayer *player, CIncomingAction *action );
 	virtual bool EventPlayerBotCommand( CGamePlayer *player, string command, string payload );
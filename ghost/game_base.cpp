@@ -23,6 +23,8 @@
 #include "config.h"
 #include "language.h"
 #include "socket.h"
+#include "reactor.h"
+#include "timerwheel.h"
 #include "ghostdb.h"
 #include "bnet.h"
 #include "map.h"
@@ -32,6 +34,11 @@
 #include "gameplayer.h"
 #include "gameprotocol.h"
 #include "game_base.h"
+#include "gamepool.h"
+#include "latency.h"
+#include "syncframes.h"
+#include "gameworker.h"
+#include "governor.h"
 
 #include <cmath>
 #include <string.h>
@@ -43,12 +50,27 @@
 // CBaseGame
 //
 
-CBaseGame :: CBaseGame( CGHost *nGHost, CMap *nMap, CSaveGame *nSaveGame, uint16_t nHostPort, unsigned char nGameState, string nGameName, string nOwnerName, string nCreatorName, string nCreatorServer ) : m_GHost( nGHost ), m_SaveGame( nSaveGame ), m_Replay( NULL ), m_Exiting( false ), m_Saving( false ), m_HostPort( nHostPort ), m_GameState( nGameState ), m_VirtualHostPID( 255 ), m_FakePlayerPID( 255 ), m_GProxyEmptyActions( 0 ), m_GameName( nGameName ), m_LastGameName( nGameName ), m_VirtualHostName( m_GHost->m_VirtualHostName ), m_OwnerName( nOwnerName ), m_CreatorName( nCreatorName ), m_CreatorServer( nCreatorServer ), m_HCLCommandString( nMap->GetMapDefaultHCL( ) ), m_RandomSeed( GetTicks( ) ), m_HostCounter( m_GHost->m_HostCounter++ ), m_EntryKey( rand( ) ), m_Latency( m_GHost->m_Latency ), m_SyncLimit( m_GHost->m_SyncLimit ), m_SyncCounter( 0 ), m_GameTicks( 0 ), m_CreationTime( GetTime( ) ), m_LastPingTime( GetTime( ) ), m_LastRefreshTime( GetTime( ) ), m_LastDownloadTicks( GetTime( ) ), m_DownloadCounter( 0 ), m_LastDownloadCounterResetTicks( GetTime( ) ), m_LastAnnounceTime( 0 ), m_AnnounceInterval( 0 ), m_LastAutoStartTime( GetTime( ) ), m_AutoStartPlayers( 0 ), m_LastCountDownTicks( 0 ), m_CountDownCounter( 0 ), m_StartedLoadingTicks( 0 ), m_StartPlayers( 0 ), m_LastLagScreenResetTime( 0 ), m_LastActionSentTicks( 0 ), m_LastActionLateBy( 0 ), m_StartedLaggingTime( 0 ), m_LastLagScreenTime( 0 ), m_LastReservedSeen( GetTime( ) ), m_StartedKickVoteTime( 0 ), m_GameOverTime( 0 ), m_LastPlayerLeaveTicks( 0 ), m_MinimumScore( 0. ), m_MaximumScore( 0. ), m_SlotInfoChanged( false ), m_Locked( false ), m_RefreshMessages( m_GHost->m_RefreshMessages ), m_RefreshError( false ), m_RefreshRehosted( false ), m_MuteAll( false ), m_MuteLobby( false ), m_CountDownStarted( false ), m_GameLoading( false ), m_GameLoaded( false ), m_LoadInGame( nMap->GetMapLoadInGame( ) ), m_Lagging( false ), m_AutoSave( m_GHost->m_AutoSave ), m_MatchMaking( false ), m_DoDelete( 0 ), m_LastReconnectHandleTime( 0 )
+CBaseGame :: CBaseGame( CGHost *nGHost, CMap *nMap, CSaveGame *nSaveGame, uint16_t nHostPort, unsigned char nGameState, string nGameName, string nOwnerName, string nCreatorName, string nCreatorServer ) : m_GHost( nGHost ), m_SaveGame( nSaveGame ), m_Replay( NULL ), m_Exiting( false ), m_Saving( false ), m_HostPort( nHostPort ), m_GameState( nGameState ), m_VirtualHostPID( 255 ), m_FakePlayerPID( 255 ), m_GProxyEmptyActions( 0 ), m_GameName( nGameName ), m_LastGameName( nGameName ), m_VirtualHostName( m_GHost->m_VirtualHostName ), m_OwnerName( nOwnerName ), m_CreatorName( nCreatorName ), m_CreatorServer( nCreatorServer ), m_HCLCommandString( nMap->GetMapDefaultHCL( ) ), m_RandomSeed( GetTicks( ) ), m_HostCounter( m_GHost->m_HostCounter++ ), m_EntryKey( rand( ) ), m_Latency( m_GHost->m_Latency ), m_SyncLimit( m_GHost->m_SyncLimit ), m_SyncCounter( 0 ), m_GameTicks( 0 ), m_CreationTime( GetTime( ) ), m_LastPingTime( GetTime( ) ), m_LastRefreshTime( GetTime( ) ), m_LastDownloadTicks( GetTime( ) ), m_DownloadRoundRobin( 0 ), m_LastSlotInfoTicks( GetTicks( ) ), m_LastAnnounceTime( 0 ), m_AnnounceInterval( 0 ), m_LastAutoStartTime( GetTime( ) ), m_AutoStartPlayers( 0 ), m_LastCountDownTicks( 0 ), m_CountDownCounter( 0 ), m_StartedLoadingTicks( 0 ), m_StartPlayers( 0 ), m_LastLagScreenResetTime( 0 ), m_LastActionSentTicks( 0 ), m_LastActionLateBy( 0 ), m_StartedLaggingTime( 0 ), m_LastLagScreenTime( 0 ), m_LastReservedSeen( GetTime( ) ), m_StartedKickVoteTime( 0 ), m_GameOverTime( 0 ), m_LastPlayerLeaveTicks( 0 ), m_MinimumScore( 0. ), m_MaximumScore( 0. ), m_SlotInfoChanged( false ), m_Locked( false ), m_RefreshMessages( m_GHost->m_RefreshMessages ), m_RefreshError( false ), m_RefreshRehosted( false ), m_MuteAll( false ), m_MuteLobby( false ), m_CountDownStarted( false ), m_GameLoading( false ), m_GameLoaded( false ), m_LoadInGame( nMap->GetMapLoadInGame( ) ), m_Lagging( false ), m_AutoSave( m_GHost->m_AutoSave ), m_MatchMaking( false ), m_DoDelete( 0 ), m_Worker( NULL )
 {
 	m_Socket = new CTCPServer( );
+	m_Reactor = NULL;
+	m_Timers = NULL;
+	m_UpdateTimer = new CTimer( );
 	m_Protocol = new CGameProtocol( m_GHost );
+	m_Pool = new CGamePool( );
 	m_Map = new CMap( *nMap );
 
+	if( m_GHost->m_AutoLatency )
+	{
+		m_LatencyController = new CLatencyController( m_GHost->m_AutoLatencyMin, m_GHost->m_AutoLatencyMax );
+		m_Latency = m_LatencyController->Clamp( m_Latency );
+	}
+	else
+		m_LatencyController = NULL;
+
+	m_TickHistogram = new CTickHistogram( );
+	m_SyncFrames = new CSyncFrames( );
+
 	if( m_GHost->m_SaveReplays && !m_SaveGame )
 		m_Replay = new CReplay( );	
 
@@ -137,7 +159,9 @@ CBaseGame :: CBaseGame( CGHost *nGHost, CMap *nMap, CSaveGame *nSaveGame, uint16
 		BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] attempting to bind to all available addresses";
 
 	if( m_Socket->Listen( m_GHost->m_BindAddress, m_HostPort ) )
+	{
 		BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] listening on port " + UTIL_ToString( m_HostPort );
+	}
 	else
 	{
 		BOOST_LOG_TRIVIAL(warning) << "[GAME: " + m_GameName + "] error listening on port " + UTIL_ToString( m_HostPort );
@@ -147,6 +171,8 @@ CBaseGame :: CBaseGame( CGHost *nGHost, CMap *nMap, CSaveGame *nSaveGame, uint16
 
 CBaseGame :: ~CBaseGame( )
 {
+	m_GHost->m_DownloadGovernor->Remove( this );
+	delete m_UpdateTimer;
 	delete m_Socket;
 	delete m_Protocol;
 	delete m_Map;
@@ -165,16 +191,24 @@ CBaseGame :: ~CBaseGame( )
 	
 	lock.unlock( );
 
-	while( !m_Actions.empty( ) )
-	{
-		delete m_Actions.front( );
-		m_Actions.pop( );
-	}
+	for( deque<CIncomingAction *> :: iterator i = m_Actions.begin( ); i != m_Actions.end( ); ++i )
+		delete *i;
+
+	delete m_LatencyController;
+	delete m_TickHistogram;
+	delete m_SyncFrames;
+	delete m_Pool;
 }
 
 void CBaseGame :: doDelete( )
 {
+	// the worker may delete us as soon as m_DoDelete is set so don't touch m_Worker afterwards
+
+	CGameWorker *Worker = m_Worker;
 	m_DoDelete = 1;
+
+	if( Worker )
+		Worker->Wake( );
 }
 
 bool CBaseGame :: readyDelete( )
@@ -182,59 +216,53 @@ bool CBaseGame :: readyDelete( )
 	return m_DoDelete == 2;
 }
 
-void CBaseGame :: loop( )
+void CBaseGame :: Wake( )
 {
-	while( m_DoDelete == 0 )
-	{
-		fd_set fd;
-		fd_set send_fd;
-		FD_ZERO( &fd );
-		FD_ZERO( &send_fd );
-		
-		int nfds = 0;
-		unsigned int NumFDs = SetFD( &fd, &send_fd, &nfds );
-		
-		long usecBlock = 50000;
-		
-		if( GetNextTimedActionTicks( ) * 1000 < usecBlock )
-			usecBlock = GetNextTimedActionTicks( ) * 1000;
+	// call this from another thread after queueing something for the game (e.g. m_DoSayGames) so it's handled right away
 
-		if(usecBlock < 1000) usecBlock = 1000;
-		
-		struct timeval tv;
-		tv.tv_sec = 0;
-		tv.tv_usec = usecBlock;
-
-		struct timeval send_tv;
-		send_tv.tv_sec = 0;
-		send_tv.tv_usec = 0;
+	if( m_Worker )
+		m_Worker->Wake( );
+}
 
-#ifdef WIN32
-		select( 1, &fd, NULL, NULL, &tv );
-		select( 1, NULL, &send_fd, NULL, &send_tv );
-#else
-		select( nfds + 1, &fd, NULL, NULL, &tv );
-		select( nfds + 1, NULL, &send_fd, NULL, &send_tv );
-#endif
+bool CBaseGame :: Run( )
+{
+	// this is called by the game's worker once per loop, see CGameWorker :: loop
+	// returns true when the game has finished and has been handed back for deletion, the worker must not touch it afterwards
 
-		if( NumFDs == 0 )
+	if( m_DoDelete == 0 )
+	{
+		if( Update( ) )
 		{
-			// select will return immediately and we'll chew up the CPU if we let it loop so just sleep for 50ms to kill some time
-			MILLISLEEP( 50 );
-		}
+			BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] deleting game";
+
+			if( m_TickHistogram->GetNumUpdates( ) > 0 )
+				BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] action update timing - " + m_TickHistogram->GetStatus( );
+
+			if( m_Pool->GetTotalAllocations( ) + m_Pool->GetTotalReused( ) > 0 )
+				BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] packet and action pool - " + UTIL_ToString( m_Pool->GetTotalReused( ) ) + " objects reused, " + UTIL_ToString( m_Pool->GetTotalAllocations( ) ) + " heap allocations of pooled objects";
 
-		if( Update( &fd, &send_fd ) )
-		{
-			BOOST_LOG_TRIVIAL(info) << "[GameThread] deleting game [" + GetGameName( ) + "]";
 			m_DoDelete = 3;
-			break;
 		}
 		else
-		{
-			UpdatePost( &send_fd );
-		}
+			UpdatePost( );
 	}
-	
+
+	if( m_DoDelete == 0 )
+	{
+		// sleep until the next timer is due unless a socket becomes ready before then
+
+		if( m_Timers )
+			m_Timers->Schedule( m_UpdateTimer, GetNextTimerTicks( ) );
+
+		return false;
+	}
+
+	Finish( );
+	return true;
+}
+
+void CBaseGame :: Finish( )
+{
 	// save replay
 	if( m_Replay && ( m_GameLoading || m_GameLoaded ) )
 	{
@@ -255,12 +283,62 @@ void CBaseGame :: loop( )
 		m_Replay->Save( m_GHost->m_TFT, m_GHost->m_ReplayPath + UTIL_FileSafeName( "GHost++ " + string( Time ) + " " + m_GameName + " (" + MinString + "m" + SecString + "s).w3g" ) );
 	}
 
-	if(m_DoDelete == 1)
+	// detach our sockets and timers from the worker before the main thread gets a chance to delete us
+
+	SetWorker( NULL );
+
+	if( m_DoDelete == 1 )
 		delete this;
 	else
 		m_DoDelete = 2;
 }
 
+void CBaseGame :: SetWorker( CGameWorker *nWorker )
+{
+	// move the listening socket and every connection over to the worker's reactor and our update timer to its timer wheel (or detach them if nWorker is NULL)
+	// this must be called from the worker thread since neither the reactor nor the timer wheel are thread safe
+
+	CSocketReactor *nReactor = nWorker ? nWorker->GetReactor( ) : NULL;
+
+	vector<CTCPSocket *> Sockets;
+
+	if( m_Socket && m_Socket->GetFD( ) != INVALID_SOCKET )
+		Sockets.push_back( m_Socket );
+
+	for( vector<CPotentialPlayer *> :: iterator i = m_Potentials.begin( ); i != m_Potentials.end( ); ++i )
+	{
+		if( (*i)->GetSocket( ) )
+			Sockets.push_back( (*i)->GetSocket( ) );
+	}
+
+	for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
+	{
+		if( (*i)->GetSocket( ) )
+			Sockets.push_back( (*i)->GetSocket( ) );
+	}
+
+	for( vector<CTCPSocket *> :: iterator i = Sockets.begin( ); i != Sockets.end( ); ++i )
+	{
+		if( (*i)->GetReactor( ) )
+			(*i)->GetReactor( )->Remove( *i );
+
+		if( nReactor && !(*i)->HasError( ) && ( *i == m_Socket || (*i)->GetConnected( ) ) )
+			nReactor->Add( *i );
+	}
+
+	m_Reactor = nReactor;
+
+	if( m_Timers )
+		m_Timers->Cancel( m_UpdateTimer );
+
+	m_Timers = nWorker ? nWorker->GetTimers( ) : NULL;
+
+	// update the game as soon as the worker picks it up
+
+	if( m_Timers )
+		m_Timers->Schedule( m_UpdateTimer, 0 );
+}
+
 uint32_t CBaseGame :: GetNextTimedActionTicks( )
 {
 	// return the number of ticks (ms) until the next "timed action", which for our purposes is the next game update
@@ -279,6 +357,147 @@ uint32_t CBaseGame :: GetNextTimedActionTicks( )
 		return m_Latency - m_LastActionLateBy - TicksSinceLastUpdate;
 }
 
+uint32_t CBaseGame :: GetNextTimerTicks( )
+{
+	// return the number of ticks (ms) until the next timer checked in Update expires
+	// this covers the action timer from GetNextTimedActionTicks as well as every other game and player timer
+	// the worker won't update the game again until then unless one of its sockets becomes ready first
+	// warning: every new timer in Update has to be added here too or it'll only be checked when something else wakes the game up
+	// note: anything queued by other threads (e.g. m_DoSayGames, pending reconnects, refresh errors) wakes up the worker, see CGameWorker :: Wake
+
+	uint32_t Ticks = 1000;
+
+	if( m_GameLoaded && !m_Lagging )
+		Ticks = min( Ticks, GetNextTimedActionTicks( ) );
+
+	Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_LastPingTime, 5 ) );
+
+	if( !m_RefreshError && !m_CountDownStarted && m_GameState == GAME_PUBLIC && GetSlotsOpen( ) > 0 )
+		Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_LastRefreshTime, 3 ) );
+
+	if( !m_GameLoading && !m_GameLoaded )
+	{
+		bool Downloading = false;
+
+		for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
+		{
+			if( (*i)->GetDownloadStarted( ) && !(*i)->GetDownloadFinished( ) )
+				Downloading = true;
+		}
+
+		if( m_SlotInfoChanged )
+			Ticks = min( Ticks, CTimerWheel :: TicksUntil( m_LastSlotInfoTicks, 1000 ) );
+
+		if( Downloading )
+			Ticks = min( Ticks, CTimerWheel :: TicksUntil( m_LastDownloadTicks, 100 ) );
+
+		if( m_AutoStartPlayers == 0 && m_GHost->m_LobbyTimeLimit > 0 )
+			Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_LastReservedSeen, m_GHost->m_LobbyTimeLimit * 60 ) );
+	}
+
+	if( !m_AnnounceMessage.empty( ) && !m_CountDownStarted )
+		Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_LastAnnounceTime, m_AnnounceInterval ) );
+
+	if( !m_CountDownStarted && m_GHost->m_RequireSpoofChecks && m_GameState == GAME_PUBLIC && !m_GHost->m_AutoHostGameName.empty( ) && m_GHost->m_AutoHostMaximumGames != 0 && m_GHost->m_AutoHostAutoStartPlayers != 0 && m_AutoStartPlayers != 0 )
+	{
+		for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
+		{
+			if( !(*i)->GetSpoofed( ) )
+				Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( (*i)->GetJoinTime( ), 20 ) );
+		}
+	}
+
+	if( !m_CountDownStarted && m_AutoStartPlayers != 0 )
+		Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_LastAutoStartTime, 10 ) );
+
+	if( m_CountDownStarted && !m_GameLoading && !m_GameLoaded )
+		Ticks = min( Ticks, CTimerWheel :: TicksUntil( m_LastCountDownTicks, 500 ) );
+
+	if( m_GameLoading && m_LoadInGame )
+		Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_LastLagScreenResetTime, 30 ) );
+
+	if( m_GameLoaded && m_Lagging )
+	{
+		// the lag screen is reset every 60 seconds and the laggers are dropped after WaitTime seconds (see Update)
+
+		uint32_t WaitTime = 60;
+
+		for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
+		{
+			if( (*i)->GetGProxy( ) )
+				WaitTime = ( m_GProxyEmptyActions + 1 ) * 60;
+		}
+
+		Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_StartedLaggingTime, WaitTime ) );
+		Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_LastLagScreenResetTime, 60 ) );
+	}
+
+	if( !m_KickVotePlayer.empty( ) )
+		Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_StartedKickVoteTime, 60 ) );
+
+	if( m_StartedVoteStartTime != 0 )
+		Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_StartedVoteStartTime, 180 ) );
+
+	if( m_GameOverTime != 0 )
+		Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_GameOverTime, 60 ) );
+
+	// threaded database calls are polled like they always were
+
+	if( !m_ScoreChecks.empty( ) || m_Saving )
+		Ticks = min( Ticks, (uint32_t)TIMERWHEEL_OVERDUE );
+
+	// player timers, and sockets the reactor couldn't register are polled like they always were
+
+	for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
+	{
+		Ticks = min( Ticks, (*i)->GetNextTimerTicks( ) );
+
+		if( (*i)->GetSocket( ) && (*i)->GetSocket( )->GetFD( ) != INVALID_SOCKET && !(*i)->GetSocket( )->GetReactor( ) )
+			Ticks = min( Ticks, (uint32_t)TIMERWHEEL_OVERDUE );
+	}
+
+	for( vector<CPotentialPlayer *> :: iterator i = m_Potentials.begin( ); i != m_Potentials.end( ); ++i )
+	{
+		if( (*i)->GetSocket( ) && (*i)->GetSocket( )->GetFD( ) != INVALID_SOCKET && !(*i)->GetSocket( )->GetReactor( ) )
+			Ticks = min( Ticks, (uint32_t)TIMERWHEEL_OVERDUE );
+	}
+
+	if( m_Socket && m_Socket->GetFD( ) != INVALID_SOCKET && !m_Socket->GetReactor( ) )
+		Ticks = min( Ticks, (uint32_t)TIMERWHEEL_OVERDUE );
+
+	return Ticks;
+}
+
+bool CBaseGame :: GetUpdateDue( )
+{
+	// return true if the game needs to be updated on this loop of its worker
+	// that's when its update timer expired, one of its sockets is ready, or it's being deleted
+
+	if( m_DoDelete != 0 || !m_Timers || m_UpdateTimer->GetExpired( ) || !m_UpdateTimer->GetPending( ) )
+		return true;
+
+	if( m_Socket && m_Socket->GetReactor( ) && m_Socket->GetReadable( ) )
+		return true;
+
+	for( vector<CPotentialPlayer *> :: iterator i = m_Potentials.begin( ); i != m_Potentials.end( ); ++i )
+	{
+		CTCPSocket *Socket = (*i)->GetSocket( );
+
+		if( Socket && Socket->GetReactor( ) && ( Socket->GetReadable( ) || ( Socket->GetWritable( ) && Socket->GetSendPending( ) ) ) )
+			return true;
+	}
+
+	for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
+	{
+		CTCPSocket *Socket = (*i)->GetSocket( );
+
+		if( Socket && Socket->GetReactor( ) && ( Socket->GetReadable( ) || ( Socket->GetWritable( ) && Socket->GetSendPending( ) ) ) )
+			return true;
+	}
+
+	return false;
+}
+
 uint32_t CBaseGame :: GetSlotsOccupied( )
 {
 	uint32_t NumSlotsOccupied = 0;
@@ -347,38 +566,7 @@ void CBaseGame :: SetAnnounce( uint32_t interval, string message )
 	m_LastAnnounceTime = GetTime( );
 }
 
-unsigned int CBaseGame :: SetFD( void *fd, void *send_fd, int *nfds )
-{
-	unsigned int NumFDs = 0;
-
-	if( m_Socket )
-	{
-		m_Socket->SetFD( (fd_set *)fd, (fd_set *)send_fd, nfds );
-		++NumFDs;
-	}
-
-	for( vector<CPotentialPlayer *> :: iterator i = m_Potentials.begin( ); i != m_Potentials.end( ); ++i )
-	{
-		if( (*i)->GetSocket( ) )
-		{
-			(*i)->GetSocket( )->SetFD( (fd_set *)fd, (fd_set *)send_fd, nfds );
-			++NumFDs;
-		}
-	}
-
-	for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
-	{
-		if( (*i)->GetSocket( ) )
-		{
-			(*i)->GetSocket( )->SetFD( (fd_set *)fd, (fd_set *)send_fd, nfds );
-			++NumFDs;
-		}
-	}
-
-	return NumFDs;
-}
-
-bool CBaseGame :: Update( void *fd, void *send_fd )
+bool CBaseGame :: Update( )
 {
 	// update callables
 
@@ -406,7 +594,7 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 
 	for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); )
 	{
-		if( (*i)->Update( fd ) )
+		if( (*i)->Update( ) )
 		{
 			EventPlayerDeleted( *i );
 			delete *i;
@@ -418,12 +606,12 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 
 	for( vector<CPotentialPlayer *> :: iterator i = m_Potentials.begin( ); i != m_Potentials.end( ); )
 	{
-		if( (*i)->Update( fd ) )
+		if( (*i)->Update( ) )
 		{
 			// flush the socket (e.g. in case a rejection message is queued)
 
 			if( (*i)->GetSocket( ) )
-				(*i)->GetSocket( )->DoSend( (fd_set *)send_fd );
+				(*i)->GetSocket( )->DoSend( );
 
 			delete *i;
 			i = m_Potentials.erase( i );
@@ -569,51 +757,80 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 		m_LastRefreshTime = GetTime( );
 	}
 
-	// send more map data
+	// update the slot info if necessary
+	// slot changes are batched and sent at most once per second
 
-	if( !m_GameLoading && !m_GameLoaded && GetTicks( ) - m_LastDownloadCounterResetTicks >= 1000 )
+	if( !m_GameLoading && !m_GameLoaded && GetTicks( ) - m_LastSlotInfoTicks >= 1000 )
 	{
-		// hackhack: another timer hijack is in progress here
-		// since the download counter is reset once per second it's a great place to update the slot info if necessary
-
 		if( m_SlotInfoChanged )
 			SendAllSlotInfo( );
 
-		m_DownloadCounter = 0;
-		m_LastDownloadCounterResetTicks = GetTicks( );
+		m_LastSlotInfoTicks = GetTicks( );
 	}
 
+	// send more map data
+
 	if( !m_GameLoading && !m_GameLoaded && GetTicks( ) - m_LastDownloadTicks >= 100 )
 	{
-		uint32_t Downloaders = 0;
+		// the map is sent in pieces and each player can have up to its download window of unacknowledged map data in flight
+		// the window is sized from the player's measured round trip time and download rate (see CGamePlayer :: EventMapPartAcked) so a fast player gets as much as it can take
+		// while a slow player (e.g. dialup) only has about one round trip's worth of map data queued in front of the lobby packets (players joining and leaving, slot changes, chat messages)
+		// we also skip a player whose socket can't take any more data right now, otherwise the map data would just pile up in our send queue instead
+		// the players take turns getting one piece at a time (round robin) so when the download limit is hit every downloader gets a fair share instead of the first player in the list getting it all
+		// the player who goes first changes every time so nobody is always last in line either
+		// the download limit is shared by every game on the bot, we ask the download governor for as much as our downloaders can take and send what we're given
+
+		vector<CGamePlayer *> Downloaders;
 
 		for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
 		{
 			if( (*i)->GetDownloadStarted( ) && !(*i)->GetDownloadFinished( ) )
 			{
-				++Downloaders;
-
-				if( m_GHost->m_MaxDownloaders > 0 && Downloaders > m_GHost->m_MaxDownloaders )
+				if( m_GHost->m_MaxDownloaders > 0 && Downloaders.size( ) >= m_GHost->m_MaxDownloaders )
 					break;
 
-				// send up to 250 pieces of the map at once so that the download goes faster
-				// if we wait for each MAPPART packet to be acknowledged by the client it'll take a long time to download
-				// this is because we would have to wait the round trip time (the ping time) between sending every 1442 bytes of map data
-				// doing it this way allows us to send at least 140 KB in each round trip interval which is much more reasonable
-				// the theoretical throughput is [140 KB * 1000 / ping] in KB/sec so someone with 100 ping (round trip ping, not LC ping) could download at 1400 KB/sec
-				// note: this creates a queue of map data which clogs up the connection when the client is on a slower connection (e.g. dialup)
-				// in this case any changes to the lobby are delayed by the amount of time it takes to send the queued data (i.e. 140 KB, which could be 30 seconds or more)
-				// for example, players joining and leaving, slot changes, chat messages would all appear to happen much later for the low bandwidth player
-				// note: the throughput is also limited by the number of times this code is executed each second
-				// e.g. if we send the maximum amount (140 KB) 10 times per second the theoretical throughput is 1400 KB/sec
-				// therefore the maximum throughput is 1400 KB/sec regardless of ping and this value slowly diminishes as the player's ping increases
-				// in addition to this, the throughput is limited by the configuration value bot_maxdownloadspeed
-				// in summary: the actual throughput is MIN( 140 * 1000 / ping, 1400, bot_maxdownloadspeed ) in KB/sec assuming only one player is downloading the map
-
-				uint32_t MapSize = UTIL_ByteArrayToUInt32( m_Map->GetMapSize( ), false );
-
-				while( (*i)->GetLastMapPartSent( ) < (*i)->GetLastMapPartAcked( ) + 1442 * 250 && (*i)->GetLastMapPartSent( ) < MapSize )
+				Downloaders.push_back( *i );
+			}
+		}
+
+		if( !Downloaders.empty( ) )
+		{
+			uint32_t MapSize = UTIL_ByteArrayToUInt32( m_Map->GetMapSize( ), false );
+			m_DownloadRoundRobin = ( m_DownloadRoundRobin + 1 ) % Downloaders.size( );
+			rotate( Downloaders.begin( ), Downloaders.begin( ) + m_DownloadRoundRobin, Downloaders.end( ) );
+			uint32_t Demand = 0;
+
+			for( vector<CGamePlayer *> :: iterator i = Downloaders.begin( ); i != Downloaders.end( ); ++i )
+			{
+				uint32_t End = min( (*i)->GetLastMapPartAcked( ) + (*i)->GetDownloadWindow( ), MapSize );
+
+				if( (*i)->GetLastMapPartSent( ) < End && (*i)->GetSocket( ) && (*i)->GetSocket( )->GetWritable( ) )
+					Demand += End - (*i)->GetLastMapPartSent( );
+			}
+
+			int32_t Granted = Demand > 0 ? m_GHost->m_DownloadGovernor->Request( this, Demand ) : 0;
+			bool Sent = Granted > 0;
+
+			while( Sent )
+			{
+				Sent = false;
+
+				for( vector<CGamePlayer *> :: iterator i = Downloaders.begin( ); i != Downloaders.end( ); ++i )
 				{
+					if( (*i)->GetLastMapPartSent( ) >= MapSize || (*i)->GetLastMapPartSent( ) >= (*i)->GetLastMapPartAcked( ) + (*i)->GetDownloadWindow( ) )
+						continue;
+
+					if( !(*i)->GetSocket( ) || !(*i)->GetSocket( )->GetWritable( ) )
+						continue;
+
+					// stop once we've used up what the download governor gave us
+
+					if( Granted <= 0 )
+					{
+						Sent = false;
+						break;
+					}
+
 					if( (*i)->GetLastMapPartSent( ) == 0 )
 					{
 						// overwrite the "started download ticks" since this is the first time we've sent any map data to the player
@@ -622,17 +839,17 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 						(*i)->SetStartedDownloadingTicks( GetTicks( ) );
 					}
 
-					// limit the download speed if we're sending too much data
-					// the download counter is the # of map bytes downloaded in the last second (it's reset once per second)
-
-					if( m_GHost->m_MaxDownloadSpeed > 0 && m_DownloadCounter > m_GHost->m_MaxDownloadSpeed * 1024 )
-						break;
-
-					Send( *i, m_Protocol->SEND_W3GS_MAPPART( GetHostPID( ), (*i)->GetPID( ), (*i)->GetLastMapPartSent( ), m_Map->GetMapData( ) ) );
-					(*i)->SetLastMapPartSent( (*i)->GetLastMapPartSent( ) + 1442 );
-					m_DownloadCounter += 1442;
+					(*i)->SendMapPart( m_Protocol->SEND_W3GS_MAPPART( GetHostPID( ), (*i)->GetPID( ), (*i)->GetLastMapPartSent( ), m_Map->GetMapData( ) ) );
+					(*i)->SetLastMapPartSent( (*i)->GetLastMapPartSent( ) + MAPPART_SIZE );
+					Granted -= MAPPART_SIZE;
+					Sent = true;
 				}
 			}
+
+			// give back what we didn't use (or pay back what we sent over)
+
+			if( Granted != 0 )
+				m_GHost->m_DownloadGovernor->Return( Granted );
 		}
 
 		m_LastDownloadTicks = GetTicks( );
@@ -802,10 +1019,10 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 							// empty actions are used to extend the time a player can use when reconnecting
 
 							for( unsigned char j = 0; j < m_GProxyEmptyActions; ++j )
-								Send( *i, m_Protocol->SEND_W3GS_INCOMING_ACTION( queue<CIncomingAction *>( ), 0 ) );
+								Send( *i, m_Protocol->SEND_W3GS_INCOMING_ACTION( deque<CIncomingAction *>( ), 0 ) );
 						}
 
-						Send( *i, m_Protocol->SEND_W3GS_INCOMING_ACTION( queue<CIncomingAction *>( ), 0 ) );
+						Send( *i, m_Protocol->SEND_W3GS_INCOMING_ACTION( deque<CIncomingAction *>( ), 0 ) );
 
 						// start the lag screen
 
@@ -822,10 +1039,10 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 							// empty actions are used to extend the time a player can use when reconnecting
 
 							for( unsigned char j = 0; j < m_GProxyEmptyActions; ++j )
-								(*i)->AddLoadInGameData( m_Protocol->SEND_W3GS_INCOMING_ACTION( queue<CIncomingAction *>( ), 0 ) );
+								(*i)->AddLoadInGameData( m_Protocol->SEND_W3GS_INCOMING_ACTION( deque<CIncomingAction *>( ), 0 ) );
 						}
 
-						(*i)->AddLoadInGameData( m_Protocol->SEND_W3GS_INCOMING_ACTION( queue<CIncomingAction *>( ), 0 ) );
+						(*i)->AddLoadInGameData( m_Protocol->SEND_W3GS_INCOMING_ACTION( deque<CIncomingAction *>( ), 0 ) );
 					}
 				}
 
@@ -836,10 +1053,10 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 					if( UsingGProxy )
 					{
 						for( unsigned char i = 0; i < m_GProxyEmptyActions; ++i )
-							m_Replay->AddTimeSlot( 0, queue<CIncomingAction *>( ) );
+							m_Replay->AddTimeSlot( 0, NULL, 0 );
 					}
 
-					m_Replay->AddTimeSlot( 0, queue<CIncomingAction *>( ) );
+					m_Replay->AddTimeSlot( 0, NULL, 0 );
 				}
 
 				// Warcraft III doesn't seem to respond to empty actions
@@ -888,6 +1105,9 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 				BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] started lagging on [" + LaggingString + "]";
 				SendAll( m_Protocol->SEND_W3GS_START_LAG( m_Players ) );
 
+				if( m_LatencyController )
+					m_LatencyController->EventLagScreen( );
+
 				// reset everyone's drop vote
 
 				for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
@@ -942,10 +1162,10 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 						// empty actions are used to extend the time a player can use when reconnecting
 
 						for( unsigned char j = 0; j < m_GProxyEmptyActions; ++j )
-							Send( *i, m_Protocol->SEND_W3GS_INCOMING_ACTION( queue<CIncomingAction *>( ), 0 ) );
+							Send( *i, m_Protocol->SEND_W3GS_INCOMING_ACTION( deque<CIncomingAction *>( ), 0 ) );
 					}
 
-					Send( *i, m_Protocol->SEND_W3GS_INCOMING_ACTION( queue<CIncomingAction *>( ), 0 ) );
+					Send( *i, m_Protocol->SEND_W3GS_INCOMING_ACTION( deque<CIncomingAction *>( ), 0 ) );
 
 					// start the lag screen
 
@@ -959,10 +1179,10 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 					if( UsingGProxy )
 					{
 						for( unsigned char i = 0; i < m_GProxyEmptyActions; ++i )
-							m_Replay->AddTimeSlot( 0, queue<CIncomingAction *>( ) );
+							m_Replay->AddTimeSlot( 0, NULL, 0 );
 					}
 
-					m_Replay->AddTimeSlot( 0, queue<CIncomingAction *>( ) );
+					m_Replay->AddTimeSlot( 0, NULL, 0 );
 				}
 
 				// Warcraft III doesn't seem to respond to empty actions
@@ -1012,10 +1232,8 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 		}
 		
 		// see if we can handle any pending reconnects
-		if( !m_GHost->m_PendingReconnects.empty( ) && GetTicks( ) - m_LastReconnectHandleTime > 500 )
+		if( !m_GHost->m_PendingReconnects.empty( ) )
 		{
-			m_LastReconnectHandleTime = GetTicks( );
-			
 			boost::mutex::scoped_lock lock( m_GHost->m_ReconnectMutex );
 			
 			for( vector<GProxyReconnector *> :: iterator i = m_GHost->m_PendingReconnects.begin( ); i != m_GHost->m_PendingReconnects.end( ); )
@@ -1024,6 +1242,9 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 				
 				if( Player && Player->GetGProxy( ) && Player->GetGProxyReconnectKey( ) == (*i)->ReconnectKey )
 				{
+					if( m_Reactor )
+						m_Reactor->Add( (*i)->socket );
+
 					Player->EventGProxyReconnect( (*i)->socket, (*i)->LastPacket );
 					delete (*i);
 					i = m_GHost->m_PendingReconnects.erase( i );
@@ -1111,7 +1332,7 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 
 	if( m_Socket )
 	{
-		CTCPSocket *NewSocket = m_Socket->Accept( (fd_set *)fd );
+		CTCPSocket *NewSocket = m_Socket->Accept( );
 
 		if( NewSocket )
 		{
@@ -1122,6 +1343,9 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 				if( m_GHost->m_TCPNoDelay )
 					NewSocket->SetNoDelay( true );
 
+				if( m_Reactor )
+					m_Reactor->Add( NewSocket );
+
 				m_Potentials.push_back( new CPotentialPlayer( m_Protocol, this, NewSocket ) );
 			}
 			else
@@ -1138,7 +1362,7 @@ bool CBaseGame :: Update( void *fd, void *send_fd )
 	return m_Exiting;
 }
 
-void CBaseGame :: UpdatePost( void *send_fd )
+void CBaseGame :: UpdatePost( )
 {
 	// we need to manually call DoSend on each player now because CGamePlayer :: Update doesn't do it
 	// this is in case player 2 generates a packet for player 1 during the update but it doesn't get sent because player 1 already finished updating
@@ -1147,35 +1371,45 @@ void CBaseGame :: UpdatePost( void *send_fd )
 	for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
 	{
 		if( (*i)->GetSocket( ) )
-			(*i)->GetSocket( )->DoSend( (fd_set *)send_fd );
+			(*i)->GetSocket( )->DoSend( );
 	}
 
 	for( vector<CPotentialPlayer *> :: iterator i = m_Potentials.begin( ); i != m_Potentials.end( ); ++i )
 	{
 		if( (*i)->GetSocket( ) )
-			(*i)->GetSocket( )->DoSend( (fd_set *)send_fd );
+			(*i)->GetSocket( )->DoSend( );
 	}
 }
 
-void CBaseGame :: Send( CGamePlayer *player, BYTEARRAY data )
+void CBaseGame :: Send( CGamePlayer *player, CPacket data )
 {
 	if( player )
+	{
+		if( m_GameLoading || m_GameLoaded )
+			m_GHost->m_DownloadGovernor->AddGameTraffic( data.GetSize( ) );
+
 		player->Send( data );
+	}
 }
 
-void CBaseGame :: Send( unsigned char PID, BYTEARRAY data )
+void CBaseGame :: Send( unsigned char PID, CPacket data )
 {
 	Send( GetPlayerFromPID( PID ), data );
 }
 
-void CBaseGame :: Send( BYTEARRAY PIDs, BYTEARRAY data )
+void CBaseGame :: Send( BYTEARRAY PIDs, CPacket data )
 {
 	for( unsigned int i = 0; i < PIDs.size( ); ++i )
 		Send( PIDs[i], data );
 }
 
-void CBaseGame :: SendAll( BYTEARRAY data )
+void CBaseGame :: SendAll( CPacket data )
 {
+	// every player's send queue shares the same packet so it's only stored once no matter how many players there are
+
+	if( m_GameLoading || m_GameLoaded )
+		m_GHost->m_DownloadGovernor->AddGameTraffic( data.GetSize( ) * m_Players.size( ) );
+
 	for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
 		(*i)->Send( data );
 }
@@ -1318,14 +1552,14 @@ void CBaseGame :: SendAllActions( )
 			if( !(*i)->GetGProxy( ) )
 			{
 				for( unsigned char j = 0; j < m_GProxyEmptyActions; ++j )
-					Send( *i, m_Protocol->SEND_W3GS_INCOMING_ACTION( queue<CIncomingAction *>( ), 0 ) );
+					Send( *i, m_Protocol->SEND_W3GS_INCOMING_ACTION( deque<CIncomingAction *>( ), 0 ) );
 			}
 		}
 
 		if( m_Replay )
 		{
 			for( unsigned char i = 0; i < m_GProxyEmptyActions; ++i )
-				m_Replay->AddTimeSlot( 0, queue<CIncomingAction *>( ) );
+				m_Replay->AddTimeSlot( 0, NULL, 0 );
 		}
 	}
 
@@ -1336,72 +1570,44 @@ void CBaseGame :: SendAllActions( )
 
 	++m_SyncCounter;
 
-	// we aren't allowed to send more than 1460 bytes in a single packet but it's possible we might have more than that many bytes waiting in the queue
-
-	if( !m_Actions.empty( ) )
-	{
-		// we use a "sub actions queue" which we keep adding actions to until we reach the size limit
-		// start by adding one action to the sub actions queue
+	// the actions are encoded once into as many W3GS_INCOMING_ACTION2 packets as needed followed by the W3GS_INCOMING_ACTION packet (see CGameProtocol :: SEND_W3GS_INCOMING_ACTIONS)
+	// the replay stores the same encoded actions, everything after the packet's 8 byte header (an empty W3GS_INCOMING_ACTION packet is only 6 bytes and has no actions)
 
-		queue<CIncomingAction *> SubActions;
-		CIncomingAction *Action = m_Actions.front( );
-		m_Actions.pop( );
-		SubActions.push( Action );
-		uint32_t SubActionsLength = Action->GetLength( );
+	vector<CPacket> Packets = m_Protocol->SEND_W3GS_INCOMING_ACTIONS( m_Actions, m_Latency );
 
-		while( !m_Actions.empty( ) )
+	for( vector<CPacket> :: iterator i = Packets.begin( ); i != Packets.end( ); ++i )
+	{
+		if( m_Replay )
 		{
-			Action = m_Actions.front( );
-			m_Actions.pop( );
+			const unsigned char *Actions = i->GetDataSize( ) > 8 ? i->GetData( ) + 8 : NULL;
+			uint32_t Length = i->GetDataSize( ) > 8 ? i->GetDataSize( ) - 8 : 0;
 
-			// check if adding the next action to the sub actions queue would put us over the limit (1452 because the INCOMING_ACTION and INCOMING_ACTION2 packets use an extra 8 bytes)
-
-			if( SubActionsLength + Action->GetLength( ) > 1452 )
-			{
-				// we'd be over the limit if we added the next action to the sub actions queue
-				// so send everything already in the queue and then clear it out
-				// the W3GS_INCOMING_ACTION2 packet handles the overflow but it must be sent *before* the corresponding W3GS_INCOMING_ACTION packet
-
-				SendAll( m_Protocol->SEND_W3GS_INCOMING_ACTION2( SubActions ) );
-
-				if( m_Replay )
-					m_Replay->AddTimeSlot2( SubActions );
+			if( i + 1 != Packets.end( ) )
+				m_Replay->AddTimeSlot2( Actions, Length );
+			else
+				m_Replay->AddTimeSlot( m_Latency, Actions, Length );
+		}
 
-				while( !SubActions.empty( ) )
-				{
-					delete SubActions.front( );
-					SubActions.pop( );
-				}
+		SendAll( *i );
+	}
 
-				SubActionsLength = 0;
-			}
+	for( deque<CIncomingAction *> :: iterator i = m_Actions.begin( ); i != m_Actions.end( ); ++i )
+		m_Pool->Delete( *i );
 
-			SubActions.push( Action );
-			SubActionsLength += Action->GetLength( );
-		}
+	m_Actions.clear( );
 
-		SendAll( m_Protocol->SEND_W3GS_INCOMING_ACTION( SubActions, m_Latency ) );
+	uint32_t ActualSendInterval = GetTicks( ) - m_LastActionSentTicks;
+	uint32_t ExpectedSendInterval = m_Latency - m_LastActionLateBy;
 
-		if( m_Replay )
-			m_Replay->AddTimeSlot( m_Latency, SubActions );
+	// updates sent early on purpose (e.g. when auto saving before a player drop) aren't late and aren't counted
 
-		while( !SubActions.empty( ) )
-		{
-			delete SubActions.front( );
-			SubActions.pop( );
-		}
-	}
-	else
+	if( ActualSendInterval >= ExpectedSendInterval )
 	{
-		SendAll( m_Protocol->SEND_W3GS_INCOMING_ACTION( m_Actions, m_Latency ) );
-
-		if( m_Replay )
-			m_Replay->AddTimeSlot( m_Latency, m_Actions );
+		m_LastActionLateBy = ActualSendInterval - ExpectedSendInterval;
+		m_TickHistogram->Add( m_LastActionLateBy );
 	}
-
-	uint32_t ActualSendInterval = GetTicks( ) - m_LastActionSentTicks;
-	uint32_t ExpectedSendInterval = m_Latency - m_LastActionLateBy;
-	m_LastActionLateBy = ActualSendInterval - ExpectedSendInterval;
+	else
+		m_LastActionLateBy = 0;
 
 	if( m_LastActionLateBy > m_Latency )
 	{
@@ -1413,6 +1619,31 @@ void CBaseGame :: SendAllActions( )
 		m_LastActionLateBy = m_Latency;
 	}
 
+	if( m_LatencyController )
+	{
+		// let the latency controller see how late this update was and how far behind the players are
+
+		uint32_t MaxSyncLag = 0;
+		uint32_t MaxPing = 0;
+
+		for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
+		{
+			MaxSyncLag = max( MaxSyncLag, m_SyncCounter - (*i)->GetSyncCounter( ) );
+			MaxPing = max( MaxPing, (*i)->GetPing( false ) );
+		}
+
+		uint32_t Latency = m_LatencyController->EventActionsSent( m_Latency, m_LastActionLateBy, MaxSyncLag, MaxPing, m_SyncLimit );
+
+		if( Latency != m_Latency )
+		{
+			BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] changing latency from " + UTIL_ToString( m_Latency ) + "ms to " + UTIL_ToString( Latency ) + "ms because " + m_LatencyController->GetReason( );
+			m_Latency = Latency;
+
+			if( m_LastActionLateBy > m_Latency )
+				m_LastActionLateBy = m_Latency;
+		}
+	}
+
 	m_LastActionSentTicks = GetTicks( );
 }
 
@@ -1504,6 +1735,22 @@ void CBaseGame :: EventPlayerDeleted( CGamePlayer *player )
 {
 	BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] deleting player [" + player->GetName( ) + "]: " + player->GetLeftReason( );
 
+	// stop waiting for the player's checksums, the frames which were only waiting for this player can be checked now
+
+	if( m_SyncFrames->GetPlayer( player->GetPID( ) ) )
+	{
+		m_SyncFrames->RemovePlayer( player->GetPID( ) );
+		CheckSyncFrames( );
+	}
+
+	// receive statistics, bytes per recv shows how well bursts are drained and receive rounds per packet shows how many loops it took to get each packet
+
+	if( player->GetSocket( ) && player->GetSocket( )->GetTotalRecvCalls( ) > 0 && player->GetTotalPacketsReceived( ) > 0 )
+	{
+		CTCPSocket *Socket = player->GetSocket( );
+		BOOST_LOG_TRIVIAL(debug) << "[GAME: " + m_GameName + "] player [" + player->GetName( ) + "] received " + UTIL_ToString( Socket->GetTotalRecvBytes( ) ) + " bytes in " + UTIL_ToString( Socket->GetTotalRecvCalls( ) ) + " recv calls (" + UTIL_ToString( (double)Socket->GetTotalRecvBytes( ) / Socket->GetTotalRecvCalls( ), 1 ) + " bytes/call) and " + UTIL_ToString( player->GetTotalPacketsReceived( ) ) + " packets in " + UTIL_ToString( Socket->GetTotalRecvRounds( ) ) + " receive rounds (" + UTIL_ToString( (double)Socket->GetTotalRecvRounds( ) / player->GetTotalPacketsReceived( ), 2 ) + " rounds/packet)";
+	}
+
 	// remove any queued spoofcheck messages for this player
 
 	if( player->GetWhoisSent( ) && !player->GetJoinedRealm( ).empty( ) && player->GetSpoofedRealm( ).empty( ) )
@@ -1543,11 +1790,10 @@ void CBaseGame :: EventPlayerDeleted( CGamePlayer *player )
 	{
 		string SaveGameName = UTIL_FileSafeName( "GHost++ AutoSave " + m_GameName + " (" + player->GetName( ) + ").w3z" );
 		BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] auto saving [" + SaveGameName + "] before player drop, shortened send interval = " + UTIL_ToString( GetTicks( ) - m_LastActionSentTicks );
-		BYTEARRAY CRC;
 		BYTEARRAY Action;
 		Action.push_back( 6 );
 		UTIL_AppendByteArray( Action, SaveGameName );
-		m_Actions.push( new CIncomingAction( player->GetPID( ), CRC, Action ) );
+		m_Actions.push_back( m_Pool->NewIncomingAction( player->GetPID( ), NULL, 0, &Action[0], Action.size( ) ) );
 
 		// todotodo: with the new latency system there needs to be a way to send a 0-time action
 
@@ -2747,11 +2993,11 @@ bool CBaseGame :: EventPlayerAction( CGamePlayer *player, CIncomingAction *actio
 		player->SetLeftReason( "Invalid action packet" );
 		player->SetLeftCode( PLAYERLEAVE_LOST );
 
-		delete action;
+		m_Pool->Delete( action );
 		return false;
 	}
 
-	m_Actions.push( action );
+	m_Actions.push_back( action );
 
 	// check for players saving the game and notify everyone
 
@@ -2766,150 +3012,168 @@ bool CBaseGame :: EventPlayerAction( CGamePlayer *player, CIncomingAction *actio
 
 void CBaseGame :: EventPlayerKeepAlive( CGamePlayer *player, uint32_t checkSum )
 {
-	if( !m_GameLoaded )
+	if( !m_GameLoading && !m_GameLoaded )
 		return;
 
-	// check for desyncs
-	// however, it's possible that not every player has sent a checksum for this frame yet
-	// first we verify that we have enough checksums to work with otherwise we won't know exactly who desynced
-
-	for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
-	{
-		if( !(*i)->GetDeleteMe( ) && (*i)->GetCheckSums( )->empty( ) )
-			return;
-	}
+	// the checksum belongs to the frame numbered by the keepalives the player sent before this one
+	// it's slotted into that frame and the frame is only compared once every player has sent their checksum for it
+	// this includes the keepalives sent during loading (see map_loadingame) otherwise the players who loaded first would be a few frames ahead of the others
 
-	// now we check for desyncs since we know that every player has at least one checksum waiting
+	m_SyncFrames->AddCheckSum( player->GetPID( ), player->GetSyncCounter( ) - 1, checkSum );
+	CheckSyncFrames( );
+}
 
-	bool FoundPlayer = false;
-	uint32_t FirstCheckSum = 0;
+void CBaseGame :: CheckSyncFrames( )
+{
+	// check for desyncs in every frame which has all of its checksums now, oldest first
+	// the checksums of a frame are compared exactly once and the players are only looked at when they don't match
 
-	for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
+	while( true )
 	{
-		if( !(*i)->GetDeleteMe( ) )
+		if( m_SyncFrames->GetFrameReady( ) )
 		{
-			FoundPlayer = true;
-			FirstCheckSum = (*i)->GetCheckSums( )->front( );
-			break;
+			if( !m_SyncFrames->GetFrameInSync( ) )
+				EventDesync( m_SyncFrames->GetFirstFrame( ) );
+
+			m_SyncFrames->PopFrame( );
+		}
+		else if( m_SyncFrames->GetNumFrames( ) > SYNCFRAMES_MAX_FRAMES )
+		{
+			// the oldest frame is still missing a checksum after far more frames than the lag screen allows, it's never going to be completed
+			// skip it so the rest of the game is still checked and the table doesn't grow forever, this shouldn't happen so say who we were waiting for
+
+			if( m_SyncFrames->GetNumSkipped( ) % 1000 == 0 )
+			{
+				string Players;
+
+				for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
+				{
+					if( m_SyncFrames->GetMissing( (*i)->GetPID( ) ) )
+					{
+						if( Players.empty( ) )
+							Players = (*i)->GetName( );
+						else
+							Players += ", " + (*i)->GetName( );
+					}
+				}
+
+				BOOST_LOG_TRIVIAL(warning) << "[GAME: " + m_GameName + "] skipping desync check of frame " + UTIL_ToString( m_SyncFrames->GetFirstFrame( ) ) + ", no checksum from [" + Players + "] (" + UTIL_ToString( m_SyncFrames->GetNumSkipped( ) + 1 ) + " frames skipped so far)";
+			}
+
+			m_SyncFrames->SkipFrame( );
 		}
+		else
+			break;
 	}
+}
 
-	if( !FoundPlayer )
-		return;
+void CBaseGame :: EventDesync( uint32_t frame )
+{
+	// try to figure out who desynced
+	// this is complicated by the fact that we don't know what the correct game state is so we let the players vote
+	// put the players into bins based on their game state
+	// players who are about to be deleted are still waited for until EventPlayerDeleted but they don't get a vote
 
-	bool AddToReplay = true;
+	map<uint32_t, vector<unsigned char> > Bins;
 
 	for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
 	{
-		if( !(*i)->GetDeleteMe( ) && (*i)->GetCheckSums( )->front( ) != FirstCheckSum )
-		{
-			BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] desync detected";
-			SendAllChat( m_GHost->m_Language->DesyncDetected( ) );
+		if( !(*i)->GetDeleteMe( ) && m_SyncFrames->GetPlayer( (*i)->GetPID( ) ) )
+			Bins[m_SyncFrames->GetCheckSum( (*i)->GetPID( ) )].push_back( (*i)->GetPID( ) );
+	}
 
-			// try to figure out who desynced
-			// this is complicated by the fact that we don't know what the correct game state is so we let the players vote
-			// put the players into bins based on their game state
+	// if everyone who's staying has the same game state only players who are leaving anyway disagreed
 
-			map<uint32_t, vector<unsigned char> > Bins;
+	if( Bins.size( ) < 2 )
+		return;
 
-			for( vector<CGamePlayer *> :: iterator j = m_Players.begin( ); j != m_Players.end( ); ++j )
-			{
-				if( !(*j)->GetDeleteMe( ) )
-					Bins[(*j)->GetCheckSums( )->front( )].push_back( (*j)->GetPID( ) );
-			}
+	string MinString = UTIL_ToString( ( m_GameTicks / 1000 ) / 60 );
+	string SecString = UTIL_ToString( ( m_GameTicks / 1000 ) % 60 );
 
-			uint32_t StateNumber = 1;
-			map<uint32_t, vector<unsigned char> > :: iterator LargestBin = Bins.begin( );
-			bool Tied = false;
+	if( MinString.size( ) == 1 )
+		MinString.insert( 0, "0" );
 
-			for( map<uint32_t, vector<unsigned char> > :: iterator j = Bins.begin( ); j != Bins.end( ); ++j )
-			{
-				if( (*j).second.size( ) > (*LargestBin).second.size( ) )
-				{
-					LargestBin = j;
-					Tied = false;
-				}
-				else if( j != LargestBin && (*j).second.size( ) == (*LargestBin).second.size( ) )
-					Tied = true;
+	if( SecString.size( ) == 1 )
+		SecString.insert( 0, "0" );
 
-				string Players;
+	// the chat message is also recorded in the replay (see SendAllChat) so the replay shows the frame as well
 
-				for( vector<unsigned char> :: iterator k = (*j).second.begin( ); k != (*j).second.end( ); ++k )
-				{
-					CGamePlayer *Player = GetPlayerFromPID( *k );
+	BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] desync detected at frame " + UTIL_ToString( frame ) + " (game time " + MinString + ":" + SecString + ")";
+	SendAllChat( m_GHost->m_Language->DesyncDetected( UTIL_ToString( frame ), MinString + ":" + SecString ) );
 
-					if( Player )
-					{
-						if( Players.empty( ) )
-							Players = Player->GetName( );
-						else
-							Players += ", " + Player->GetName( );
-					}
-				}
+	uint32_t StateNumber = 1;
+	map<uint32_t, vector<unsigned char> > :: iterator LargestBin = Bins.begin( );
+	bool Tied = false;
 
-				SendAllChat( m_GHost->m_Language->PlayersInGameState( UTIL_ToString( StateNumber ), Players ) );
-				++StateNumber;
-			}
+	for( map<uint32_t, vector<unsigned char> > :: iterator i = Bins.begin( ); i != Bins.end( ); ++i )
+	{
+		if( (*i).second.size( ) > (*LargestBin).second.size( ) )
+		{
+			LargestBin = i;
+			Tied = false;
+		}
+		else if( i != LargestBin && (*i).second.size( ) == (*LargestBin).second.size( ) )
+			Tied = true;
+
+		string Players;
 
-			FirstCheckSum = (*LargestBin).first;
+		for( vector<unsigned char> :: iterator j = (*i).second.begin( ); j != (*i).second.end( ); ++j )
+		{
+			CGamePlayer *Player = GetPlayerFromPID( *j );
 
-			if( Tied )
+			if( Player )
 			{
-				// there is a tie, which is unfortunate
-				// the most common way for this to happen is with a desync in a 1v1 situation
-				// this is not really unsolvable since the game shouldn't continue anyway so we just kick both players
-				// in a 2v2 or higher the chance of this happening is very slim
-				// however, we still kick every player because it's not fair to pick one or another group
-				// todotodo: it would be possible to split the game at this point and create a "new" game for each game state
-
-				BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] can't kick desynced players because there is a tie, kicking all players instead";
-				StopPlayers( m_GHost->m_Language->WasDroppedDesync( ) );
-				AddToReplay = false;
+				if( Players.empty( ) )
+					Players = Player->GetName( );
+				else
+					Players += ", " + Player->GetName( );
 			}
-			else
-			{
-				BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] kicking desynced players";
+		}
+
+		SendAllChat( m_GHost->m_Language->PlayersInGameState( UTIL_ToString( StateNumber ), Players ) );
+		++StateNumber;
+	}
+
+	if( Tied )
+	{
+		// there is a tie, which is unfortunate
+		// the most common way for this to happen is with a desync in a 1v1 situation
+		// this is not really unsolvable since the game shouldn't continue anyway so we just kick both players
+		// in a 2v2 or higher the chance of this happening is very slim
+		// however, we still kick every player because it's not fair to pick one or another group
+		// todotodo: it would be possible to split the game at this point and create a "new" game for each game state
+
+		BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] can't kick desynced players because there is a tie, kicking all players instead";
+		StopPlayers( m_GHost->m_Language->WasDroppedDesync( ) );
+	}
+	else
+	{
+		BOOST_LOG_TRIVIAL(info) << "[GAME: " + m_GameName + "] kicking desynced players";
 
-				for( map<uint32_t, vector<unsigned char> > :: iterator j = Bins.begin( ); j != Bins.end( ); ++j )
+		for( map<uint32_t, vector<unsigned char> > :: iterator i = Bins.begin( ); i != Bins.end( ); ++i )
+		{
+			// kick players who are NOT in the largest bin
+			// examples: suppose there are 10 players
+			// the most common case will be 9v1 (e.g. one player desynced and the others were unaffected) and this will kick the single outlier
+			// another (very unlikely) possibility is 8v1v1 or 8v2 and this will kick both of the outliers, regardless of whether their game states match
+
+			if( (*i).first != (*LargestBin).first )
+			{
+				for( vector<unsigned char> :: iterator j = (*i).second.begin( ); j != (*i).second.end( ); ++j )
 				{
-					// kick players who are NOT in the largest bin
-					// examples: suppose there are 10 players
-					// the most common case will be 9v1 (e.g. one player desynced and the others were unaffected) and this will kick the single outlier
-					// another (very unlikely) possibility is 8v1v1 or 8v2 and this will kick both of the outliers, regardless of whether their game states match
+					CGamePlayer *Player = GetPlayerFromPID( *j );
 
-					if( (*j).first != (*LargestBin).first )
+					if( Player )
 					{
-						for( vector<unsigned char> :: iterator k = (*j).second.begin( ); k != (*j).second.end( ); ++k )
-						{
-							CGamePlayer *Player = GetPlayerFromPID( *k );
-
-							if( Player )
-							{
-								Player->SetDeleteMe( true );
-								Player->SetLeftReason( m_GHost->m_Language->WasDroppedDesync( ) );
-								Player->SetLeftCode( PLAYERLEAVE_LOST );
-							}
-						}
+						Player->SetDeleteMe( true );
+						Player->SetLeftReason( m_GHost->m_Language->WasDroppedDesync( ) );
+						Player->SetLeftCode( PLAYERLEAVE_LOST );
+						m_SyncFrames->RemovePlayer( Player->GetPID( ) );
 					}
 				}
 			}
-
-			// don't continue looking for desyncs, we already found one!
-
-			break;
 		}
 	}
-
-	for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
-	{
-		if( !(*i)->GetDeleteMe( ) )
-			(*i)->GetCheckSums( )->pop( );
-	}
-
-	// add checksum to replay
-
-	/* if( m_Replay && AddToReplay )
-		m_Replay->AddCheckSum( FirstCheckSum ); */
 }
 
 void CBaseGame :: EventPlayerChatToHost( CGamePlayer *player, CIncomingChatPlayer *chatPlayer )
@@ -3212,9 +3476,9 @@ void CBaseGame :: EventPlayerMapSize( CGamePlayer *player, CIncomingMapSize *map
 
 		if( m_GHost->m_AllowDownloads != 0 )
 		{
-			string *MapData = m_Map->GetMapData( );
+			boost::shared_ptr<CMapData> MapData = m_Map->GetMapData( );
 
-			if( !MapData->empty( ) )
+			if( !MapData->GetEmpty( ) )
 			{
 				if( m_GHost->m_AllowDownloads == 1 || ( m_GHost->m_AllowDownloads == 2 && player->GetDownloadAllowed( ) ) )
 				{
@@ -3228,7 +3492,7 @@ void CBaseGame :: EventPlayerMapSize( CGamePlayer *player, CIncomingMapSize *map
 						player->SetStartedDownloadingTicks( GetTicks( ) );
 					}
 					else
-						player->SetLastMapPartAcked( mapSize->GetMapSize( ) );
+						player->EventMapPartAcked( mapSize->GetMapSize( ) );
 				}
 			}
 			else
@@ -3395,6 +3659,12 @@ void CBaseGame :: EventGameStarted( )
 	m_LastLagScreenResetTime = GetTime( );
 	m_GameLoading = true;
 
+	// every player has to send a checksum for each frame from now on
+	// this starts with loading because with map_loadingame the players who finished loading already answer the empty updates sent while the others are still loading
+
+	for( vector<CGamePlayer *> :: iterator i = m_Players.begin( ); i != m_Players.end( ); ++i )
+		m_SyncFrames->AddPlayer( (*i)->GetPID( ) );
+
 	// since we use a fake countdown to deal with leavers during countdown the COUNTDOWN_START and COUNTDOWN_END packets are sent in quick succession
 	// send a start countdown packet
 
@@ -28,6 +28,11 @@
 //
 
 class CTCPServer;
+class CPacket;
+class CSocketReactor;
+class CTimer;
+class CTimerWheel;
+class CGameWorker;
 class CGameProtocol;
 class CPotentialPlayer;
 class CGamePlayer;
@@ -36,6 +41,10 @@ class CSaveGame;
 class CReplay;
 class CIncomingJoinPlayer;
 class CIncomingAction;
+class CGamePool;
+class CLatencyController;
+class CTickHistogram;
+class CSyncFrames;
 class CIncomingChatPlayer;
 class CIncomingMapSize;
 class CCallableScoreCheck;
@@ -48,12 +57,16 @@ public:
 
 protected:
 	CTCPServer *m_Socket;							// listening socket
+	CSocketReactor *m_Reactor;						// the reactor of the worker running this game, watching the listening socket and every player socket
+	CTimerWheel *m_Timers;							// the timer wheel of the worker running this game
+	CTimer *m_UpdateTimer;							// expires when the next timer checked in Update is due, see GetNextTimerTicks
 	CGameProtocol *m_Protocol;						// game protocol
+	CGamePool *m_Pool;								// recycles the packets and actions of this game's players
 	vector<CGameSlot> m_Slots;						// vector of slots
 	vector<CPotentialPlayer *> m_Potentials;		// vector of potential players (connections that haven't sent a W3GS_REQJOIN packet yet)
 	vector<CGamePlayer *> m_Players;				// vector of players
 	vector<CCallableScoreCheck *> m_ScoreChecks;
-	queue<CIncomingAction *> m_Actions;				// queue of actions to be sent
+	deque<CIncomingAction *> m_Actions;				// queue of actions to be sent
 	vector<string> m_Reserved;						// vector of player names with reserved slots (from the !hold command)
 	set<string> m_IgnoredNames;						// set of player names to NOT print ban messages for when joining because they've already been printed
 	set<string> m_IPBlackList;						// set of IP addresses to blacklist from joining (todotodo: convert to uint32's for efficiency)
@@ -83,6 +96,9 @@ protected:
 	uint32_t m_HostCounter;							// a unique game number
 	uint32_t m_EntryKey;							// random entry key for LAN, used to prove that a player is actually joining from LAN
 	uint32_t m_Latency;								// the number of ms to wait between sending action packets (we queue any received during this time)
+	CLatencyController *m_LatencyController;		// adjusts m_Latency while the game is running (NULL if the latency is set by hand)
+	CTickHistogram *m_TickHistogram;				// how late each action update was sent
+	CSyncFrames *m_SyncFrames;						// the checksums of the frames which haven't been compared yet (for detecting desyncs)
 	uint32_t m_SyncLimit;							// the maximum number of packets a player can fall out of sync before starting the lag screen
 	uint32_t m_SyncCounter;							// the number of actions sent so far (for determining if anyone is lagging)
 	uint32_t m_GameTicks;							// ingame ticks
@@ -90,8 +106,8 @@ protected:
 	uint32_t m_LastPingTime;						// GetTime when the last ping was sent
 	uint32_t m_LastRefreshTime;						// GetTime when the last game refresh was sent
 	uint32_t m_LastDownloadTicks;					// GetTicks when the last map download cycle was performed
-	uint32_t m_DownloadCounter;						// # of map bytes downloaded in the last second
-	uint32_t m_LastDownloadCounterResetTicks;		// GetTicks when the download counter was last reset
+	uint32_t m_DownloadRoundRobin;					// which downloader goes first in the next map download cycle
+	uint32_t m_LastSlotInfoTicks;					// GetTicks when pending slot info changes were last sent
 	uint32_t m_LastAnnounceTime;					// GetTime when the last announce message was sent
 	uint32_t m_AnnounceInterval;					// how many seconds to wait between sending the m_AnnounceMessage
 	uint32_t m_LastAutoStartTime;					// the last time we tried to auto start the game
@@ -127,26 +143,30 @@ protected:
 	bool m_Lagging;									// if the lag screen is active or not
 	bool m_AutoSave;								// if we should auto save the game before someone disconnects
 	bool m_MatchMaking;								// if matchmaking mode is enabled
-	int m_DoDelete;									// notifies thread to exit
-	uint32_t m_LastReconnectHandleTime;				// last time we tried to handle GProxy reconnects
+	int m_DoDelete;									// notifies the worker to stop running this game
 
 public:
 	vector<string> m_DoSayGames;					// vector of strings we should announce to the current game
 	boost::mutex m_SayGamesMutex;					// mutex for the above vector
 	vector<QueuedSpoofAdd> m_DoSpoofAdd;			// vector of spoof add function call structures
 	boost::mutex m_SpoofAddMutex;
+	CGameWorker *m_Worker;							// the worker running this game, set by the main thread in CGameWorker :: AddGame
 
 public:
 	CBaseGame( CGHost *nGHost, CMap *nMap, CSaveGame *nSaveGame, uint16_t nHostPort, unsigned char nGameState, string nGameName, string nOwnerName, string nCreatorName, string nCreatorServer );
 	virtual ~CBaseGame( );
 
-	virtual void loop( );
+	virtual bool Run( );
+	virtual void Finish( );
+	virtual void SetWorker( CGameWorker *nWorker );
 	virtual void doDelete( );
 	virtual bool readyDelete( );
+	virtual void Wake( );
 
 	virtual vector<CGameSlot> GetEnforceSlots( )	{ return m_EnforceSlots; }
 	virtual vector<PIDPlayer> GetEnforcePlayers( )	{ return m_EnforcePlayers; }
 	virtual CSaveGame *GetSaveGame( )				{ return m_SaveGame; }
+	virtual CGamePool *GetPool( )					{ return m_Pool; }
 	virtual uint16_t GetHostPort( )					{ return m_HostPort; }
 	virtual unsigned char GetGameState( )			{ return m_GameState; }
 	virtual unsigned char GetGProxyEmptyActions( )	{ return m_GProxyEmptyActions; }
@@ -175,6 +195,8 @@ public:
 	virtual void SetMatchMaking( bool nMatchMaking )					{ m_MatchMaking = nMatchMaking; }
 
 	virtual uint32_t GetNextTimedActionTicks( );
+	virtual uint32_t GetNextTimerTicks( );
+	virtual bool GetUpdateDue( );
 	virtual uint32_t GetSlotsOccupied( );
 	virtual uint32_t GetSlotsOpen( );
 	virtual uint32_t GetNumPlayers( );
@@ -185,16 +207,15 @@ public:
 
 	// processing functions
 
-	virtual unsigned int SetFD( void *fd, void *send_fd, int *nfds );
-	virtual bool Update( void *fd, void *send_fd );
-	virtual void UpdatePost( void *send_fd );
+	virtual bool Update( );
+	virtual void UpdatePost( );
 
 	// generic functions to send packets to players
 
-	virtual void Send( CGamePlayer *player, BYTEARRAY data );
-	virtual void Send( unsigned char PID, BYTEARRAY data );
-	virtual void Send( BYTEARRAY PIDs, BYTEARRAY data );
-	virtual void SendAll( BYTEARRAY data );
+	virtual void Send( CGamePlayer *player, CPacket data );
+	virtual void Send( unsigned char PID, CPacket data );
+	virtual void Send( BYTEARRAY PIDs, CPacket data );
+	virtual void SendAll( CPacket data );
 
 	// functions to send packets to players
 
@@ -208,6 +229,7 @@ public:
 	virtual void SendVirtualHostPlayerInfo( CGamePlayer *player );
 	virtual void SendFakePlayerInfo( CGamePlayer *player );
 	virtual void SendAllActions( );
+	virtual void CheckSyncFrames( );
 	virtual void SendWelcomeMessage( CGamePlayer *player );
 	virtual void SendEndMessage( );
 
@@ -226,6 +248,7 @@ public:
 	virtual void EventPlayerLoaded( CGamePlayer *player );
 	virtual bool EventPlayerAction( CGamePlayer *player, CIncomingAction *action );
 	virtual void EventPlayerKeepAlive( CGamePlayer *player, uint32_t checkSum );
+	virtual void EventDesync( uint32_t frame );
 	virtual void EventPlayerChatToHost( CGamePlayer *player, CIncomingChatPlayer *chatPlayer );
 	virtual bool EventPlayerBotCommand( CGamePlayer *player, string command, string payload );
 	virtual void EventPlayerChangeTeam( CGamePlayer *player, unsigned char team );
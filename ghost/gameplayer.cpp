@@ -29,6 +29,8 @@
 #include "gameprotocol.h"
 #include "gpsprotocol.h"
 #include "game_base.h"
+#include "gamepool.h"
+#include "timerwheel.h"
 
 //
 // CPotentialPlayer
@@ -71,7 +73,7 @@ string CPotentialPlayer :: GetExternalIPString( )
 	return string( );
 }
 
-bool CPotentialPlayer :: Update( void *fd )
+bool CPotentialPlayer :: Update( )
 {
 	if( m_DeleteMe )
 		return true;
@@ -79,7 +81,7 @@ bool CPotentialPlayer :: Update( void *fd )
 	if( !m_Socket )
 		return false;
 
-	m_Socket->DoRecv( (fd_set *)fd );
+	m_Socket->DoRecv( );
 	ExtractPackets( );
 	ProcessPackets( );
 
@@ -95,27 +97,31 @@ void CPotentialPlayer :: ExtractPackets( )
 		return;
 
 	// extract as many packets as possible from the socket's receive buffer and put them in the m_Packets queue
+	// the packets are framed in place so each packet's bytes are only copied once, into its CCommandPacket (recycled by the game's pool)
 
-	string *RecvBuffer = m_Socket->GetBytes( );
-	BYTEARRAY Bytes = UTIL_CreateByteArray( (unsigned char *)RecvBuffer->c_str( ), RecvBuffer->size( ) );
+	CByteBuffer *RecvBuffer = m_Socket->GetBytes( );
 
 	// a packet is at least 4 bytes so loop as long as the buffer contains 4 bytes
 
-	while( Bytes.size( ) >= 4 )
+	while( true )
 	{
-		if( Bytes[0] == W3GS_HEADER_CONSTANT || Bytes[0] == GPS_HEADER_CONSTANT )
+		CPacketView Packet( RecvBuffer );
+
+		if( !Packet.GetHeaderComplete( ) )
+			return;
+
+		if( Packet.GetHeader( ) == W3GS_HEADER_CONSTANT || Packet.GetHeader( ) == GPS_HEADER_CONSTANT )
 		{
 			// bytes 2 and 3 contain the length of the packet
 
-			uint16_t Length = UTIL_ByteArrayToUInt16( Bytes, false, 2 );
+			uint16_t Length = Packet.GetLength( );
 
-			if( Length >= 4 )
+			if( Packet.GetValidLength( ) )
 			{
-				if( Bytes.size( ) >= Length )
+				if( Packet.GetComplete( ) )
 				{
-					m_Packets.push( new CCommandPacket( Bytes[0], Bytes[1], BYTEARRAY( Bytes.begin( ), Bytes.begin( ) + Length ) ) );
-					*RecvBuffer = RecvBuffer->substr( Length );
-					Bytes = BYTEARRAY( Bytes.begin( ) + Length, Bytes.end( ) );
+					m_Packets.push( m_Game->GetPool( )->NewCommandPacket( Packet ) );
+					RecvBuffer->Consume( Length );
 				}
 				else
 					return;
@@ -165,16 +171,16 @@ void CPotentialPlayer :: ProcessPackets( )
 				// EventPlayerJoined creates the new player, NULLs the socket, and sets the delete flag on this object so it'll be deleted shortly
 				// any unprocessed packets will be copied to the new CGamePlayer in the constructor or discarded if we get deleted because the game is full
 
-				delete Packet;
+				m_Game->GetPool( )->Delete( Packet );
 				return;
 			}
 		}
 
-		delete Packet;
+		m_Game->GetPool( )->Delete( Packet );
 	}
 }
 
-void CPotentialPlayer :: Send( BYTEARRAY data )
+void CPotentialPlayer :: Send( CPacket data )
 {
 	if( m_Socket )
 		m_Socket->PutBytes( data );
@@ -186,7 +192,7 @@ void CPotentialPlayer :: Send( BYTEARRAY data )
 
 CGamePlayer :: CGamePlayer( CGameProtocol *nProtocol, CBaseGame *nGame, CTCPSocket *nSocket, unsigned char nPID, string nJoinedRealm, string nName, BYTEARRAY nInternalIP, bool nReserved ) : CPotentialPlayer( nProtocol, nGame, nSocket ),
 m_PID( nPID ), m_Name( nName ), m_InternalIP( nInternalIP ), m_JoinedRealm( nJoinedRealm ), m_TotalPacketsSent( 0 ), m_TotalPacketsReceived( 0 ), m_LeftCode( PLAYERLEAVE_LOBBY ), m_LoginAttempts( 0 ), m_SyncCounter( 0 ), m_JoinTime( GetTime( ) ),
-m_LastMapPartSent( 0 ), m_LastMapPartAcked( 0 ), m_StartedDownloadingTicks( 0 ), m_FinishedLoadingTicks( 0 ), m_StartedLaggingTicks( 0 ), m_StatsSentTime( 0 ), m_StatsDotASentTime( 0 ), m_LastGProxyWaitNoticeSentTime( 0 ), m_Score( -100000.0 ),
+m_LastMapPartSent( 0 ), m_LastMapPartAcked( 0 ), m_DownloadWindow( DOWNLOAD_INITIAL_WINDOW ), m_DownloadRate( 0 ), m_DownloadRateBytes( 0 ), m_DownloadRateTicks( 0 ), m_StartedDownloadingTicks( 0 ), m_FinishedLoadingTicks( 0 ), m_StartedLaggingTicks( 0 ), m_StatsSentTime( 0 ), m_StatsDotASentTime( 0 ), m_LastGProxyWaitNoticeSentTime( 0 ), m_Score( -100000.0 ),
 m_LoggedIn( false ), m_Spoofed( false ), m_Reserved( nReserved ), m_WhoisShouldBeSent( false ), m_WhoisSent( false ), m_DownloadAllowed( false ), m_DownloadStarted( false ), m_DownloadFinished( false ), m_FinishedLoading( false ), m_Lagging( false ),
 m_DropVote( false ), m_KickVote( false ), m_Muted( false ), m_LeftMessageSent( false ), m_GProxy( false ), m_GProxyDisconnectNoticeSent( false ), m_GProxyReconnectKey( rand( ) ), m_LastGProxyAckTime( 0 )
 {
@@ -195,7 +201,7 @@ m_DropVote( false ), m_KickVote( false ), m_Muted( false ), m_LeftMessageSent( f
 
 CGamePlayer :: CGamePlayer( CPotentialPlayer *potential, unsigned char nPID, string nJoinedRealm, string nName, BYTEARRAY nInternalIP, bool nReserved ) : CPotentialPlayer( potential->m_Protocol, potential->m_Game, potential->GetSocket( ) ),
 m_PID( nPID ), m_Name( nName ), m_InternalIP( nInternalIP ), m_JoinedRealm( nJoinedRealm ), m_TotalPacketsSent( 0 ), m_TotalPacketsReceived( 1 ), m_LeftCode( PLAYERLEAVE_LOBBY ), m_LoginAttempts( 0 ), m_SyncCounter( 0 ), m_JoinTime( GetTime( ) ),
-m_LastMapPartSent( 0 ), m_LastMapPartAcked( 0 ), m_StartedDownloadingTicks( 0 ), m_FinishedLoadingTicks( 0 ), m_StartedLaggingTicks( 0 ), m_StatsSentTime( 0 ), m_StatsDotASentTime( 0 ), m_LastGProxyWaitNoticeSentTime( 0 ), m_Score( -100000.0 ),
+m_LastMapPartSent( 0 ), m_LastMapPartAcked( 0 ), m_DownloadWindow( DOWNLOAD_INITIAL_WINDOW ), m_DownloadRate( 0 ), m_DownloadRateBytes( 0 ), m_DownloadRateTicks( 0 ), m_StartedDownloadingTicks( 0 ), m_FinishedLoadingTicks( 0 ), m_StartedLaggingTicks( 0 ), m_StatsSentTime( 0 ), m_StatsDotASentTime( 0 ), m_LastGProxyWaitNoticeSentTime( 0 ), m_Score( -100000.0 ),
 m_LoggedIn( false ), m_Spoofed( false ), m_Reserved( nReserved ), m_WhoisShouldBeSent( false ), m_WhoisSent( false ), m_DownloadAllowed( false ), m_DownloadStarted( false ), m_DownloadFinished( false ), m_FinishedLoading( false ), m_Lagging( false ),
 m_DropVote( false ), m_KickVote( false ), m_Muted( false ), m_LeftMessageSent( false ), m_GProxy( false ), m_GProxyDisconnectNoticeSent( false ), m_GProxyReconnectKey( rand( ) ), m_LastGProxyAckTime( 0 )
 {
@@ -251,7 +257,61 @@ uint32_t CGamePlayer :: GetPing( bool LCPing )
 		return AvgPing;
 }
 
-bool CGamePlayer :: Update( void *fd )
+void CGamePlayer :: EventMapPartAcked( uint32_t lastMapPartAcked )
+{
+	// measure how fast the player is receiving the map from the acknowledgements and size the download window to match
+	// the window is twice the bandwidth delay product (the download rate times the round trip time) which is enough to keep the player's connection busy
+	// and lets the window double every round trip while the rate is still growing, but only keeps about one round trip's worth of map data queued for a slow player
+	// CBaseGame :: Update only tops up the window every 100 ms so a round trip effectively takes up to 100 ms longer than the ping
+
+	uint32_t Ticks = GetTicks( );
+
+	if( lastMapPartAcked > m_LastMapPartAcked )
+		m_DownloadRateBytes += lastMapPartAcked - m_LastMapPartAcked;
+
+	m_LastMapPartAcked = lastMapPartAcked;
+
+	if( m_DownloadRateTicks == 0 )
+	{
+		m_DownloadRateBytes = 0;
+		m_DownloadRateTicks = Ticks;
+		return;
+	}
+
+	uint32_t RTT = GetPing( false ) + 100;
+	uint32_t Elapsed = Ticks - m_DownloadRateTicks;
+
+	if( Elapsed < RTT )
+		return;
+
+	uint32_t Rate = (uint32_t)( (uint64_t)m_DownloadRateBytes * 1000 / Elapsed );
+	m_DownloadRate = m_DownloadRate == 0 ? Rate : ( m_DownloadRate + Rate ) / 2;
+	m_DownloadRateBytes = 0;
+	m_DownloadRateTicks = Ticks;
+	uint64_t Window = (uint64_t)m_DownloadRate * RTT * 2 / 1000;
+	m_DownloadWindow = (uint32_t)max( min( Window, (uint64_t)DOWNLOAD_MAX_WINDOW ), (uint64_t)DOWNLOAD_MIN_WINDOW );
+}
+
+uint32_t CGamePlayer :: GetNextTimerTicks( )
+{
+	// return the number of ticks (ms) until one of the timers checked in Update expires
+	// the game folds this into its own deadline, see CBaseGame :: GetNextTimerTicks
+
+	uint32_t Ticks = 1000;
+
+	if( m_WhoisShouldBeSent && !m_Spoofed && !m_WhoisSent && !m_JoinedRealm.empty( ) )
+		Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_JoinTime, 4 ) );
+
+	if( m_Socket )
+		Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_Socket->GetLastRecv( ), 30 ) );
+
+	if( m_GProxy )
+		Ticks = min( Ticks, CTimerWheel :: TicksUntilTime( m_LastGProxyAckTime, 10 ) );
+
+	return Ticks;
+}
+
+bool CGamePlayer :: Update( )
 {
 	// wait 4 seconds after joining before sending the /whois or /w
 	// if we send the /whois too early battle.net may not have caught up with where the player is and return erroneous results
@@ -299,7 +359,7 @@ bool CGamePlayer :: Update( void *fd )
 
 	// base class update
 
-	CPotentialPlayer :: Update( fd );
+	CPotentialPlayer :: Update( );
 	bool Deleting;
 
 	if( m_GProxy && m_Game->GetGameLoaded( ) )
@@ -340,31 +400,35 @@ void CGamePlayer :: ExtractPackets( )
 		return;
 
 	// extract as many packets as possible from the socket's receive buffer and put them in the m_Packets queue
+	// the packets are framed in place so each packet's bytes are only copied once, into its CCommandPacket (recycled by the game's pool)
 
-	string *RecvBuffer = m_Socket->GetBytes( );
-	BYTEARRAY Bytes = UTIL_CreateByteArray( (unsigned char *)RecvBuffer->c_str( ), RecvBuffer->size( ) );
+	CByteBuffer *RecvBuffer = m_Socket->GetBytes( );
 
 	// a packet is at least 4 bytes so loop as long as the buffer contains 4 bytes
 
-	while( Bytes.size( ) >= 4 )
+	while( true )
 	{
-		if( Bytes[0] == W3GS_HEADER_CONSTANT || Bytes[0] == GPS_HEADER_CONSTANT )
+		CPacketView Packet( RecvBuffer );
+
+		if( !Packet.GetHeaderComplete( ) )
+			return;
+
+		if( Packet.GetHeader( ) == W3GS_HEADER_CONSTANT || Packet.GetHeader( ) == GPS_HEADER_CONSTANT )
 		{
 			// bytes 2 and 3 contain the length of the packet
 
-			uint16_t Length = UTIL_ByteArrayToUInt16( Bytes, false, 2 );
+			uint16_t Length = Packet.GetLength( );
 
-			if( Length >= 4 )
+			if( Packet.GetValidLength( ) )
 			{
-				if( Bytes.size( ) >= Length )
+				if( Packet.GetComplete( ) )
 				{
-					m_Packets.push( new CCommandPacket( Bytes[0], Bytes[1], BYTEARRAY( Bytes.begin( ), Bytes.begin( ) + Length ) ) );
+					m_Packets.push( m_Game->GetPool( )->NewCommandPacket( Packet ) );
 
-					if( Bytes[0] == W3GS_HEADER_CONSTANT )
+					if( Packet.GetHeader( ) == W3GS_HEADER_CONSTANT )
 						++m_TotalPacketsReceived;
 
-					*RecvBuffer = RecvBuffer->substr( Length );
-					Bytes = BYTEARRAY( Bytes.begin( ) + Length, Bytes.end( ) );
+					RecvBuffer->Consume( Length );
 				}
 				else
 					return;
@@ -430,7 +494,7 @@ void CGamePlayer :: ProcessPackets( )
 				break;
 
 			case CGameProtocol :: W3GS_OUTGOING_ACTION:
-				Action = m_Protocol->RECEIVE_W3GS_OUTGOING_ACTION( Packet->GetData( ), m_PID );
+				Action = m_Protocol->RECEIVE_W3GS_OUTGOING_ACTION( Packet->GetData( ), m_PID, m_Game->GetPool( ) );
 
 				if( Action )
 				{
@@ -442,7 +506,6 @@ void CGamePlayer :: ProcessPackets( )
 
 			case CGameProtocol :: W3GS_OUTGOING_KEEPALIVE:
 				CheckSum = m_Protocol->RECEIVE_W3GS_OUTGOING_KEEPALIVE( Packet->GetData( ) );
-				m_CheckSums.push( CheckSum );
 				++m_SyncCounter;
 				m_Game->EventPlayerKeepAlive( this, CheckSum );
 				break;
@@ -509,7 +572,7 @@ void CGamePlayer :: ProcessPackets( )
 		}
 		else if( Packet->GetPacketType( ) == GPS_HEADER_CONSTANT )
 		{
-			BYTEARRAY Data = Packet->GetData( );
+			BYTEARRAY &Data = Packet->GetData( );
 
 			if( Packet->GetID( ) == CGPSProtocol :: GPS_INIT )
 			{
@@ -552,15 +615,16 @@ void CGamePlayer :: ProcessPackets( )
 			}
 		}
 
-		delete Packet;
+		m_Game->GetPool( )->Delete( Packet );
 	}
 }
 
-void CGamePlayer :: Send( BYTEARRAY data )
+void CGamePlayer :: Send( CPacket data )
 {
 	// must start counting packet total from beginning of connection
 	// but we can avoid buffering packets until we know the client is using GProxy++ since that'll be determined before the game starts
 	// this prevents us from buffering packets for non-GProxy++ clients
+	// the GProxy++ buffer and the socket's send queue share the packet so buffering it doesn't copy it
 
 	++m_TotalPacketsSent;
 
@@ -570,6 +634,17 @@ void CGamePlayer :: Send( BYTEARRAY data )
 	CPotentialPlayer :: Send( data );
 }
 
+void CGamePlayer :: SendMapPart( CPacket data )
+{
+	// map parts are queued as bulk data so the lobby packets we send the player during the download don't wait behind them
+	// they're only sent in the lobby so there's no need to buffer them for GProxy++
+
+	++m_TotalPacketsSent;
+
+	if( m_Socket )
+		m_Socket->PutBulkBytes( data );
+}
+
 void CGamePlayer :: EventGProxyReconnect( CTCPSocket *NewSocket, uint32_t LastPacket )
 {
 	delete m_Socket;
@@ -594,7 +669,7 @@ void CGamePlayer :: EventGProxyReconnect( CTCPSocket *NewSocket, uint32_t LastPa
 
 	// send remaining packets from buffer, preserve buffer
 
-	queue<BYTEARRAY> TempBuffer;
+	queue<CPacket> TempBuffer;
 
 	while( !m_GProxyBuffer.empty( ) )
 	{
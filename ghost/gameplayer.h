@@ -27,6 +27,13 @@ class CGameProtocol;
 class CGame;
 class CIncomingJoinPlayer;
 
+// the map download window (the number of map bytes sent to a player but not acknowledged yet) starts at DOWNLOAD_INITIAL_WINDOW and is kept between the limits, see CGamePlayer :: EventMapPartAcked
+// the maximum is the fixed window we used to use for everyone
+
+#define DOWNLOAD_INITIAL_WINDOW	( MAPPART_SIZE * 16 )
+#define DOWNLOAD_MIN_WINDOW		( MAPPART_SIZE * 8 )
+#define DOWNLOAD_MAX_WINDOW		( MAPPART_SIZE * 250 )
+
 //
 // CPotentialPlayer
 //
@@ -66,13 +73,13 @@ public:
 
 	// processing functions
 
-	virtual bool Update( void *fd );
+	virtual bool Update( );
 	virtual void ExtractPackets( );
 	virtual void ProcessPackets( );
 
 	// other functions
 
-	virtual void Send( BYTEARRAY data );
+	virtual void Send( CPacket data );
 };
 
 //
@@ -86,7 +93,6 @@ private:
 	string m_Name;								// the player's name
 	BYTEARRAY m_InternalIP;						// the player's internal IP address as reported by the player when connecting
 	vector<uint32_t> m_Pings;					// store the last few (20) pings received so we can take an average
-	queue<uint32_t> m_CheckSums;				// the last few checksums the player has sent (for detecting desyncs)
 	string m_LeftReason;						// the reason the player left the game
 	string m_SpoofedRealm;						// the realm the player last spoof checked on
 	string m_JoinedRealm;						// the realm the player joined on (probable, can be spoofed)
@@ -98,6 +104,10 @@ private:
 	uint32_t m_JoinTime;						// GetTime when the player joined the game (used to delay sending the /whois a few seconds to allow for some lag)
 	uint32_t m_LastMapPartSent;					// the last mappart sent to the player (for sending more than one part at a time)
 	uint32_t m_LastMapPartAcked;				// the last mappart acknowledged by the player
+	uint32_t m_DownloadWindow;					// how many bytes of map data can be sent to the player without being acknowledged
+	uint32_t m_DownloadRate;					// the player's measured download rate in bytes/sec
+	uint32_t m_DownloadRateBytes;				// the number of map bytes acknowledged since m_DownloadRateTicks
+	uint32_t m_DownloadRateTicks;				// GetTicks when we started measuring the current download rate sample
 	uint32_t m_StartedDownloadingTicks;			// GetTicks when the player started downloading the map
 	uint32_t m_FinishedDownloadingTime;			// GetTime when the player finished downloading the map
 	uint32_t m_FinishedLoadingTicks;			// GetTicks when the player finished loading the game
@@ -124,7 +134,7 @@ private:
 	bool m_LeftMessageSent;						// if the playerleave message has been sent or not
 	bool m_GProxy;								// if the player is using GProxy++
 	bool m_GProxyDisconnectNoticeSent;			// if a disconnection notice has been sent or not when using GProxy++
-	queue<BYTEARRAY> m_GProxyBuffer;
+	queue<CPacket> m_GProxyBuffer;
 	uint32_t m_GProxyReconnectKey;
 	uint32_t m_LastGProxyAckTime;
 
@@ -137,8 +147,6 @@ public:
 	string GetName( )							{ return m_Name; }
 	BYTEARRAY GetInternalIP( )					{ return m_InternalIP; }
 	unsigned int GetNumPings( )					{ return m_Pings.size( ); }
-	unsigned int GetNumCheckSums( )				{ return m_CheckSums.size( ); }
-	queue<uint32_t> *GetCheckSums( )			{ return &m_CheckSums; }
 	string GetLeftReason( )						{ return m_LeftReason; }
 	string GetSpoofedRealm( )					{ return m_SpoofedRealm; }
 	string GetJoinedRealm( )					{ return m_JoinedRealm; }
@@ -148,6 +156,8 @@ public:
 	uint32_t GetJoinTime( )						{ return m_JoinTime; }
 	uint32_t GetLastMapPartSent( )				{ return m_LastMapPartSent; }
 	uint32_t GetLastMapPartAcked( )				{ return m_LastMapPartAcked; }
+	uint32_t GetDownloadWindow( )				{ return m_DownloadWindow; }
+	uint32_t GetDownloadRate( )					{ return m_DownloadRate; }
 	uint32_t GetStartedDownloadingTicks( )		{ return m_StartedDownloadingTicks; }
 	uint32_t GetFinishedDownloadingTime( )		{ return m_FinishedDownloadingTime; }
 	uint32_t GetFinishedLoadingTicks( )			{ return m_FinishedLoadingTicks; }
@@ -175,6 +185,7 @@ public:
 	bool GetGProxy( )							{ return m_GProxy; }
 	bool GetGProxyDisconnectNoticeSent( )		{ return m_GProxyDisconnectNoticeSent; }
 	uint32_t GetGProxyReconnectKey( )			{ return m_GProxyReconnectKey; }
+	uint32_t GetTotalPacketsReceived( )			{ return m_TotalPacketsReceived; }
 
 	void SetLeftReason( string nLeftReason )										{ m_LeftReason = nLeftReason; }
 	void SetSpoofedRealm( string nSpoofedRealm )									{ m_SpoofedRealm = nSpoofedRealm; }
@@ -182,7 +193,6 @@ public:
 	void SetLoginAttempts( uint32_t nLoginAttempts )								{ m_LoginAttempts = nLoginAttempts; }
 	void SetSyncCounter( uint32_t nSyncCounter )									{ m_SyncCounter = nSyncCounter; }
 	void SetLastMapPartSent( uint32_t nLastMapPartSent )							{ m_LastMapPartSent = nLastMapPartSent; }
-	void SetLastMapPartAcked( uint32_t nLastMapPartAcked )							{ m_LastMapPartAcked = nLastMapPartAcked; }
 	void SetStartedDownloadingTicks( uint32_t nStartedDownloadingTicks )			{ m_StartedDownloadingTicks = nStartedDownloadingTicks; }
 	void SetFinishedDownloadingTime( uint32_t nFinishedDownloadingTime )			{ m_FinishedDownloadingTime = nFinishedDownloadingTime; }
 	void SetStartedLaggingTicks( uint32_t nStartedLaggingTicks )					{ m_StartedLaggingTicks = nStartedLaggingTicks; }
@@ -207,18 +217,21 @@ public:
 
 	string GetNameTerminated( );
 	uint32_t GetPing( bool LCPing );
+	void EventMapPartAcked( uint32_t lastMapPartAcked );
 
 	void AddLoadInGameData( BYTEARRAY nLoadInGameData )								{ m_LoadInGameData.push( nLoadInGameData ); }
 
 	// processing functions
 
-	virtual bool Update( void *fd );
+	virtual uint32_t GetNextTimerTicks( );
+	virtual bool Update( );
 	virtual void ExtractPackets( );
 	virtual void ProcessPackets( );
 
 	// other functions
 
-	virtual void Send( BYTEARRAY data );
+	virtual void Send( CPacket data );
+	virtual void SendMapPart( CPacket data );
 	virtual void EventGProxyReconnect( CTCPSocket *NewSocket, uint32_t LastPacket );
 };
 
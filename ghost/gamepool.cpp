@@ -0,0 +1,129 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+
+#include "ghost.h"
+#include "socket.h"
+#include "commandpacket.h"
+#include "gameprotocol.h"
+#include "gamepool.h"
+
+//
+// CGamePool
+//
+
+CGamePool :: CGamePool( ) : m_Allocations( 0 ), m_TotalAllocations( 0 ), m_TotalReused( 0 )
+{
+
+}
+
+CGamePool :: ~CGamePool( )
+{
+	for( vector<CCommandPacket *> :: iterator i = m_FreePackets.begin( ); i != m_FreePackets.end( ); ++i )
+		delete *i;
+
+	for( vector<CIncomingAction *> :: iterator i = m_FreeActions.begin( ); i != m_FreeActions.end( ); ++i )
+		delete *i;
+}
+
+CCommandPacket *CGamePool :: NewCommandPacket( CPacketView &view )
+{
+	CCommandPacket *Packet;
+
+	if( m_FreePackets.empty( ) )
+	{
+		Packet = new CCommandPacket( 0, 0, BYTEARRAY( ) );
+		Packet->GetData( ).reserve( GAMEPOOL_MIN_STORAGE );
+		++m_Allocations;
+		++m_TotalAllocations;
+	}
+	else
+	{
+		Packet = m_FreePackets.back( );
+		m_FreePackets.pop_back( );
+		++m_TotalReused;
+	}
+
+	uint32_t Capacity = Packet->GetData( ).capacity( );
+	Packet->Assign( view );
+
+	if( Packet->GetData( ).capacity( ) != Capacity )
+	{
+		++m_Allocations;
+		++m_TotalAllocations;
+	}
+
+	return Packet;
+}
+
+CIncomingAction *CGamePool :: NewIncomingAction( unsigned char PID, const unsigned char *CRC, uint32_t CRCLength, const unsigned char *action, uint32_t actionLength )
+{
+	CIncomingAction *Action;
+
+	if( m_FreeActions.empty( ) )
+	{
+		BYTEARRAY EmptyCRC;
+		BYTEARRAY EmptyAction;
+		Action = new CIncomingAction( PID, EmptyCRC, EmptyAction );
+		Action->Reserve( 4, GAMEPOOL_MIN_STORAGE );
+		++m_Allocations;
+		++m_TotalAllocations;
+	}
+	else
+	{
+		Action = m_FreeActions.back( );
+		m_FreeActions.pop_back( );
+		++m_TotalReused;
+	}
+
+	uint32_t Capacity = Action->GetCapacity( );
+	Action->Assign( PID, CRC, CRCLength, action, actionLength );
+
+	if( Action->GetCapacity( ) != Capacity )
+	{
+		++m_Allocations;
+		++m_TotalAllocations;
+	}
+
+	return Action;
+}
+
+void CGamePool :: Delete( CCommandPacket *packet )
+{
+	if( m_FreePackets.size( ) < GAMEPOOL_MAX_FREE && packet->GetData( ).capacity( ) <= GAMEPOOL_MAX_STORAGE )
+		m_FreePackets.push_back( packet );
+	else
+		delete packet;
+}
+
+void CGamePool :: Delete( CIncomingAction *action )
+{
+	if( m_FreeActions.size( ) < GAMEPOOL_MAX_FREE && action->GetCapacity( ) <= GAMEPOOL_MAX_STORAGE )
+		m_FreeActions.push_back( action );
+	else
+		delete action;
+}
+
+uint32_t CGamePool :: TakeAllocations( )
+{
+	uint32_t Allocations = m_Allocations;
+	m_Allocations = 0;
+	return Allocations;
+}
@@ -0,0 +1,75 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+
+#ifndef GAMEPOOL_H
+#define GAMEPOOL_H
+
+class CPacketView;
+class CCommandPacket;
+class CIncomingAction;
+
+// the most objects of each type kept for reuse, anything beyond this is deleted
+
+#define GAMEPOOL_MAX_FREE		256
+
+// new objects reserve this many bytes of storage up front so reusing them for a slightly larger packet or action doesn't have to grow it (most are much smaller than this)
+
+#define GAMEPOOL_MIN_STORAGE	256
+
+// objects whose byte storage grew beyond this many bytes are deleted instead of kept so one huge packet doesn't pin its storage for the rest of the game
+
+#define GAMEPOOL_MAX_STORAGE	2048
+
+//
+// CGamePool
+//
+
+// recycles the CCommandPacket for every packet a player sends and the CIncomingAction for every action in the game
+// a game receives and sends several actions per player every tick so without the pool each of them would be two or three trips to the heap
+// a recycled object keeps its byte storage so a game stops allocating once the pool has grown to fit its traffic
+// each game has its own pool which is only used by the worker thread running the game so no locking is needed
+// objects handed out by the pool are ordinary heap objects, deleting one instead of returning it is fine (e.g. in destructors)
+// only the command packets and actions are pooled, the packets a game sends (the CPacket and its byte array) and the encoded action updates are still allocated every tick and aren't counted here
+
+class CGamePool
+{
+private:
+	vector<CCommandPacket *> m_FreePackets;
+	vector<CIncomingAction *> m_FreeActions;
+	uint32_t m_Allocations;					// number of heap allocations of pooled objects (new objects and byte storage which had to grow) since the last TakeAllocations, other allocations on the action path aren't counted
+	uint32_t m_TotalAllocations;			// number of heap allocations over the lifetime of the pool
+	uint32_t m_TotalReused;					// number of objects handed out again instead of allocated over the lifetime of the pool
+
+public:
+	CGamePool( );
+	~CGamePool( );
+
+	uint32_t GetTotalAllocations( )			{ return m_TotalAllocations; }
+	uint32_t GetTotalReused( )				{ return m_TotalReused; }
+
+	CCommandPacket *NewCommandPacket( CPacketView &view );
+	CIncomingAction *NewIncomingAction( unsigned char PID, const unsigned char *CRC, uint32_t CRCLength, const unsigned char *action, uint32_t actionLength );
+	void Delete( CCommandPacket *packet );
+	void Delete( CIncomingAction *action );
+	uint32_t TakeAllocations( );
+};
+
+#endif
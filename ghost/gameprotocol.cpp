@@ -21,9 +21,12 @@
 #include "ghost.h"
 #include "util.h"
 #include "crc32.h"
+#include "socket.h"
 #include "gameplayer.h"
 #include "gameprotocol.h"
 #include "game_base.h"
+#include "gamepool.h"
+#include "map.h"
 
 //
 // CGameProtocol
@@ -43,7 +46,7 @@ CGameProtocol :: ~CGameProtocol( )
 // RECEIVE FUNCTIONS //
 ///////////////////////
 
-CIncomingJoinPlayer *CGameProtocol :: RECEIVE_W3GS_REQJOIN( BYTEARRAY data )
+CIncomingJoinPlayer *CGameProtocol :: RECEIVE_W3GS_REQJOIN( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED W3GS_REQJOIN" );
 	// DEBUG_Print( data );
@@ -76,7 +79,7 @@ CIncomingJoinPlayer *CGameProtocol :: RECEIVE_W3GS_REQJOIN( BYTEARRAY data )
 	return NULL;
 }
 
-uint32_t CGameProtocol :: RECEIVE_W3GS_LEAVEGAME( BYTEARRAY data )
+uint32_t CGameProtocol :: RECEIVE_W3GS_LEAVEGAME( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED W3GS_LEAVEGAME" );
 	// DEBUG_Print( data );
@@ -91,7 +94,7 @@ uint32_t CGameProtocol :: RECEIVE_W3GS_LEAVEGAME( BYTEARRAY data )
 	return 0;
 }
 
-bool CGameProtocol :: RECEIVE_W3GS_GAMELOADED_SELF( BYTEARRAY data )
+bool CGameProtocol :: RECEIVE_W3GS_GAMELOADED_SELF( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED W3GS_GAMELOADED_SELF" );
 	// DEBUG_Print( data );
@@ -105,7 +108,7 @@ bool CGameProtocol :: RECEIVE_W3GS_GAMELOADED_SELF( BYTEARRAY data )
 	return false;
 }
 
-CIncomingAction *CGameProtocol :: RECEIVE_W3GS_OUTGOING_ACTION( BYTEARRAY data, unsigned char PID )
+CIncomingAction *CGameProtocol :: RECEIVE_W3GS_OUTGOING_ACTION( BYTEARRAY &data, unsigned char PID, CGamePool *pool )
 {
 	// DEBUG_Print( "RECEIVED W3GS_OUTGOING_ACTION" );
 	// DEBUG_Print( data );
@@ -116,16 +119,12 @@ CIncomingAction *CGameProtocol :: RECEIVE_W3GS_OUTGOING_ACTION( BYTEARRAY data,
 	// remainder of packet		-> Action
 
 	if( PID != 255 && ValidateLength( data ) && data.size( ) >= 8 )
-	{
-		BYTEARRAY CRC = BYTEARRAY( data.begin( ) + 4, data.begin( ) + 8 );
-		BYTEARRAY Action = BYTEARRAY( data.begin( ) + 8, data.end( ) );
-		return new CIncomingAction( PID, CRC, Action );
-	}
+		return pool->NewIncomingAction( PID, &data[0] + 4, 4, &data[0] + 8, data.size( ) - 8 );
 
 	return NULL;
 }
 
-uint32_t CGameProtocol :: RECEIVE_W3GS_OUTGOING_KEEPALIVE( BYTEARRAY data )
+uint32_t CGameProtocol :: RECEIVE_W3GS_OUTGOING_KEEPALIVE( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED W3GS_OUTGOING_KEEPALIVE" );
 	// DEBUG_Print( data );
@@ -141,7 +140,7 @@ uint32_t CGameProtocol :: RECEIVE_W3GS_OUTGOING_KEEPALIVE( BYTEARRAY data )
 	return 0;
 }
 
-CIncomingChatPlayer *CGameProtocol :: RECEIVE_W3GS_CHAT_TO_HOST( BYTEARRAY data )
+CIncomingChatPlayer *CGameProtocol :: RECEIVE_W3GS_CHAT_TO_HOST( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED W3GS_CHAT_TO_HOST" );
 	// DEBUG_Print( data );
@@ -208,7 +207,7 @@ CIncomingChatPlayer *CGameProtocol :: RECEIVE_W3GS_CHAT_TO_HOST( BYTEARRAY data
 	return NULL;
 }
 
-bool CGameProtocol :: RECEIVE_W3GS_SEARCHGAME( BYTEARRAY data, unsigned char war3Version )
+bool CGameProtocol :: RECEIVE_W3GS_SEARCHGAME( BYTEARRAY &data, unsigned char war3Version )
 {
 	uint32_t ProductID	= 1462982736;	// "W3XP"
 	uint32_t Version	= war3Version;
@@ -237,7 +236,7 @@ bool CGameProtocol :: RECEIVE_W3GS_SEARCHGAME( BYTEARRAY data, unsigned char war
 	return false;
 }
 
-CIncomingMapSize *CGameProtocol :: RECEIVE_W3GS_MAPSIZE( BYTEARRAY data, BYTEARRAY mapSize )
+CIncomingMapSize *CGameProtocol :: RECEIVE_W3GS_MAPSIZE( BYTEARRAY &data, BYTEARRAY mapSize )
 {
 	// DEBUG_Print( "RECEIVED W3GS_MAPSIZE" );
 	// DEBUG_Print( data );
@@ -254,7 +253,7 @@ CIncomingMapSize *CGameProtocol :: RECEIVE_W3GS_MAPSIZE( BYTEARRAY data, BYTEARR
 	return NULL;
 }
 
-uint32_t CGameProtocol :: RECEIVE_W3GS_MAPPARTOK( BYTEARRAY data )
+uint32_t CGameProtocol :: RECEIVE_W3GS_MAPPARTOK( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED W3GS_MAPPARTOK" );
 	// DEBUG_Print( data );
@@ -272,7 +271,7 @@ uint32_t CGameProtocol :: RECEIVE_W3GS_MAPPARTOK( BYTEARRAY data )
 	return 0;
 }
 
-uint32_t CGameProtocol :: RECEIVE_W3GS_PONG_TO_HOST( BYTEARRAY data )
+uint32_t CGameProtocol :: RECEIVE_W3GS_PONG_TO_HOST( BYTEARRAY &data )
 {
 	// DEBUG_Print( "RECEIVED W3GS_PONG_TO_HOST" );
 	// DEBUG_Print( data );
@@ -482,45 +481,42 @@ BYTEARRAY CGameProtocol :: SEND_W3GS_COUNTDOWN_END( )
 	return packet;
 }
 
-BYTEARRAY CGameProtocol :: SEND_W3GS_INCOMING_ACTION( queue<CIncomingAction *> actions, uint16_t sendInterval )
+BYTEARRAY CGameProtocol :: SEND_W3GS_INCOMING_ACTION( const deque<CIncomingAction *> &actions, uint16_t sendInterval )
 {
-	BYTEARRAY packet;
-	packet.push_back( W3GS_HEADER_CONSTANT );				// W3GS header constant
-	packet.push_back( W3GS_INCOMING_ACTION );				// W3GS_INCOMING_ACTION
-	packet.push_back( 0 );									// packet length will be assigned later
-	packet.push_back( 0 );									// packet length will be assigned later
-	UTIL_AppendByteArray( packet, sendInterval, false );	// send interval
+	// the caller must make sure the actions fit into one packet, use SEND_W3GS_INCOMING_ACTIONS otherwise
 
-	// create subpacket
+	uint32_t Length = 0;
 
-	if( !actions.empty( ) )
-	{
-		BYTEARRAY subpacket;
+	for( deque<CIncomingAction *> :: const_iterator i = actions.begin( ); i != actions.end( ); ++i )
+		Length += (*i)->GetLength( );
 
-		while( !actions.empty( ) )
-		{
-			CIncomingAction *Action = actions.front( );
-			actions.pop( );
-			subpacket.push_back( Action->GetPID( ) );
-			UTIL_AppendByteArray( subpacket, (uint16_t)Action->GetAction( )->size( ), false );
-			UTIL_AppendByteArrayFast( subpacket, *Action->GetAction( ) );
-		}
+	return EncodeIncomingActions( W3GS_INCOMING_ACTION, sendInterval, actions.begin( ), actions.end( ), Length );
+}
 
-		// calculate crc (we only care about the first 2 bytes though)
+vector<CPacket> CGameProtocol :: SEND_W3GS_INCOMING_ACTIONS( const deque<CIncomingAction *> &actions, uint16_t sendInterval )
+{
+	// we aren't allowed to send more than 1460 bytes in a single packet but it's possible we might have more than that many bytes of actions
+	// the actions are split into packets of at most 1452 bytes of actions (the packets use an extra 8 bytes) in the order they were received
+	// every packet but the last is a W3GS_INCOMING_ACTION2 packet, the last is the W3GS_INCOMING_ACTION packet which ends the update so it must be sent after the others
 
-		BYTEARRAY crc32 = UTIL_CreateByteArray( m_GHost->m_CRC->FullCRC( (unsigned char *)string( subpacket.begin( ), subpacket.end( ) ).c_str( ), subpacket.size( ) ), false );
-		crc32.resize( 2 );
+	vector<CPacket> packets;
+	deque<CIncomingAction *> :: const_iterator Start = actions.begin( );
+	uint32_t Length = 0;
 
-		// finish subpacket
+	for( deque<CIncomingAction *> :: const_iterator i = actions.begin( ); i != actions.end( ); ++i )
+	{
+		if( i != Start && Length + (*i)->GetLength( ) > 1452 )
+		{
+			packets.push_back( EncodeIncomingActions( W3GS_INCOMING_ACTION2, 0, Start, i, Length ) );
+			Start = i;
+			Length = 0;
+		}
 
-		UTIL_AppendByteArrayFast( packet, crc32 );			// crc
-		UTIL_AppendByteArrayFast( packet, subpacket );		// subpacket
+		Length += (*i)->GetLength( );
 	}
 
-	AssignLength( packet );
-	// DEBUG_Print( "SENT W3GS_INCOMING_ACTION" );
-	// DEBUG_Print( packet );
-	return packet;
+	packets.push_back( EncodeIncomingActions( W3GS_INCOMING_ACTION, sendInterval, Start, actions.end( ), Length ) );
+	return packets;
 }
 
 BYTEARRAY CGameProtocol :: SEND_W3GS_CHAT_FROM_HOST( unsigned char fromPID, BYTEARRAY toPIDs, unsigned char flag, BYTEARRAY flagExtra, string message )
@@ -817,89 +813,48 @@ BYTEARRAY CGameProtocol :: SEND_W3GS_STARTDOWNLOAD( unsigned char fromPID )
 	return packet;
 }
 
-BYTEARRAY CGameProtocol :: SEND_W3GS_MAPPART( unsigned char fromPID, unsigned char toPID, uint32_t start, string *mapData )
+CPacket CGameProtocol :: SEND_W3GS_MAPPART( unsigned char fromPID, unsigned char toPID, uint32_t start, boost::shared_ptr<CMapData> mapData )
 {
 	unsigned char Unknown[] = { 1, 0, 0, 0 };
 
 	BYTEARRAY packet;
 
-	if( start < mapData->size( ) )
+	if( start < mapData->GetSize( ) )
 	{
+		// calculate end position (don't send more than MAPPART_SIZE map bytes in one packet)
+
+		uint32_t End = start + MAPPART_SIZE;
+
+		if( End > mapData->GetSize( ) )
+			End = mapData->GetSize( );
+
+		packet.reserve( 18 );
 		packet.push_back( W3GS_HEADER_CONSTANT );				// W3GS header constant
 		packet.push_back( W3GS_MAPPART );						// W3GS_MAPPART
-		packet.push_back( 0 );									// packet length will be assigned later
-		packet.push_back( 0 );									// packet length will be assigned later
+		UTIL_AppendByteArray( packet, (uint16_t)( 18 + End - start ), false );	// packet length (including the map data)
 		packet.push_back( toPID );								// to PID
 		packet.push_back( fromPID );							// from PID
 		UTIL_AppendByteArray( packet, Unknown, 4 );				// ???
 		UTIL_AppendByteArray( packet, start, false );			// start position
 
-		// calculate end position (don't send more than 1442 map bytes in one packet)
-
-		uint32_t End = start + 1442;
-
-		if( End > mapData->size( ) )
-			End = mapData->size( );
-
-		// calculate crc
+		// the crc was calculated when the map was loaded unless we're sending from the middle of a map part (which we never do)
 
-		BYTEARRAY crc32 = UTIL_CreateByteArray( m_GHost->m_CRC->FullCRC( (unsigned char *)mapData->c_str( ) + start, End - start ), false );
-		UTIL_AppendByteArrayFast( packet, crc32 );
+		if( start % MAPPART_SIZE == 0 )
+			UTIL_AppendByteArray( packet, mapData->GetPartCRC( start / MAPPART_SIZE ), false );
+		else
+			UTIL_AppendByteArray( packet, m_GHost->m_CRC->FullCRC( (unsigned char *)mapData->GetData( ) + start, End - start ), false );
 
 		// map data
+		// it isn't copied into the packet, the socket sends it straight from the map data (usually the memory mapped map file) which the packet keeps open until it's been sent
 
-		BYTEARRAY Data = UTIL_CreateByteArray( (unsigned char *)mapData->c_str( ) + start, End - start );
-		UTIL_AppendByteArrayFast( packet, Data );
-		AssignLength( packet );
+		return CPacket( packet, mapData, mapData->GetData( ) + start, End - start );
 	}
 	else
 		BOOST_LOG_TRIVIAL(warning) << "[GAMEPROTO] invalid parameters passed to SEND_W3GS_MAPPART";
 
 	// DEBUG_Print( "SENT W3GS_MAPPART" );
 	// DEBUG_Print( packet );
-	return packet;
-}
-
-BYTEARRAY CGameProtocol :: SEND_W3GS_INCOMING_ACTION2( queue<CIncomingAction *> actions )
-{
-	BYTEARRAY packet;
-	packet.push_back( W3GS_HEADER_CONSTANT );				// W3GS header constant
-	packet.push_back( W3GS_INCOMING_ACTION2 );				// W3GS_INCOMING_ACTION2
-	packet.push_back( 0 );									// packet length will be assigned later
-	packet.push_back( 0 );									// packet length will be assigned later
-	packet.push_back( 0 );									// ??? (send interval?)
-	packet.push_back( 0 );									// ??? (send interval?)
-
-	// create subpacket
-
-	if( !actions.empty( ) )
-	{
-		BYTEARRAY subpacket;
-
-		while( !actions.empty( ) )
-		{
-			CIncomingAction *Action = actions.front( );
-			actions.pop( );
-			subpacket.push_back( Action->GetPID( ) );
-			UTIL_AppendByteArray( subpacket, (uint16_t)Action->GetAction( )->size( ), false );
-			UTIL_AppendByteArrayFast( subpacket, *Action->GetAction( ) );
-		}
-
-		// calculate crc (we only care about the first 2 bytes though)
-
-		BYTEARRAY crc32 = UTIL_CreateByteArray( m_GHost->m_CRC->FullCRC( (unsigned char *)string( subpacket.begin( ), subpacket.end( ) ).c_str( ), subpacket.size( ) ), false );
-		crc32.resize( 2 );
-
-		// finish subpacket
-
-		UTIL_AppendByteArrayFast( packet, crc32 );			// crc
-		UTIL_AppendByteArrayFast( packet, subpacket );		// subpacket
-	}
-
-	AssignLength( packet );
-	// DEBUG_Print( "SENT W3GS_INCOMING_ACTION2" );
-	// DEBUG_Print( packet );
-	return packet;
+	return CPacket( packet );
 }
 
 /////////////////////
@@ -923,6 +878,60 @@ bool CGameProtocol :: AssignLength( BYTEARRAY &content )
 	return false;
 }
 
+BYTEARRAY CGameProtocol :: EncodeIncomingActions( unsigned char id, uint16_t sendInterval, deque<CIncomingAction *> :: const_iterator begin, deque<CIncomingAction *> :: const_iterator end, uint32_t length )
+{
+	// 1 byte			-> W3GS header constant
+	// 1 byte			-> id (W3GS_INCOMING_ACTION or W3GS_INCOMING_ACTION2)
+	// 2 bytes			-> packet length
+	// 2 bytes			-> send interval (always 0 for W3GS_INCOMING_ACTION2)
+	// if there are actions:
+	//	2 bytes			-> the first 2 bytes of the crc of the encoded actions
+	//	for each action:
+	//		1 byte		-> PID
+	//		2 bytes		-> action length
+	//		n bytes		-> action
+	// length is the sum of the actions' GetLength so the packet is written in one go straight into a buffer of the right size, the caller hands it to a CPacket without copying it
+
+	uint32_t Size = begin == end ? 6 : 8 + length;
+	BYTEARRAY packet( Size );
+	unsigned char *Data = &packet[0];
+	Data[0] = W3GS_HEADER_CONSTANT;
+	Data[1] = id;
+	Data[2] = (unsigned char)Size;
+	Data[3] = (unsigned char)( Size >> 8 );
+	Data[4] = (unsigned char)sendInterval;
+	Data[5] = (unsigned char)( sendInterval >> 8 );
+
+	if( begin == end )
+		return packet;
+
+	unsigned char *Actions = Data + 8;
+	unsigned char *Position = Actions;
+
+	for( deque<CIncomingAction *> :: const_iterator i = begin; i != end; ++i )
+	{
+		BYTEARRAY *Action = (*i)->GetAction( );
+		uint16_t ActionLength = Action->size( );
+		*Position++ = (*i)->GetPID( );
+		*Position++ = (unsigned char)ActionLength;
+		*Position++ = (unsigned char)( ActionLength >> 8 );
+
+		if( ActionLength > 0 )
+			memcpy( Position, &(*Action)[0], ActionLength );
+
+		Position += ActionLength;
+	}
+
+	// the actions are contiguous in the packet so the crc is calculated in place with one call, the crc32 code is fastest on long runs
+
+	uint32_t CRC = m_GHost->m_CRC->FullCRC( Actions, Position - Actions );
+	Data[6] = (unsigned char)CRC;
+	Data[7] = (unsigned char)( CRC >> 8 );
+	// DEBUG_Print( "SENT W3GS_INCOMING_ACTION" );
+	// DEBUG_Print( packet );
+	return packet;
+}
+
 bool CGameProtocol :: ValidateLength( BYTEARRAY &content )
 {
 	// verify that bytes 3 and 4 (indices 2 and 3) of the content array describe the length
@@ -985,6 +994,13 @@ CIncomingAction :: ~CIncomingAction( )
 
 }
 
+void CIncomingAction :: Assign( unsigned char nPID, const unsigned char *nCRC, uint32_t nCRCLength, const unsigned char *nAction, uint32_t nActionLength )
+{
+	m_PID = nPID;
+	m_CRC.assign( nCRC, nCRC + nCRCLength );
+	m_Action.assign( nAction, nAction + nActionLength );
+}
+
 //
 // CIncomingChatPlayer
 //
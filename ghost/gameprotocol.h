@@ -53,8 +53,11 @@
 class CGamePlayer;
 class CIncomingJoinPlayer;
 class CIncomingAction;
+class CGamePool;
 class CIncomingChatPlayer;
 class CIncomingMapSize;
+class CMapData;
+class CPacket;
 
 class CGameProtocol
 {
@@ -106,16 +109,16 @@ public:
 
 	// receive functions
 
-	CIncomingJoinPlayer *RECEIVE_W3GS_REQJOIN( BYTEARRAY data );
-	uint32_t RECEIVE_W3GS_LEAVEGAME( BYTEARRAY data );
-	bool RECEIVE_W3GS_GAMELOADED_SELF( BYTEARRAY data );
-	CIncomingAction *RECEIVE_W3GS_OUTGOING_ACTION( BYTEARRAY data, unsigned char PID );
-	uint32_t RECEIVE_W3GS_OUTGOING_KEEPALIVE( BYTEARRAY data );
-	CIncomingChatPlayer *RECEIVE_W3GS_CHAT_TO_HOST( BYTEARRAY data );
-	bool RECEIVE_W3GS_SEARCHGAME( BYTEARRAY data, unsigned char war3Version );
-	CIncomingMapSize *RECEIVE_W3GS_MAPSIZE( BYTEARRAY data, BYTEARRAY mapSize );
-	uint32_t RECEIVE_W3GS_MAPPARTOK( BYTEARRAY data );
-	uint32_t RECEIVE_W3GS_PONG_TO_HOST( BYTEARRAY data );
+	CIncomingJoinPlayer *RECEIVE_W3GS_REQJOIN( BYTEARRAY &data );
+	uint32_t RECEIVE_W3GS_LEAVEGAME( BYTEARRAY &data );
+	bool RECEIVE_W3GS_GAMELOADED_SELF( BYTEARRAY &data );
+	CIncomingAction *RECEIVE_W3GS_OUTGOING_ACTION( BYTEARRAY &data, unsigned char PID, CGamePool *pool );
+	uint32_t RECEIVE_W3GS_OUTGOING_KEEPALIVE( BYTEARRAY &data );
+	CIncomingChatPlayer *RECEIVE_W3GS_CHAT_TO_HOST( BYTEARRAY &data );
+	bool RECEIVE_W3GS_SEARCHGAME( BYTEARRAY &data, unsigned char war3Version );
+	CIncomingMapSize *RECEIVE_W3GS_MAPSIZE( BYTEARRAY &data, BYTEARRAY mapSize );
+	uint32_t RECEIVE_W3GS_MAPPARTOK( BYTEARRAY &data );
+	uint32_t RECEIVE_W3GS_PONG_TO_HOST( BYTEARRAY &data );
 
 	// send functions
 
@@ -128,7 +131,8 @@ public:
 	BYTEARRAY SEND_W3GS_SLOTINFO( vector<CGameSlot> &slots, uint32_t randomSeed, unsigned char layoutStyle, unsigned char playerSlots );
 	BYTEARRAY SEND_W3GS_COUNTDOWN_START( );
 	BYTEARRAY SEND_W3GS_COUNTDOWN_END( );
-	BYTEARRAY SEND_W3GS_INCOMING_ACTION( queue<CIncomingAction *> actions, uint16_t sendInterval );
+	BYTEARRAY SEND_W3GS_INCOMING_ACTION( const deque<CIncomingAction *> &actions, uint16_t sendInterval );
+	vector<CPacket> SEND_W3GS_INCOMING_ACTIONS( const deque<CIncomingAction *> &actions, uint16_t sendInterval );
 	BYTEARRAY SEND_W3GS_CHAT_FROM_HOST( unsigned char fromPID, BYTEARRAY toPIDs, unsigned char flag, BYTEARRAY flagExtra, string message );
 	BYTEARRAY SEND_W3GS_START_LAG( vector<CGamePlayer *> players, bool loadInGame = false );
 	BYTEARRAY SEND_W3GS_STOP_LAG( CGamePlayer *player, bool loadInGame = false );
@@ -139,13 +143,13 @@ public:
 	BYTEARRAY SEND_W3GS_DECREATEGAME( );
 	BYTEARRAY SEND_W3GS_MAPCHECK( string mapPath, BYTEARRAY mapSize, BYTEARRAY mapInfo, BYTEARRAY mapCRC, BYTEARRAY mapSHA1 );
 	BYTEARRAY SEND_W3GS_STARTDOWNLOAD( unsigned char fromPID );
-	BYTEARRAY SEND_W3GS_MAPPART( unsigned char fromPID, unsigned char toPID, uint32_t start, string *mapData );
-	BYTEARRAY SEND_W3GS_INCOMING_ACTION2( queue<CIncomingAction *> actions );
+	CPacket SEND_W3GS_MAPPART( unsigned char fromPID, unsigned char toPID, uint32_t start, boost::shared_ptr<CMapData> mapData );
 
 	// other functions
 
 private:
 	bool AssignLength( BYTEARRAY &content );
+	BYTEARRAY EncodeIncomingActions( unsigned char id, uint16_t sendInterval, deque<CIncomingAction *> :: const_iterator begin, deque<CIncomingAction *> :: const_iterator end, uint32_t length );
 	bool ValidateLength( BYTEARRAY &content );
 	BYTEARRAY EncodeSlotInfo( vector<CGameSlot> &slots, uint32_t randomSeed, unsigned char layoutStyle, unsigned char playerSlots );
 };
@@ -191,6 +195,12 @@ public:
 	BYTEARRAY GetCRC( )		{ return m_CRC; }
 	BYTEARRAY *GetAction( )	{ return &m_Action; }
 	uint32_t GetLength( )	{ return m_Action.size( ) + 3; }
+
+	// reuse this action for another action, the byte storage is kept (see CGamePool)
+
+	void Assign( unsigned char nPID, const unsigned char *nCRC, uint32_t nCRCLength, const unsigned char *nAction, uint32_t nActionLength );
+	void Reserve( uint32_t CRCLength, uint32_t actionLength )	{ m_CRC.reserve( CRCLength ); m_Action.reserve( actionLength ); }
+	uint32_t GetCapacity( )	{ return m_CRC.capacity( ) + m_Action.capacity( ); }
 };
 
 //
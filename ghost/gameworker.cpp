@@ -0,0 +1,202 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#include "ghost.h"
+#include "util.h"
+#include "reactor.h"
+#include "timerwheel.h"
+#include "gameworker.h"
+#include "game_base.h"
+#include "gamepool.h"
+
+//
+// CGameWorker
+//
+
+CGameWorker :: CGameWorker( CGHost *nGHost, uint32_t nID ) : m_GHost( nGHost ), m_ID( nID ), m_Thread( NULL ), m_Exiting( false ), m_Woken( false ), m_NumGames( 0 ), m_NumPlayers( 0 ), m_Load( 0 ), m_BusyTicks( 0 ), m_LoadPeriodTicks( GetTicks( ) ), m_PoolAllocations( 0 ), m_PoolAllocationRate( 0 )
+{
+	m_Reactor = CSocketReactor :: Create( m_GHost->m_ReactorType );
+	m_Timers = new CTimerWheel( );
+	m_Thread = new boost::thread( &CGameWorker :: loop, this );
+}
+
+CGameWorker :: ~CGameWorker( )
+{
+	Stop( );
+	delete m_Thread;
+	delete m_Timers;
+	delete m_Reactor;
+}
+
+uint32_t CGameWorker :: GetNumGames( )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+	return m_NumGames;
+}
+
+uint32_t CGameWorker :: GetNumPlayers( )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+	return m_NumPlayers;
+}
+
+uint32_t CGameWorker :: GetLoad( )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+	return m_Load;
+}
+
+string CGameWorker :: GetStatus( )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+	return "worker #" + UTIL_ToString( m_ID ) + ": " + UTIL_ToString( m_NumGames ) + " games, " + UTIL_ToString( m_NumPlayers ) + " players, " + UTIL_ToString( m_Load ) + "% load, " + UTIL_ToString( m_PoolAllocationRate ) + " pooled packet/action allocations/s";
+}
+
+void CGameWorker :: AddGame( CBaseGame *game )
+{
+	game->m_Worker = this;
+
+	boost::mutex::scoped_lock lock( m_Mutex );
+	m_NewGames.push_back( game );
+	++m_NumGames;
+	lock.unlock( );
+
+	Wake( );
+}
+
+void CGameWorker :: Stop( )
+{
+	// the worker keeps running until every game it owns has finished so call doDelete on the games first
+
+	boost::mutex::scoped_lock lock( m_Mutex );
+	m_Exiting = true;
+	lock.unlock( );
+
+	Wake( );
+
+	if( m_Thread && m_Thread->joinable( ) )
+		m_Thread->join( );
+}
+
+void CGameWorker :: Wake( )
+{
+	// this can be called from any thread
+	// we don't know which game the caller queued something for (e.g. m_DoSayGames or a GProxy++ reconnect) so the next loop updates all of them
+
+	boost::mutex::scoped_lock lock( m_Mutex );
+	m_Woken = true;
+	lock.unlock( );
+
+	m_Reactor->Wake( );
+}
+
+void CGameWorker :: loop( )
+{
+	bool Polled = false;
+
+	while( true )
+	{
+		// pick up any games handed over by the main thread
+		// the game's sockets and timers are moved to our reactor and timer wheel from this thread because neither are thread safe
+
+		boost::mutex::scoped_lock lock( m_Mutex );
+		vector<CBaseGame *> NewGames;
+		NewGames.swap( m_NewGames );
+		bool Exiting = m_Exiting;
+		lock.unlock( );
+
+		for( vector<CBaseGame *> :: iterator i = NewGames.begin( ); i != NewGames.end( ); ++i )
+		{
+			(*i)->SetWorker( this );
+			m_Games.push_back( *i );
+		}
+
+		if( Exiting && m_Games.empty( ) )
+			break;
+
+		// block until a socket is ready or the next game timer is due, whichever comes first
+		// we wait for the deadline itself rather than a timeout so the action updates go out on time (see CEPollReactor :: WaitUntil)
+		// games with nothing to do still wake up once per second, see CBaseGame :: GetNextTimerTicks
+		// other threads interrupt the wait with Wake
+		// a timer which is already due doesn't block at all but if that happens twice in a row we block until the next millisecond just in case a game keeps asking for immediate updates
+
+		uint32_t Ticks = GetTicks( );
+		uint32_t Deadline = m_Timers->GetNextDeadline( Ticks, 1000 );
+
+		if( Deadline == Ticks && Polled )
+			Deadline = Ticks + 1;
+
+		Polled = Deadline == Ticks;
+		m_Reactor->WaitUntil( Deadline );
+		m_Timers->Advance( );
+
+		lock.lock( );
+		bool Woken = m_Woken;
+		m_Woken = false;
+		lock.unlock( );
+
+		uint32_t StartTicks = GetTicks( );
+		uint32_t NumPlayers = 0;
+		uint32_t PoolAllocations = 0;
+
+		for( vector<CBaseGame *> :: iterator i = m_Games.begin( ); i != m_Games.end( ); )
+		{
+			// only update the games which had a timer expire or a socket become ready (or all of them if another thread woke us up)
+			// warning: once Run returns true the game may have been deleted already so don't touch it again
+
+			if( ( Woken || (*i)->GetUpdateDue( ) ) && (*i)->Run( ) )
+				i = m_Games.erase( i );
+			else
+			{
+				NumPlayers += (*i)->GetNumHumanPlayers( );
+				PoolAllocations += (*i)->GetPool( )->TakeAllocations( );
+				++i;
+			}
+		}
+
+		lock.lock( );
+		m_NumGames = m_Games.size( ) + m_NewGames.size( );
+		m_NumPlayers = NumPlayers;
+		lock.unlock( );
+
+		UpdateLoad( GetTicks( ) - StartTicks, PoolAllocations );
+	}
+
+	BOOST_LOG_TRIVIAL(info) << "[WORKER: " + UTIL_ToString( m_ID ) + "] all games finished, worker stopped";
+}
+
+void CGameWorker :: UpdateLoad( uint32_t busyTicks, uint32_t poolAllocations )
+{
+	// the load is the percentage of time spent updating games (not waiting on the reactor) over the last 5 seconds
+
+	boost::mutex::scoped_lock lock( m_Mutex );
+	m_BusyTicks += busyTicks;
+	m_PoolAllocations += poolAllocations;
+	uint32_t Ticks = GetTicks( );
+
+	if( Ticks - m_LoadPeriodTicks >= 5000 )
+	{
+		m_Load = m_BusyTicks * 100 / ( Ticks - m_LoadPeriodTicks );
+		m_PoolAllocationRate = m_PoolAllocations * 1000 / ( Ticks - m_LoadPeriodTicks );
+		m_BusyTicks = 0;
+		m_PoolAllocations = 0;
+		m_LoadPeriodTicks = Ticks;
+	}
+}
@@ -0,0 +1,82 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#ifndef GAMEWORKER_H
+#define GAMEWORKER_H
+
+class CSocketReactor;
+class CTimerWheel;
+class CBaseGame;
+
+//
+// CGameWorker
+//
+
+// a game worker is one thread running any number of games
+// the games are sharded across a fixed number of workers (bot_workers) instead of starting a thread per game
+// every game on a worker shares the worker's reactor so one Wait covers all of their sockets
+// every game also registers its next deadline with the worker's timer wheel so we block until the earliest one and only update the games which are due
+// other threads call Wake after handing the worker (or one of its games) something to do so it doesn't sit in the reactor until the next deadline
+
+class CGameWorker
+{
+public:
+	CGHost *m_GHost;
+
+protected:
+	uint32_t m_ID;
+	CSocketReactor *m_Reactor;				// the reactor watching every socket of every game on this worker
+	CTimerWheel *m_Timers;					// the timer wheel holding the next deadline of every game on this worker
+	vector<CBaseGame *> m_Games;			// games running on this worker (only touched by the worker thread)
+	vector<CBaseGame *> m_NewGames;			// games handed over by the main thread but not picked up yet
+	boost::mutex m_Mutex;					// mutex for m_NewGames and the load statistics below
+	boost::thread *m_Thread;
+	bool m_Exiting;							// set to true to stop the worker once all of its games have finished
+	bool m_Woken;							// set to true by Wake to update every game on the next loop
+	uint32_t m_NumGames;					// number of games on this worker (including games not picked up yet)
+	uint32_t m_NumPlayers;					// number of human players in all games on this worker
+	uint32_t m_Load;						// percentage of the last load period the worker spent updating games rather than waiting
+	uint32_t m_BusyTicks;					// ticks spent updating games during the current load period
+	uint32_t m_LoadPeriodTicks;				// GetTicks when the current load period started
+	uint32_t m_PoolAllocations;				// heap allocations made by the games' pools during the current load period (see CGamePool)
+	uint32_t m_PoolAllocationRate;			// heap allocations per second of pooled command packets and actions during the last load period, zero once the pools have warmed up (sent packets aren't pooled or counted)
+
+public:
+	CGameWorker( CGHost *nGHost, uint32_t nID );
+	virtual ~CGameWorker( );
+
+	virtual uint32_t GetID( )				{ return m_ID; }
+	virtual CSocketReactor *GetReactor( )	{ return m_Reactor; }
+	virtual CTimerWheel *GetTimers( )		{ return m_Timers; }
+	virtual uint32_t GetNumGames( );
+	virtual uint32_t GetNumPlayers( );
+	virtual uint32_t GetLoad( );
+	virtual string GetStatus( );
+
+	virtual void AddGame( CBaseGame *game );
+	virtual void Stop( );
+	virtual void Wake( );
+
+protected:
+	virtual void loop( );
+	virtual void UpdateLoad( uint32_t busyTicks, uint32_t poolAllocations );
+};
+
+#endif
@@ -26,11 +26,17 @@
 #include "config.h"
 #include "language.h"
 #include "socket.h"
+#include "reactor.h"
+#include "capture.h"
+#include "commandpacket.h"
 #include "ghostdb.h"
 #include "ghostdbsqlite.h"
 #include "ghostdbmysql.h"
 #include "bnet.h"
 #include "map.h"
+#include "maploader.h"
+#include "mapcatalog.h"
+#include "governor.h"
 #include "packed.h"
 #include "savegame.h"
 #include "gameplayer.h"
@@ -38,6 +44,7 @@
 #include "gpsprotocol.h"
 #include "game_base.h"
 #include "game.h"
+#include "gameworker.h"
 
 #include <signal.h>
 #include <stdlib.h>
@@ -307,6 +314,32 @@ int main( int argc, char **argv )
 
 CGHost :: CGHost( CConfig *CFG )
 {
+	// start capturing before any sockets are created so every connection is captured from the start
+
+	string CaptureFile = CFG->GetString( "bot_capturefile", string( ) );
+	m_Capture = NULL;
+
+	if( !CaptureFile.empty( ) )
+	{
+		m_Capture = new CPacketCapture( CaptureFile );
+		CTCPSocket :: SetCapture( m_Capture );
+	}
+
+	m_ReactorType = CFG->GetString( "bot_reactor", "epoll" );
+	m_Reactor = CSocketReactor :: Create( m_ReactorType );
+	BOOST_LOG_TRIVIAL(info) << "[GHOST] using " + m_Reactor->GetName( ) + " socket reactor";
+	uint32_t NumWorkers = CFG->GetInt( "bot_workers", 0 );
+
+	if( NumWorkers == 0 )
+		NumWorkers = boost::thread :: hardware_concurrency( );
+
+	if( NumWorkers == 0 )
+		NumWorkers = 1;
+
+	for( uint32_t i = 0; i < NumWorkers; ++i )
+		m_Workers.push_back( new CGameWorker( this, i + 1 ) );
+
+	BOOST_LOG_TRIVIAL(info) << "[GHOST] running games on " + UTIL_ToString( NumWorkers ) + " worker threads";
 	m_UDPSocket = new CUDPSocket( );
 	m_UDPSocket->SetBroadcastTarget( CFG->GetString( "udp_broadcasttarget", string( ) ) );
 	m_UDPSocket->SetDontRoute( CFG->GetInt( "udp_dontroute", 0 ) == 0 ? false : true );
@@ -314,7 +347,28 @@ CGHost :: CGHost( CConfig *CFG )
 	m_GPSProtocol = new CGPSProtocol( );
 	m_CRC = new CCRC32( );
 	m_CRC->Initialize( );
+
+	if( m_CRC->GetCLMUL( ) )
+		BOOST_LOG_TRIVIAL(info) << "[GHOST] using carry-less multiply CRC32";
+
 	m_SHA = new CSHA1( );
+
+	if( m_SHA->GetSHANI( ) )
+		BOOST_LOG_TRIVIAL(info) << "[GHOST] using SHA extensions SHA-1";
+
+	string MapCacheFile = CFG->GetString( "bot_mapcachefile", string( ) );
+	m_MapCache = NULL;
+
+	if( !MapCacheFile.empty( ) )
+		m_MapCache = new CMapCache( MapCacheFile );
+
+	m_MapLoader = new CMapLoader( this );
+	m_MapCatalog = new CMapCatalog( ".w3m .w3x" );
+	m_MapCFGCatalog = new CMapCatalog( ".cfg" );
+	m_DownloadGovernor = new CDownloadGovernor( );
+	m_Map = NULL;
+	m_AutoHostNextMap = NULL;
+	m_AutoHostNextMapLoading = false;
 	m_CurrentGame = NULL;
 	string DBType = CFG->GetString( "db_type", "sqlite3" );
 	BOOST_LOG_TRIVIAL(info) << "[GHOST] opening primary database";
@@ -545,6 +599,17 @@ CGHost :: CGHost( CConfig *CFG )
 		LoadMapConfig( m_DefaultMapCfg, NULL, "", false );
 	}
 
+	// the maps are loaded in the background but we need the default map before we can continue
+
+	m_MapLoader->Wait( );
+	CMapLoad *Load;
+
+	while( ( Load = m_MapLoader->GetFinished( ) ) )
+	{
+		EventMapLoaded( Load );
+		delete Load;
+	}
+
 	// if default map couldn't be loaded, use the default wormwar
 	if ( m_Map == NULL )
 	{
@@ -554,6 +619,10 @@ CGHost :: CGHost( CConfig *CFG )
 	m_AutoHostMap = new CMap( *m_Map );
 	m_SaveGame = new CSaveGame( );
 
+	// warm up the maps we'll be hosting soon while the battle.net connections are being established
+
+	LoadWarmMaps( );
+
 	// load the iptocountry data
 
 	LoadIPToCountryData( );
@@ -570,6 +639,23 @@ CGHost :: CGHost( CConfig *CFG )
 
 CGHost :: ~CGHost( )
 {
+	// the games run on the worker threads and use the battle.net connections, the CRC32 and SHA1 objects, the database and so on
+	// so tell every game to finish and wait for the workers to finish (and delete) them before anything else is deleted
+
+	if( m_CurrentGame )
+		m_CurrentGame->doDelete();
+
+	for( vector<CBaseGame *> :: iterator i = m_Games.begin( ); i != m_Games.end( ); ++i )
+		(*i)->doDelete();
+
+	// wait for the workers to finish (and delete) their games
+
+	for( vector<CGameWorker *> :: iterator i = m_Workers.begin( ); i != m_Workers.end( ); ++i )
+		delete *i;
+
+	// stop the map loader next since it uses the map cache and the SHA1 object
+
+	delete m_MapLoader;
 	delete m_UDPSocket;
 	delete m_ReconnectSocket;
 
@@ -583,12 +669,6 @@ CGHost :: ~CGHost( )
 	for( vector<CBNET *> :: iterator i = m_BNETs.begin( ); i != m_BNETs.end( ); ++i )
 		delete *i;
 
-	if( m_CurrentGame )
-		m_CurrentGame->doDelete();
-
-	for( vector<CBaseGame *> :: iterator i = m_Games.begin( ); i != m_Games.end( ); ++i )
-		(*i)->doDelete();
-
 	delete m_DB;
 	delete m_DBLocal;
 
@@ -602,7 +682,18 @@ CGHost :: ~CGHost( )
 	delete m_Language;
 	delete m_Map;
 	delete m_AutoHostMap;
+	delete m_AutoHostNextMap;
+	delete m_MapCatalog;
+	delete m_MapCFGCatalog;
+	delete m_DownloadGovernor;
+	delete m_MapCache;
 	delete m_SaveGame;
+	delete m_Reactor;
+
+	// every socket has been deleted by now
+
+	CTCPSocket :: SetCapture( NULL );
+	delete m_Capture;
 }
 
 bool CGHost :: Update( long usecBlock )
@@ -722,7 +813,10 @@ bool CGHost :: Update( long usecBlock )
 			m_ReconnectSocket = new CTCPServer( );
 
 			if( m_ReconnectSocket->Listen( m_BindAddress, m_ReconnectPort ) )
+			{
 				BOOST_LOG_TRIVIAL(info) << "[GHOST] listening for GProxy++ reconnects on port " + UTIL_ToString( m_ReconnectPort );
+				m_Reactor->Add( m_ReconnectSocket );
+			}
 			else
 			{
 				BOOST_LOG_TRIVIAL(info) << "[GHOST] error listening for GProxy++ reconnects on port " + UTIL_ToString( m_ReconnectPort );
@@ -740,45 +834,7 @@ bool CGHost :: Update( long usecBlock )
 		}
 	}
 
-	unsigned int NumFDs = 0;
-
-	// take every socket we own and throw it in one giant select statement so we can block on all sockets
-
-	int nfds = 0;
-	fd_set fd;
-	fd_set send_fd;
-	FD_ZERO( &fd );
-	FD_ZERO( &send_fd );
-
-	// 1. all battle.net sockets
-
-	for( vector<CBNET *> :: iterator i = m_BNETs.begin( ); i != m_BNETs.end( ); ++i )
-		NumFDs += (*i)->SetFD( &fd, &send_fd, &nfds );
-
-	// 5. the GProxy++ reconnect socket(s)
-
-	if( m_Reconnect && m_ReconnectSocket )
-	{
-		m_ReconnectSocket->SetFD( &fd, &send_fd, &nfds );
-		++NumFDs;
-	}
-
-	for( vector<CTCPSocket *> :: iterator i = m_ReconnectSockets.begin( ); i != m_ReconnectSockets.end( ); ++i )
-	{
-		(*i)->SetFD( &fd, &send_fd, &nfds );
-		++NumFDs;
-	}
-
-	// before we call select we need to determine how long to block for
-	// previously we just blocked for a maximum of the passed usecBlock microseconds
-	// however, in an effort to make game updates happen closer to the desired latency setting we now use a dynamic block interval
-	// note: we still use the passed usecBlock as a hard maximum
-
-	for( vector<CBaseGame *> :: iterator i = m_Games.begin( ); i != m_Games.end( ); ++i )
-	{
-		if( (*i)->GetNextTimedActionTicks( ) * 1000 < usecBlock )
-			usecBlock = (*i)->GetNextTimedActionTicks( ) * 1000;
-	}
+	// the games are updated by their workers (which block until their own timers are due) so we just block for the passed usecBlock microseconds
 
 	// always block for at least 1ms just in case something goes wrong
 	// this prevents the bot from sucking up all the available CPU if a game keeps asking for immediate updates
@@ -788,29 +844,10 @@ bool CGHost :: Update( long usecBlock )
 	if( usecBlock < 1000 )
 		usecBlock = 1000;
 
-	struct timeval tv;
-	tv.tv_sec = 0;
-	tv.tv_usec = usecBlock;
-
-	struct timeval send_tv;
-	send_tv.tv_sec = 0;
-	send_tv.tv_usec = 0;
+	// every socket we own is registered with the reactor so we can block on all of them at once
+	// if we don't have any sockets (i.e. we aren't connected to battle.net maybe due to a lost connection) the reactor just sleeps for the block interval
 
-#ifdef WIN32
-	select( 1, &fd, NULL, NULL, &tv );
-	select( 1, NULL, &send_fd, NULL, &send_tv );
-#else
-	select( nfds + 1, &fd, NULL, NULL, &tv );
-	select( nfds + 1, NULL, &send_fd, NULL, &send_tv );
-#endif
-
-	if( NumFDs == 0 )
-	{
-		// we don't have any sockets (i.e. we aren't connected to battle.net maybe due to a lost connection and there aren't any games running)
-		// select will return immediately and we'll chew up the CPU if we let it loop so just sleep for 50ms to kill some time
-
-		MILLISLEEP( 50 );
-	}
+	m_Reactor->Wait( usecBlock );
 
 	bool AdminExit = false;
 	bool BNETExit = false;
@@ -819,7 +856,7 @@ bool CGHost :: Update( long usecBlock )
 
 	for( vector<CBNET *> :: iterator i = m_BNETs.begin( ); i != m_BNETs.end( ); ++i )
 	{
-		if( (*i)->Update( &fd, &send_fd ) )
+		if( (*i)->Update( ) )
 			BNETExit = true;
 	}
 
@@ -827,10 +864,13 @@ bool CGHost :: Update( long usecBlock )
 
 	if( m_Reconnect && m_ReconnectSocket )
 	{
-		CTCPSocket *NewSocket = m_ReconnectSocket->Accept( &fd );
+		CTCPSocket *NewSocket = m_ReconnectSocket->Accept( );
 
 		if( NewSocket )
+		{
+			m_Reactor->Add( NewSocket );
 			m_ReconnectSockets.push_back( NewSocket );
+		}
 	}
 
 	for( vector<CTCPSocket *> :: iterator i = m_ReconnectSockets.begin( ); i != m_ReconnectSockets.end( ); )
@@ -842,47 +882,59 @@ bool CGHost :: Update( long usecBlock )
 			continue;
 		}
 
-		(*i)->DoRecv( &fd );
-		string *RecvBuffer = (*i)->GetBytes( );
-		BYTEARRAY Bytes = UTIL_CreateByteArray( (unsigned char *)RecvBuffer->c_str( ), RecvBuffer->size( ) );
+		(*i)->DoRecv( );
+		CByteBuffer *RecvBuffer = (*i)->GetBytes( );
+
+		// the reconnect packet is parsed in place in the receive buffer
+
+		CPacketView Packet( RecvBuffer );
 
 		// a packet is at least 4 bytes
 
-		if( Bytes.size( ) >= 4 )
+		if( Packet.GetHeaderComplete( ) )
 		{
-			if( Bytes[0] == GPS_HEADER_CONSTANT )
+			if( Packet.GetHeader( ) == GPS_HEADER_CONSTANT )
 			{
 				// bytes 2 and 3 contain the length of the packet
 
-				uint16_t Length = UTIL_ByteArrayToUInt16( Bytes, false, 2 );
+				uint16_t Length = Packet.GetLength( );
 
-				if( Length >= 4 )
+				if( Packet.GetValidLength( ) )
 				{
-					if( Bytes.size( ) >= Length )
+					if( Packet.GetComplete( ) )
 					{
-						if( Bytes[1] == CGPSProtocol :: GPS_RECONNECT && Length == 13 )
+						if( Packet.GetID( ) == CGPSProtocol :: GPS_RECONNECT && Length == 13 )
 						{
 							GProxyReconnector *Reconnector = new GProxyReconnector;
-							Reconnector->PID = Bytes[4];
-							Reconnector->ReconnectKey = UTIL_ByteArrayToUInt32( Bytes, false, 5 );
-							Reconnector->LastPacket = UTIL_ByteArrayToUInt32( Bytes, false, 9 );
+							Reconnector->PID = Packet.GetByte( 4 );
+							Reconnector->ReconnectKey = Packet.GetUInt32( 5 );
+							Reconnector->LastPacket = Packet.GetUInt32( 9 );
 							Reconnector->PostedTime = GetTicks( );
 							Reconnector->socket = (*i);
 							
 							// update the receive buffer
-							*RecvBuffer = RecvBuffer->substr( Length );
+							RecvBuffer->Consume( Length );
 							i = m_ReconnectSockets.erase( i );
 
+							// the socket is handed over to a game thread which registers it with its own reactor
+							m_Reactor->Remove( Reconnector->socket );
+
 							// post in the reconnects buffer and wait to see if a game thread will pick it up
 							boost::mutex::scoped_lock lock( m_ReconnectMutex );
 							m_PendingReconnects.push_back( Reconnector );
 							lock.unlock();
+
+							// we don't know which game the player is in so wake up every worker, the reconnect is rejected if nobody picks it up within 1.5 seconds
+
+							for( vector<CGameWorker *> :: iterator j = m_Workers.begin( ); j != m_Workers.end( ); ++j )
+								(*j)->Wake( );
+
 							continue;
 						}
 						else
 						{
 							(*i)->PutBytes( m_GPSProtocol->SEND_GPSS_REJECT( REJECTGPS_INVALID ) );
-							(*i)->DoSend( &send_fd );
+							(*i)->DoSend( );
 							delete *i;
 							i = m_ReconnectSockets.erase( i );
 							continue;
@@ -892,7 +944,7 @@ bool CGHost :: Update( long usecBlock )
 				else
 				{
 					(*i)->PutBytes( m_GPSProtocol->SEND_GPSS_REJECT( REJECTGPS_INVALID ) );
-					(*i)->DoSend( &send_fd );
+					(*i)->DoSend( );
 					delete *i;
 					i = m_ReconnectSockets.erase( i );
 					continue;
@@ -901,14 +953,14 @@ bool CGHost :: Update( long usecBlock )
 			else
 			{
 				(*i)->PutBytes( m_GPSProtocol->SEND_GPSS_REJECT( REJECTGPS_INVALID ) );
-				(*i)->DoSend( &send_fd );
+				(*i)->DoSend( );
 				delete *i;
 				i = m_ReconnectSockets.erase( i );
 				continue;
 			}
 		}
 
-		(*i)->DoSend( &send_fd );
+		(*i)->DoSend( );
 		++i;
 	}
 	
@@ -921,7 +973,7 @@ bool CGHost :: Update( long usecBlock )
 			if( GetTicks( ) - (*i)->PostedTime > 1500 )
 			{
 				(*i)->socket->PutBytes( m_GPSProtocol->SEND_GPSS_REJECT( REJECTGPS_NOTFOUND ) );
-				(*i)->socket->DoSend( &send_fd );
+				(*i)->socket->DoSend( );
 				delete (*i)->socket;
 				delete (*i);
 				i = m_PendingReconnects.erase( i );
@@ -934,6 +986,21 @@ bool CGHost :: Update( long usecBlock )
 		lock.unlock();
 	}
 
+	// keep the map catalogs up to date
+
+	m_MapCatalog->Update( );
+	m_MapCFGCatalog->Update( );
+
+	// maps loaded by the map loader
+
+	CMapLoad *Load;
+
+	while( ( Load = m_MapLoader->GetFinished( ) ) )
+	{
+		EventMapLoaded( Load );
+		delete Load;
+	}
+
 	// autohost
 
 	if( !m_AutoHostGameName.empty( ) && m_AutoHostMaximumGames != 0 && m_AutoHostAutoStartPlayers != 0 && GetTime( ) - m_LastAutoHostTime >= 30 )
@@ -945,41 +1012,24 @@ bool CGHost :: Update( long usecBlock )
 		{
 			CMap *mapToHost = m_AutoHostMap;
 
-			// check if we should load a random map for the next game 
+			// check if we should use a random map for the next game
+			// the random map is loaded in the background while the previous game's lobby fills so it's usually ready by now
+			// if it isn't we skip this round and try again soon
+
 			if( m_AutoHostRandomizeMapType != "none" )
 			{
-				BOOST_LOG_TRIVIAL(info) << "[GHOST] Loading random map for next autohosted game"; 
-				 
-				// load random map
-				boost::filesystem::path newMap;
-				if( m_AutoHostRandomizeMapType == "random" )
-				{
-					std::vector<boost::filesystem::path> fileList = GetMapsInDirectory( m_MapPath, "w3" );
-
-					int randomIndex = rand() % fileList.size();
-					LoadMap( fileList[randomIndex].filename( ).string( ), NULL, "", false );
-				}
-				else if( m_AutoHostRandomizeMapType == "list" )
-				{
-					vector<string> mapList;
-					stringstream ss( m_AutoHostRamdomizeMapList );
-					while( ss.good() )
-					{
-						string substr;
-						getline( ss, substr, ',' );
-						mapList.push_back( substr );
-					}
-
-					int randomIndex = rand() % mapList.size();
-					LoadMap( mapList[randomIndex], NULL, "", false );
-				}
+				if( !m_AutoHostNextMap && !m_AutoHostNextMapLoading )
+					LoadAutoHostNextMap( );
 
-				// overwrite autohost map
-				mapToHost = m_Map;
+				mapToHost = m_AutoHostNextMap;
 			}
  
 			// autohost game
-			if( mapToHost->GetValid( ) )
+			if( !mapToHost )
+			{
+				// the next random map is still loading
+			}
+			else if( mapToHost->GetValid( ) )
 			{
 				string GameName = m_AutoHostGameName + " #" + UTIL_ToString( m_HostCounter );
 
@@ -993,13 +1043,13 @@ bool CGHost :: Update( long usecBlock )
 
 						if( m_AutoHostMatchMaking )
 						{
-							if( !m_Map->GetMapMatchMakingCategory( ).empty( ) )
+							if( !mapToHost->GetMapMatchMakingCategory( ).empty( ) )
 							{
-								if( !( m_Map->GetMapOptions( ) & MAPOPT_FIXEDPLAYERSETTINGS ) )
-									BOOST_LOG_TRIVIAL(info) << "[GHOST] autohostmm - map_matchmakingcategory [" + m_Map->GetMapMatchMakingCategory( ) + "] found but matchmaking can only be used with fixed player settings, matchmaking disabled";
+								if( !( mapToHost->GetMapOptions( ) & MAPOPT_FIXEDPLAYERSETTINGS ) )
+									BOOST_LOG_TRIVIAL(info) << "[GHOST] autohostmm - map_matchmakingcategory [" + mapToHost->GetMapMatchMakingCategory( ) + "] found but matchmaking can only be used with fixed player settings, matchmaking disabled";
 								else
 								{
-									BOOST_LOG_TRIVIAL(info) << "[GHOST] autohostmm - map_matchmakingcategory [" + m_Map->GetMapMatchMakingCategory( ) + "] found, matchmaking enabled";
+									BOOST_LOG_TRIVIAL(info) << "[GHOST] autohostmm - map_matchmakingcategory [" + mapToHost->GetMapMatchMakingCategory( ) + "] found, matchmaking enabled";
 
 									m_CurrentGame->SetMatchMaking( true );
 									m_CurrentGame->SetMinimumScore( m_AutoHostMinimumScore );
@@ -1010,6 +1060,15 @@ bool CGHost :: Update( long usecBlock )
 								BOOST_LOG_TRIVIAL(info) << "[GHOST] autohostmm - map_matchmakingcategory not found, matchmaking disabled";
 						}
 					}
+
+					// the game has its own copy of the map so start loading the one after it
+
+					if( mapToHost == m_AutoHostNextMap )
+					{
+						delete m_AutoHostNextMap;
+						m_AutoHostNextMap = NULL;
+						LoadAutoHostNextMap( );
+					}
 				}
 				else
 				{
@@ -1091,6 +1150,7 @@ void CGHost :: EventBNETGameRefreshFailed( CBNET *bnet )
 		boost::mutex::scoped_lock sayLock( m_CurrentGame->m_SayGamesMutex );
 		m_CurrentGame->m_DoSayGames.push_back( m_Language->UnableToCreateGameTryAnotherName( bnet->GetServer( ), m_CurrentGame->GetGameName( ) ) );
 		sayLock.unlock( );
+		m_CurrentGame->Wake( );
 
 		// we take the easy route and simply close the lobby if a refresh fails
 		// it's possible at least one refresh succeeded and therefore the game is still joinable on at least one battle.net (plus on the local network) but we don't keep track of that
@@ -1136,12 +1196,63 @@ void CGHost :: EventGameDeleted( CBaseGame *game )
 	}
 }
 
+void CGHost :: EventMapLoaded( CMapLoad *load )
+{
+	if( load->m_Warm )
+	{
+		// only the map data is kept, CMapData :: Open hands it to any map loaded from the same file later
+
+		if( load->m_Map->GetValid( ) )
+		{
+			CMapData :: Warm( load->m_Map->GetMapData( ) );
+			BOOST_LOG_TRIVIAL(info) << "[GHOST] map [" + load->m_Map->GetMapLocalPath( ) + "] is warm";
+		}
+		else
+			BOOST_LOG_TRIVIAL(warning) << "[GHOST] map [" + load->m_CFGFile + "] from bot_warmmaps is invalid";
+
+		return;
+	}
+
+	if( load->m_AutoHost )
+	{
+		m_AutoHostNextMapLoading = false;
+
+		if( load->m_Map->GetValid( ) )
+		{
+			delete m_AutoHostNextMap;
+			m_AutoHostNextMap = load->m_Map;
+			load->m_Map = NULL;
+		}
+		else
+			BOOST_LOG_TRIVIAL(info) << "[GHOST] next autohost map [" + load->m_Map->GetMapPath( ) + "] is invalid";
+
+		return;
+	}
+
+	delete m_Map;
+	m_Map = load->m_Map;
+	load->m_Map = NULL;
+
+	if( load->m_BNET && !load->m_User.empty( ) )
+	{
+		if( m_Map->GetValid( ) )
+			load->m_BNET->QueueChatCommand( m_Language->MapLoaded( load->m_CFGFile ), load->m_User, load->m_Whisper );
+		else
+			load->m_BNET->QueueChatCommand( m_Language->MapLoadedInvalid( load->m_CFGFile ), load->m_User, load->m_Whisper );
+	}
+}
+
 void CGHost :: ReloadConfigs( )
 {
 	CConfig CFG;
 	CFG.Read( "default.cfg" );
 	CFG.Read( gCFGFile );
 	SetConfigs( &CFG );
+
+	// warm up the maps again in case bot_warmmaps or the map files changed
+	// maps which are still warm and unchanged are found already open so this is cheap
+
+	LoadWarmMaps( );
 }
 
 void CGHost :: SetConfigs( CConfig *CFG )
@@ -1165,6 +1276,9 @@ void CGHost :: SetConfigs( CConfig *CFG )
 	m_MapCFGPath = UTIL_AddPathSeperator( CFG->GetString( "bot_mapcfgpath", string( ) ) );
 	m_SaveGamePath = UTIL_AddPathSeperator( CFG->GetString( "bot_savegamepath", string( ) ) );
 	m_MapPath = UTIL_AddPathSeperator( CFG->GetString( "bot_mappath", string( ) ) );
+	m_MapCatalog->SetPath( m_MapPath );
+	m_MapCFGCatalog->SetPath( m_MapCFGPath );
+	m_WarmMaps = CFG->GetString( "bot_warmmaps", string( ) );
 	m_SaveReplays = CFG->GetInt( "bot_savereplays", 0 ) == 0 ? false : true;
 	m_ReplayPath = UTIL_AddPathSeperator( CFG->GetString( "bot_replaypath", string( ) ) );
 	m_VirtualHostName = CFG->GetString( "bot_virtualhostname", "|cFF4080C0GHost" );
@@ -1187,6 +1301,9 @@ void CGHost :: SetConfigs( CConfig *CFG )
 	m_PingDuringDownloads = CFG->GetInt( "bot_pingduringdownloads", 0 ) == 0 ? false : true;
 	m_MaxDownloaders = CFG->GetInt( "bot_maxdownloaders", 3 );
 	m_MaxDownloadSpeed = CFG->GetInt( "bot_maxdownloadspeed", 100 );
+	m_UplinkSpeed = CFG->GetInt( "bot_uplinkspeed", 0 );
+	m_GameReserve = CFG->GetInt( "bot_gamereserve", 25 );
+	m_DownloadGovernor->SetLimits( m_MaxDownloadSpeed * 1024, m_UplinkSpeed * 1024, m_GameReserve );
 	m_LCPings = CFG->GetInt( "bot_lcpings", 1 ) == 0 ? false : true;
 	m_AutoKickPing = CFG->GetInt( "bot_autokickping", 400 );
 	m_VoteStartAllowed = CFG->GetInt( "bot_votestartallowed", 1 ) == 0 ? false : true;
@@ -1196,6 +1313,9 @@ void CGHost :: SetConfigs( CConfig *CFG )
 	m_IPBlackListFile = CFG->GetString( "bot_ipblacklistfile", "ipblacklist.txt" );
 	m_LobbyTimeLimit = CFG->GetInt( "bot_lobbytimelimit", 10 );
 	m_Latency = CFG->GetInt( "bot_latency", 100 );
+	m_AutoLatency = CFG->GetInt( "bot_autolatency", 0 ) == 0 ? false : true;
+	m_AutoLatencyMin = CFG->GetInt( "bot_autolatencymin", 50 );
+	m_AutoLatencyMax = CFG->GetInt( "bot_autolatencymax", 200 );
 	m_SyncLimit = CFG->GetInt( "bot_synclimit", 50 );
 	m_VoteKickAllowed = CFG->GetInt( "bot_votekickallowed", 1 ) == 0 ? false : true;
 	m_VoteKickPercentage = CFG->GetInt( "bot_votekickpercentage", 100 );
@@ -1309,6 +1429,19 @@ void CGHost :: CreateGame( CMap *map, unsigned char gameState, bool saveGame, st
 		return;
 	}
 
+	// a map requested with !map or !load replaces m_Map only once it has been loaded, until then m_Map is still the previous map
+
+	if( map == m_Map && m_MapLoader->GetNumPendingMaps( ) > 0 )
+	{
+		for( vector<CBNET *> :: iterator i = m_BNETs.begin( ); i != m_BNETs.end( ); ++i )
+		{
+			if( (*i)->GetServer( ) == creatorServer )
+				(*i)->QueueChatCommand( m_Language->UnableToCreateGameMapLoading( gameName ), creatorName, whisper );
+		}
+
+		return;
+	}
+
 	if( !map->GetValid( ) )
 	{
 		for( vector<CBNET *> :: iterator i = m_BNETs.begin( ); i != m_BNETs.end( ); ++i )
@@ -1455,74 +1588,71 @@ void CGHost :: CreateGame( CMap *map, unsigned char gameState, bool saveGame, st
 			(*i)->HoldClan( m_CurrentGame );
 	}
 	
-	// start the game thread
-	boost::thread(&CBaseGame::loop, m_CurrentGame);
-	BOOST_LOG_TRIVIAL(info) << "[GameThread] Made new game thread";
+	// hand the game to the least loaded worker
+
+	CGameWorker *Worker = NULL;
+
+	for( vector<CGameWorker *> :: iterator i = m_Workers.begin( ); i != m_Workers.end( ); ++i )
+	{
+		if( !Worker || (*i)->GetNumGames( ) < Worker->GetNumGames( ) || ( (*i)->GetNumGames( ) == Worker->GetNumGames( ) && (*i)->GetLoad( ) < Worker->GetLoad( ) ) )
+			Worker = *i;
+	}
+
+	Worker->AddGame( m_CurrentGame );
+	BOOST_LOG_TRIVIAL(info) << "[GHOST] game [" + gameName + "] assigned to worker #" + UTIL_ToString( Worker->GetID( ) );
 }
 
 //
 // Load a map
 //
-void CGHost :: LoadMap( string MapName, CBNET *bnet, string User, bool Whisper )
+void CGHost :: LoadMap( string MapName, CBNET *bnet, string User, bool Whisper, bool AutoHost )
 {
 	string realmName = bnet == NULL ? "SYSTEM" : "BNET: " + bnet->GetServerAlias( );
 	BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] trying to load map  [" + MapName + "] ...";
 
-	try
+	if( !m_MapCatalog->GetExists( ) )
 	{
-		string Pattern = MapName;
-		transform( Pattern.begin( ), Pattern.end( ), Pattern.begin( ), (int(*)(int))tolower );
+		BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] error listing maps - map path doesn't exist";
 
-		if( !boost::filesystem::exists( m_MapPath ) )
-		{
-			BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] error listing maps - map path doesn't exist";
+		if ( !User.empty() )
+			bnet->QueueChatCommand( m_Language->ErrorListingMaps( ), User, Whisper );
+	}
+	else
+	{
+		vector<string> fileList = FindExactMatch( m_MapCatalog->Find( MapName ), MapName );
 
+		if( fileList.size() == 0 )
+		{
+			BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] " + m_Language->NoMapsFound( );
 			if ( !User.empty() )
-				bnet->QueueChatCommand( m_Language->ErrorListingMaps( ), User, Whisper );
+				bnet->QueueChatCommand( m_Language->NoMapsFound( ), User, Whisper );
 		}
-		else
+		else if( fileList.size() == 1 )
 		{
-			string Pattern = MapName;
-			transform( Pattern.begin( ), Pattern.end( ), Pattern.begin( ), (int(*)(int))tolower );
-			std::vector<boost::filesystem::path> fileList = GetMapsInDirectory( m_MapPath, Pattern );
+			string File = fileList.front( );
+			
+			BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] " + m_Language->LoadingConfigFile( m_MapPath + File );
+			if ( !User.empty() )
+				bnet->QueueChatCommand( m_Language->LoadingConfigFile( m_MapPath + File ), User, Whisper );
 
-			if( fileList.size() == 0 )
-			{
-				BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] " + m_Language->NoMapsFound( );
-				if ( !User.empty() )
-					bnet->QueueChatCommand( m_Language->NoMapsFound( ), User, Whisper );
-			}
-			else if( fileList.size() == 1 )
-			{
-				string File = fileList.front( ).filename( ).string( );
-				
-				BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] " + m_Language->LoadingConfigFile( m_MapPath + File );
-				if ( !User.empty() )
-					bnet->QueueChatCommand( m_Language->LoadingConfigFile( m_MapPath + File ), User, Whisper );
-
-				// create a config file in memory with the required information to load the map
-
-				CConfig MapCFG;
-				MapCFG.Set( "map_path", "Maps\\Download\\" + File );
-				MapCFG.Set( "map_localpath", File );
-				m_Map = new CMap( this, &MapCFG, fileList.front( ).string( ) );
-			}
-			else
-			{
-				/*
-				BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] " + m_Language->FoundMaps( boost::algorithm::join(fileList, ",") );
-				if ( !User.empty() )
-					bnet->QueueChatCommand( m_Language->FoundMaps( boost::algorithm::join(fileList, ",") ), User, Whisper );
-				*/
-			}
-		}
-	}
-	catch( const exception &ex )
-	{
-		BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] error listing maps - caught exception [" + ex.what( ) + "]";
+			// create a config file in memory with the required information to load the map
 
-		if ( !User.empty() )
-			bnet->QueueChatCommand( m_Language->ErrorListingMaps( ), User, Whisper );
+			CConfig MapCFG;
+			MapCFG.Set( "map_path", "Maps\\Download\\" + File );
+			MapCFG.Set( "map_localpath", File );
+			m_MapLoader->Load( new CMapLoad( MapCFG, m_MapPath + File, bnet, User, Whisper, AutoHost ) );
+
+			if( AutoHost )
+				m_AutoHostNextMapLoading = true;
+		}
+		else
+		{
+			/*
+			BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] " + m_Language->FoundMaps( boost::algorithm::join(fileList, ",") );
+			if ( !User.empty() )
+				bnet->QueueChatCommand( m_Language->FoundMaps( boost::algorithm::join(fileList, ",") ), User, Whisper );
+			*/
+		}
 	}
 }
 
@@ -1534,130 +1664,131 @@ void CGHost :: LoadMapConfig( string MapConfigName, CBNET *bnet, string User, bo
 	string realmName = bnet == NULL ? "SYSTEM" : "BNET: " + bnet->GetServerAlias( );
 	BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] trying to load map config  [" + MapConfigName + "] ...";
 
-	try
+	if( !m_MapCFGCatalog->GetExists( ) )
 	{
-		if( !boost::filesystem::exists( m_MapCFGPath ) )
-		{
-			BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] error listing map configs - map config path doesn't exist";
+		BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] error listing map configs - map config path doesn't exist";
+
+		if ( !User.empty() )
+			bnet->QueueChatCommand( m_Language->ErrorListingMapConfigs( ), User, Whisper );
+	}
+	else
+	{
+		vector<string> fileList = FindExactMatch( m_MapCFGCatalog->Find( MapConfigName ), MapConfigName );
 
+		if( fileList.size() == 0 )
+		{
+			BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] " + m_Language->NoMapConfigsFound( );
 			if ( !User.empty() )
-				bnet->QueueChatCommand( m_Language->ErrorListingMapConfigs( ), User, Whisper );
+				bnet->QueueChatCommand( m_Language->NoMapConfigsFound( ), User, Whisper );
 		}
-		else
+		else if( fileList.size() == 1 )
 		{
-			string Pattern = MapConfigName;
-			transform( Pattern.begin( ), Pattern.end( ), Pattern.begin( ), (int(*)(int))tolower );
-			std::vector<boost::filesystem::path> fileList = GetMapConfigsInDirectory( m_MapCFGPath, Pattern );
+			string File = fileList.front( );
+			
+			BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] " + m_Language->LoadingConfigFile( m_MapCFGPath + File );
+			if ( !User.empty() )
+				bnet->QueueChatCommand( m_Language->LoadingConfigFile( m_MapCFGPath + File ), User, Whisper );
 
-			if( fileList.size() == 0 )
-			{
-				BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] " + m_Language->NoMapConfigsFound( );
-				if ( !User.empty() )
-					bnet->QueueChatCommand( m_Language->NoMapConfigsFound( ), User, Whisper );
-			}
-			else if( fileList.size() == 1 )
-			{
-				string File = fileList.front( ).filename( ).string( );
-				
-				BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] " + m_Language->LoadingConfigFile( m_MapCFGPath + File );
-				if ( !User.empty() )
-					bnet->QueueChatCommand( m_Language->LoadingConfigFile( m_MapCFGPath + File ), User, Whisper );
-
-				CConfig MapCFG;
-				MapCFG.Read( fileList.front( ).string( ) );
-				m_Map = new CMap( this, &MapCFG, m_MapCFGPath + File );
-			}
-			else
-			{
-				/*
-				BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] " + m_Language->FoundMapConfigs( boost::algorithm::join(fileList, ",") );
-				if ( !User.empty() )
-					bnet->QueueChatCommand( m_Language->FoundMapConfigs( boost::algorithm::join(fileList, ",") ), User, Whisper );
-				*/
-			}
+			CConfig MapCFG;
+			MapCFG.Read( m_MapCFGPath + File );
+			m_MapLoader->Load( new CMapLoad( MapCFG, m_MapCFGPath + File, bnet, User, Whisper, false ) );
+		}
+		else
+		{
+			/*
+			BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] " + m_Language->FoundMapConfigs( boost::algorithm::join(fileList, ",") );
+			if ( !User.empty() )
+				bnet->QueueChatCommand( m_Language->FoundMapConfigs( boost::algorithm::join(fileList, ",") ), User, Whisper );
+			*/
 		}
-	}
-	catch( const exception &ex )
-	{
-		BOOST_LOG_TRIVIAL(info) << "[" + realmName + "] error listing map configs - caught exception [" + ex.what( ) + "]";
-
-		if ( !User.empty() )
-			bnet->QueueChatCommand( m_Language->ErrorListingMapConfigs( ), User, Whisper );
 	}
 }
 
 //
-// Get Files in Directory
+// Load a random map for the next autohosted game in the background
 //
-std::vector<boost::filesystem::path> CGHost :: GetFilesInDirectory( boost::filesystem::path ParentDirectory, string Pattern )
+void CGHost :: LoadAutoHostNextMap( )
 {
-	std::vector<boost::filesystem::path> fileList;
+	BOOST_LOG_TRIVIAL(info) << "[GHOST] Loading random map for next autohosted game";
 
-	try
+	if( m_AutoHostRandomizeMapType == "random" )
 	{
-		transform( Pattern.begin( ), Pattern.end( ), Pattern.begin( ), (int(*)(int))tolower );
+		string File = m_MapCatalog->GetRandom( );
 
-		if( !exists( ParentDirectory ) )
+		if( !File.empty( ) )
+			LoadMap( File, NULL, "", false, true );
+	}
+	else if( m_AutoHostRandomizeMapType == "list" )
+	{
+		vector<string> mapList;
+		stringstream ss( m_AutoHostRamdomizeMapList );
+		while( ss.good() )
 		{
-			BOOST_LOG_TRIVIAL(info) << "[SYSTEM] error listing map configs - map config path doesn't exist";
+			string substr;
+			getline( ss, substr, ',' );
+			mapList.push_back( substr );
 		}
-		else
-		{
-			boost::filesystem::directory_iterator EndIterator;
-			for( boost::filesystem::directory_iterator i( ParentDirectory ); i != EndIterator; ++i )
-			{
-				string FileName = i->path( ).filename( ).string( );
-				transform( FileName.begin( ), FileName.end( ), FileName.begin( ), (int(*)(int))tolower );
 
-				if( !boost::filesystem::is_directory( i->status( ) ) && FileName.find( Pattern ) != string :: npos )
-				{
-					fileList.push_back( i->path( ) );
-				}
-			}
-		}
-	}
-	catch( const exception &ex )
-	{
-		BOOST_LOG_TRIVIAL(info) << "[SYSTEM] error listing directories in folder [" + ParentDirectory.string( ) + "]";
+		int randomIndex = rand() % mapList.size();
+		LoadMap( mapList[randomIndex], NULL, "", false, true );
 	}
-
-	return fileList;
 }
 
 //
-// Get all maps within a directory that match the filename 
+// Load the maps listed in bot_warmmaps in the background and keep their data open
+// the first games after a restart would otherwise have to read and hash each map file (and calculate the CRC of every map part) while the lobby is waiting
 //
-std::vector<boost::filesystem::path> CGHost :: GetMapsInDirectory( boost::filesystem::path ParentDirectory, string Filename )
+void CGHost :: LoadWarmMaps( )
 {
-	std::vector<boost::filesystem::path> resultList;
-	std::vector<boost::filesystem::path> fileList = GetFilesInDirectory( ParentDirectory, Filename );
+	stringstream ss( m_WarmMaps );
+	set<string> Files;
 
-	for (std::vector<boost::filesystem::path>::const_iterator i = fileList.begin(), end = fileList.end(); i != end; ++i)
+	while( ss.good( ) )
 	{
-		if ( (*i).extension() == ".w3m" || (*i).extension() == ".w3x" )
+		string MapName;
+		getline( ss, MapName, ',' );
+		string :: size_type Start = MapName.find_first_not_of( " " );
+
+		if( Start == string :: npos )
+			continue;
+
+		MapName = MapName.substr( Start, MapName.find_last_not_of( " " ) - Start + 1 );
+		vector<string> fileList = FindExactMatch( m_MapCatalog->Find( MapName ), MapName );
+
+		if( fileList.size( ) != 1 )
 		{
-			resultList.push_back((*i));
+			BOOST_LOG_TRIVIAL(warning) << "[GHOST] can't warm map [" + MapName + "], " + UTIL_ToString( fileList.size( ) ) + " maps match";
+			continue;
 		}
+
+		CConfig MapCFG;
+		MapCFG.Set( "map_path", "Maps\\Download\\" + fileList.front( ) );
+		MapCFG.Set( "map_localpath", fileList.front( ) );
+		m_MapLoader->Load( new CMapLoad( MapCFG, m_MapPath + fileList.front( ), NULL, string( ), false, false, true ) );
+		Files.insert( m_MapPath + fileList.front( ) );
 	}
 
-	return resultList;
+	// let go of the maps which were removed from bot_warmmaps
+
+	CMapData :: KeepWarm( Files );
 }
 
 //
-// Get all map configs within a directory that match the filename 
+// If one of the files matching a pattern is named exactly like the pattern (ignoring case) use that one
+// otherwise a map whose name is part of another map's name could never be loaded
 //
-std::vector<boost::filesystem::path> CGHost :: GetMapConfigsInDirectory( boost::filesystem::path ParentDirectory, string Filename )
+vector<string> CGHost :: FindExactMatch( vector<string> fileList, string Pattern )
 {
-	std::vector<boost::filesystem::path> resultList;
-	std::vector<boost::filesystem::path> fileList = GetFilesInDirectory( ParentDirectory, Filename );
+	transform( Pattern.begin( ), Pattern.end( ), Pattern.begin( ), (int(*)(int))tolower );
 
-	for (std::vector<boost::filesystem::path>::const_iterator i = fileList.begin(), end = fileList.end(); i != end; ++i)
+	for( vector<string> :: iterator i = fileList.begin( ); i != fileList.end( ); ++i )
 	{
-		if ( (*i).extension() == ".cfg" )
-		{
-			resultList.push_back((*i));
-		}
+		string File = *i;
+		transform( File.begin( ), File.end( ), File.begin( ), (int(*)(int))tolower );
+
+		if( File == Pattern )
+			return vector<string>( 1, *i );
 	}
 
-	return resultList;
+	return fileList;
 }
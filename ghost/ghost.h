@@ -31,16 +31,25 @@
 class CUDPSocket;
 class CTCPServer;
 class CTCPSocket;
+class CSocketReactor;
+class CPacketCapture;
 class CGPSProtocol;
 class CCRC32;
 class CSHA1;
 class CBNET;
 class CBaseGame;
+class CGameWorker;
 class CAdminGame;
 class CGHostDB;
 class CBaseCallable;
 class CLanguage;
 class CMap;
+class CMapCache;
+class CMapData;
+class CMapLoad;
+class CMapLoader;
+class CMapCatalog;
+class CDownloadGovernor;
 class CSaveGame;
 class CConfig;
 
@@ -58,13 +67,20 @@ public:
 	CUDPSocket *m_UDPSocket;				// a UDP socket for sending broadcasts and other junk (used with !sendlan)
 	CTCPServer *m_ReconnectSocket;			// listening socket for GProxy++ reliable reconnects
 	vector<CTCPSocket *> m_ReconnectSockets;// vector of sockets attempting to reconnect (connected but not identified yet)
+	CSocketReactor *m_Reactor;				// the reactor watching the battle.net and GProxy++ reconnect sockets
+	CPacketCapture *m_Capture;				// the packet capture, NULL when capturing is disabled
 	CGPSProtocol *m_GPSProtocol;
 	CCRC32 *m_CRC;							// for calculating CRC's
 	CSHA1 *m_SHA;							// for calculating SHA1's
+	CMapCache *m_MapCache;					// the map cache, NULL when map caching is disabled
+	CMapLoader *m_MapLoader;				// loads maps in the background
+	CMapCatalog *m_MapCatalog;				// the maps in m_MapPath
+	CMapCatalog *m_MapCFGCatalog;			// the map configs in m_MapCFGPath
+	CDownloadGovernor *m_DownloadGovernor;	// limits the combined map download speed of all games
 	vector<CBNET *> m_BNETs;				// all our battle.net connections (there can be more than one)
 	CBaseGame *m_CurrentGame;				// this game is still in the lobby state
 	vector<CBaseGame *> m_Games;			// these games are in progress
-	boost::thread_group m_GameThreads;		// the threads for games in progress and stuff
+	vector<CGameWorker *> m_Workers;		// the threads running the games, each game is assigned to one of them
 	boost::mutex m_GamesMutex;
 	CGHostDB *m_DB;							// database
 	CGHostDB *m_DBLocal;					// local database (for temporary data)
@@ -74,6 +90,8 @@ public:
 	CLanguage *m_Language;					// language
 	CMap *m_Map;							// the currently loaded map
 	CMap *m_AutoHostMap;					// the map to use when autohosting
+	CMap *m_AutoHostNextMap;				// the randomly chosen map to use for the next autohosted game (loaded in the background while the current lobby fills)
+	bool m_AutoHostNextMapLoading;			// true while the next autohost map is being loaded
 	CSaveGame *m_SaveGame;					// the save game to use
 	vector<PIDPlayer> m_EnforcePlayers;		// vector of pids to force players to use in the next game (used with saved games)
 	bool m_Exiting;							// set to true to force ghost to shutdown next update (used by SignalCatcher)
@@ -122,12 +140,17 @@ public:
 	bool m_PingDuringDownloads;				// config value: ping during map downloads or not
 	uint32_t m_MaxDownloaders;				// config value: maximum number of map downloaders at the same time
 	uint32_t m_MaxDownloadSpeed;			// config value: maximum total map download speed in KB/sec
+	uint32_t m_UplinkSpeed;					// config value: the uplink speed in KB/sec (0 = unknown)
+	uint32_t m_GameReserve;					// config value: the percentage of the uplink reserved for in-game traffic
 	bool m_LCPings;							// config value: use LC style pings (divide actual pings by two)
 	uint32_t m_AutoKickPing;				// config value: auto kick players with ping higher than this
 	uint32_t m_BanMethod;					// config value: ban method (ban by name/ip/both)
 	string m_IPBlackListFile;				// config value: IP blacklist file (ipblacklist.txt)
 	uint32_t m_LobbyTimeLimit;				// config value: auto close the game lobby after this many minutes without any reserved players
 	uint32_t m_Latency;						// config value: the latency (by default)
+	bool m_AutoLatency;						// config value: adjust the latency automatically while the game is running (by default)
+	uint32_t m_AutoLatencyMin;				// config value: the lowest latency to use when adjusting it automatically
+	uint32_t m_AutoLatencyMax;				// config value: the highest latency to use when adjusting it automatically
 	uint32_t m_SyncLimit;					// config value: the maximum number of packets a player can fall out of sync before starting the lag screen (by default)
 	bool m_VoteKickAllowed;					// config value: if votekicks are allowed or not
 	uint32_t m_VoteKickPercentage;			// config value: percentage of players required to vote yes for a votekick to pass
@@ -136,6 +159,7 @@ public:
 	uint32_t m_VoteStartPercentage;			// config value: percentage of players required to votestart to begin a game
 	string m_DefaultMap;					// config value: default map name
 	string m_DefaultMapCfg;					// config value: default map cfg (map.cfg)
+	string m_WarmMaps;						// config value: maps to load in the background at startup and on !reload (comma separated)
 	string m_MOTDFile;						// config value: motd.txt
 	string m_GameLoadedFile;				// config value: gameloaded.txt
 	string m_GameOverFile;					// config value: gameover.txt
@@ -143,6 +167,7 @@ public:
 	uint32_t m_ReplayWar3Version;			// config value: replay warcraft 3 version (for saving replays)
 	uint32_t m_ReplayBuildNumber;			// config value: replay build number (for saving replays)
 	bool m_TCPNoDelay;						// config value: use Nagle's algorithm or not
+	string m_ReactorType;					// config value: the socket reactor to use (epoll/select)
 	uint32_t m_MatchMakingMethod;			// config value: the matchmaking method
 	uint32_t m_MapGameType;					// config value: the MapGameType overwrite (aka: refresh hack)
 	vector<GProxyReconnector *> m_PendingReconnects;
@@ -168,6 +193,7 @@ public:
 	void EventBNETChat( CBNET *bnet, string user, string message );
 	void EventBNETEmote( CBNET *bnet, string user, string message );
 	void EventGameDeleted( CBaseGame *game );
+	void EventMapLoaded( CMapLoad *load );
 
 	// other functions
 
@@ -175,11 +201,11 @@ public:
 	void SetConfigs( CConfig *CFG );
 	void LoadIPToCountryData( );
 	void CreateGame( CMap *map, unsigned char gameState, bool saveGame, string gameName, string ownerName, string creatorName, string creatorServer, bool whisper );
-	void LoadMap( string MapName, CBNET *bnet, string User, bool Whisper );
+	void LoadMap( string MapName, CBNET *bnet, string User, bool Whisper, bool AutoHost = false );
 	void LoadMapConfig( string MapName, CBNET *bnet, string User, bool Whisper );
-	std::vector<boost::filesystem::path> GetFilesInDirectory( boost::filesystem::path ParentDirectory, string Pattern );
-	std::vector<boost::filesystem::path> GetMapsInDirectory( boost::filesystem::path ParentDirectory, string Filename );
-	std::vector<boost::filesystem::path> GetMapConfigsInDirectory( boost::filesystem::path ParentDirectory, string Filename );
+	void LoadAutoHostNextMap( );
+	void LoadWarmMaps( );
+	vector<string> FindExactMatch( vector<string> fileList, string Pattern );
 };
 
 #endif
@@ -0,0 +1,172 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#include "ghost.h"
+#include "util.h"
+#include "gameslot.h"
+#include "map.h"
+#include "governor.h"
+
+//
+// CDownloadGovernor
+//
+
+CDownloadGovernor :: CDownloadGovernor( ) : m_MaxDownloadSpeed( 0 ), m_UplinkSpeed( 0 ), m_GameReserve( 0 ), m_Tokens( 0 ), m_LastRefillTicks( GetTicks( ) ), m_DownloadBytes( 0 ), m_GameBytes( 0 ), m_DownloadRate( 0 ), m_GameRate( 0 ), m_LastRateTicks( GetTicks( ) )
+{
+
+}
+
+CDownloadGovernor :: ~CDownloadGovernor( )
+{
+
+}
+
+void CDownloadGovernor :: SetLimits( uint32_t nMaxDownloadSpeed, uint32_t nUplinkSpeed, uint32_t nGameReserve )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+	m_MaxDownloadSpeed = nMaxDownloadSpeed;
+	m_UplinkSpeed = nUplinkSpeed;
+	m_GameReserve = min( nGameReserve, (uint32_t)100 );
+}
+
+void CDownloadGovernor :: UpdateRates( )
+{
+	// the mutex must be held
+
+	uint32_t Ticks = GetTicks( );
+	uint32_t Elapsed = Ticks - m_LastRateTicks;
+
+	if( Elapsed >= 1000 )
+	{
+		m_DownloadRate = (uint32_t)( (uint64_t)m_DownloadBytes * 1000 / Elapsed );
+		m_GameRate = (uint32_t)( (uint64_t)m_GameBytes.exchange( 0 ) * 1000 / Elapsed );
+		m_DownloadBytes = 0;
+		m_LastRateTicks = Ticks;
+	}
+}
+
+uint32_t CDownloadGovernor :: GetLimit( )
+{
+	// the mutex must be held
+	// returns the current download limit in bytes/sec, 0 means unlimited
+
+	uint32_t Limit = m_MaxDownloadSpeed;
+
+	if( m_UplinkSpeed > 0 )
+	{
+		// the downloads get whatever the in-game traffic leaves of the uplink, but the in-game traffic is always assumed to need at least its reserved share
+		// never stop the downloads completely though, they can always send at least one map part every 100 ms
+
+		uint32_t Game = max( m_GameRate, (uint32_t)( (uint64_t)m_UplinkSpeed * m_GameReserve / 100 ) );
+		uint32_t Free = Game < m_UplinkSpeed ? m_UplinkSpeed - Game : 0;
+		Free = max( Free, (uint32_t)MAPPART_SIZE * 10 );
+
+		if( Limit == 0 || Free < Limit )
+			Limit = Free;
+	}
+
+	return Limit;
+}
+
+int32_t CDownloadGovernor :: Request( CBaseGame *game, uint32_t bytes )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+	UpdateRates( );
+	uint32_t Ticks = GetTicks( );
+	uint32_t Limit = GetLimit( );
+	CDemand Demand;
+	Demand.m_Bytes = bytes;
+	Demand.m_Ticks = Ticks;
+	m_Demands[game] = Demand;
+
+	if( Limit == 0 )
+	{
+		m_DownloadBytes += bytes;
+		return bytes;
+	}
+
+	// refill the bucket, it holds at most 200 ms worth of data so an idle period doesn't turn into a burst
+
+	m_Tokens += (int64_t)Limit * ( Ticks - m_LastRefillTicks ) / 1000;
+	m_Tokens = min( m_Tokens, (int64_t)Limit / 5 );
+	m_LastRefillTicks = Ticks;
+
+	if( m_Tokens <= 0 || bytes == 0 )
+		return 0;
+
+	// split the bucket between the games which asked for data recently in proportion to how much they asked for
+	// the other games' shares stay in the bucket for when they ask next
+
+	uint64_t TotalBytes = 0;
+
+	for( map<CBaseGame *, CDemand> :: iterator i = m_Demands.begin( ); i != m_Demands.end( ); )
+	{
+		if( Ticks - i->second.m_Ticks > 1000 )
+			m_Demands.erase( i++ );
+		else
+		{
+			TotalBytes += i->second.m_Bytes;
+			++i;
+		}
+	}
+
+	// always hand out at least one map part (if there's enough in the bucket) so a game asking for a little isn't starved by rounding
+
+	int64_t Granted = m_Tokens * bytes / TotalBytes;
+	Granted = max( Granted, min( m_Tokens, (int64_t)MAPPART_SIZE ) );
+	Granted = min( Granted, (int64_t)bytes );
+	m_Tokens -= Granted;
+	m_DownloadBytes += Granted;
+	return (int32_t)Granted;
+}
+
+void CDownloadGovernor :: Return( int32_t bytes )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+	m_Tokens += bytes;
+
+	if( bytes > 0 && (uint32_t)bytes > m_DownloadBytes )
+		m_DownloadBytes = 0;
+	else
+		m_DownloadBytes -= bytes;
+}
+
+void CDownloadGovernor :: Remove( CBaseGame *game )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+	m_Demands.erase( game );
+}
+
+string CDownloadGovernor :: GetStatus( )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+	UpdateRates( );
+	uint32_t Limit = GetLimit( );
+	uint32_t Ticks = GetTicks( );
+	uint32_t Games = 0;
+
+	for( map<CBaseGame *, CDemand> :: iterator i = m_Demands.begin( ); i != m_Demands.end( ); ++i )
+	{
+		if( Ticks - i->second.m_Ticks <= 1000 )
+			++Games;
+	}
+
+	return "map downloads " + UTIL_ToString( m_DownloadRate / 1024 ) + " KB/sec (limit " + ( Limit == 0 ? string( "unlimited" ) : UTIL_ToString( Limit / 1024 ) + " KB/sec" ) + ") in " + UTIL_ToString( Games ) + " games, in-game traffic " + UTIL_ToString( m_GameRate / 1024 ) + " KB/sec";
+}
@@ -0,0 +1,78 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+class CBaseGame;
+
+//
+// CDownloadGovernor
+//
+
+// limits the combined map download speed of every game on the bot (bot_maxdownloadspeed) so several lobbies with downloaders can't saturate the uplink together
+// it's a token bucket shared by all the game worker threads, every map download cycle a game asks for as many bytes as its downloaders can take and gets its share of the bucket
+// when several games are downloading the bucket is split in proportion to what each of them asked for so a game with more downloaders gets more
+// if the uplink speed is known (bot_uplinkspeed) the in-game traffic of every game is measured and map downloads only get what's left of the uplink after it
+// a share of the uplink (bot_gamereserve) is always kept free for in-game traffic so a game which gets busier doesn't have to wait for the downloads to back off
+
+class CDownloadGovernor
+{
+private:
+	struct CDemand
+	{
+		uint32_t m_Bytes;					// the number of bytes the game asked for in its last request
+		uint32_t m_Ticks;					// GetTicks when the game last asked
+	};
+
+	boost::mutex m_Mutex;					// mutex for everything below except m_GameBytes
+	uint32_t m_MaxDownloadSpeed;			// config value: maximum combined download speed in bytes/sec (0 = unlimited)
+	uint32_t m_UplinkSpeed;					// config value: the uplink speed in bytes/sec (0 = unknown)
+	uint32_t m_GameReserve;					// config value: the percentage of the uplink reserved for in-game traffic
+	int64_t m_Tokens;						// bytes available to send right now, can go negative when a game sends a little more than it was given
+	uint32_t m_LastRefillTicks;
+	map<CBaseGame *, CDemand> m_Demands;
+	uint32_t m_DownloadBytes;				// map bytes sent since m_LastRateTicks
+	boost::atomic<uint32_t> m_GameBytes;	// in-game bytes sent since m_LastRateTicks, updated by every game without taking the mutex
+	uint32_t m_DownloadRate;				// map bytes sent in the last second
+	uint32_t m_GameRate;					// in-game bytes sent in the last second
+	uint32_t m_LastRateTicks;
+
+	void UpdateRates( );
+	uint32_t GetLimit( );
+
+public:
+	CDownloadGovernor( );
+	~CDownloadGovernor( );
+
+	void SetLimits( uint32_t nMaxDownloadSpeed, uint32_t nUplinkSpeed, uint32_t nGameReserve );
+
+	// called from the game worker threads
+	// Request returns how many map bytes the game can send now, the game must pass back the difference to what it actually sent with Return (negative if it sent more)
+
+	int32_t Request( CBaseGame *game, uint32_t bytes );
+	void Return( int32_t bytes );
+	void Remove( CBaseGame *game );
+	void AddGameTraffic( uint32_t bytes )	{ m_GameBytes += bytes; }
+
+	string GetStatus( );
+};
+
+#endif
@@ -36,12 +36,16 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <deque>
 #include <map>
 #include <queue>
 #include <set>
 #include <string>
 #include <vector>
 #include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
 // boost log
@@ -73,8 +77,12 @@ uint32_t GetTicks( );		// milliseconds
 #endif
 
 // network
+// sockets are normally watched with epoll (see reactor.h) which has no limit on the number of sockets
+// the select fallback is used on Windows where the default limit is only 64 sockets so raise it
 
-#undef FD_SETSIZE
-#define FD_SETSIZE 512
+#ifdef WIN32
+ #undef FD_SETSIZE
+ #define FD_SETSIZE 512
+#endif
 
 #endif
@@ -1035,9 +1035,18 @@ string CLanguage :: AutoSaveDisabled( )
 	return m_CFG->GetString( "lang_0143", "lang_0143" );
 }
 
-string CLanguage :: DesyncDetected( )
+string CLanguage :: DesyncDetected( string frame, string time )
 {
-	return m_CFG->GetString( "lang_0144", "lang_0144" );
+	string Out = m_CFG->GetString( "lang_0144", "lang_0144" );
+
+	// this message is also what records the desync in the replay so make sure it has the frame even if the language file doesn't ask for it
+
+	if( Out.find( "$FRAME$" ) == string :: npos )
+		Out += " (" + time + ", frame " + frame + ")";
+
+	UTIL_Replace( Out, "$FRAME$", frame );
+	UTIL_Replace( Out, "$TIME$", time );
+	return Out;
 }
 
 string CLanguage :: UnableToMuteNoMatchesFound( string victim )
@@ -1568,3 +1577,41 @@ string CLanguage :: PlayerJoinedGame( string playerName, string serverName )
 	UTIL_Replace( Out, "$SERVER$", serverName );
 	return Out;
 }
+
+string CLanguage :: MapLoaded( string file )
+{
+	string Out = m_CFG->GetString( "lang_1005", "lang_1005" );
+	UTIL_Replace( Out, "$FILE$", file );
+	return Out;
+}
+
+string CLanguage :: MapLoadedInvalid( string file )
+{
+	string Out = m_CFG->GetString( "lang_1006", "lang_1006" );
+	UTIL_Replace( Out, "$FILE$", file );
+	return Out;
+}
+
+string CLanguage :: SettingLatencyToAutomatic( string min, string max )
+{
+	string Out = m_CFG->GetString( "lang_1007", "lang_1007" );
+	UTIL_Replace( Out, "$MIN$", min );
+	UTIL_Replace( Out, "$MAX$", max );
+	return Out;
+}
+
+string CLanguage :: LatencyIsAutomatic( string latency, string min, string max )
+{
+	string Out = m_CFG->GetString( "lang_1008", "lang_1008" );
+	UTIL_Replace( Out, "$LATENCY$", latency );
+	UTIL_Replace( Out, "$MIN$", min );
+	UTIL_Replace( Out, "$MAX$", max );
+	return Out;
+}
+
+string CLanguage :: UnableToCreateGameMapLoading( string gamename )
+{
+	string Out = m_CFG->GetString( "lang_1009", "lang_1009" );
+	UTIL_Replace( Out, "$GAMENAME$", gamename );
+	return Out;
+}
@@ -177,7 +177,7 @@ public:
 	string UnableToCreateGameSaveGameMapMismatch( string gamename );
 	string AutoSaveEnabled( );
 	string AutoSaveDisabled( );
-	string DesyncDetected( );
+	string DesyncDetected( string frame, string time );
 	string UnableToMuteNoMatchesFound( string victim );
 	string MutedPlayer( string victim, string user );
 	string UnmutedPlayer( string victim, string user );
@@ -259,6 +259,11 @@ public:
 	string VoteStartMinPlayers( string trigger, string minplayers );
 	string VoteStartXMoreVotesNeeded( string votesNeeded );
 	string PlayerJoinedGame( string playerName, string serverName );
+	string MapLoaded( string file );
+	string MapLoadedInvalid( string file );
+	string SettingLatencyToAutomatic( string min, string max );
+	string LatencyIsAutomatic( string latency, string min, string max );
+	string UnableToCreateGameMapLoading( string gamename );
 };
 
 #endif
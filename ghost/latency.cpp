@@ -0,0 +1,198 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+
+#include "ghost.h"
+#include "util.h"
+#include "latency.h"
+
+#include <string.h>
+
+// the lowest lateness (in ms) of each range in a tick histogram, every range goes up to the start of the next one
+
+static const uint32_t TickHistogramRanges[TICKHISTOGRAM_BINS] = { 0, 1, 2, 3, 5, 10, 20, 50 };
+
+//
+// CLatencyController
+//
+
+CLatencyController :: CLatencyController( uint32_t nMinimum, uint32_t nMaximum ) : m_Minimum( nMinimum ), m_Maximum( nMaximum ), m_WindowStartTicks( 0 ), m_Updates( 0 ), m_LateUpdates( 0 ), m_MaxSyncLag( 0 ), m_MaxPing( 0 ), m_CalmWindows( 0 ), m_LagScreen( false )
+{
+	// the same limits as the !latency command
+
+	if( m_Minimum < 20 )
+		m_Minimum = 20;
+
+	if( m_Maximum > 500 )
+		m_Maximum = 500;
+
+	if( m_Maximum < m_Minimum )
+		m_Maximum = m_Minimum;
+}
+
+CLatencyController :: ~CLatencyController( )
+{
+
+}
+
+uint32_t CLatencyController :: Clamp( uint32_t latency )
+{
+	if( latency < m_Minimum )
+		return m_Minimum;
+	else if( latency > m_Maximum )
+		return m_Maximum;
+	else
+		return latency;
+}
+
+void CLatencyController :: EventLagScreen( )
+{
+	m_LagScreen = true;
+}
+
+uint32_t CLatencyController :: EventActionsSent( uint32_t latency, uint32_t lateBy, uint32_t maxSyncLag, uint32_t maxPing, uint32_t syncLimit )
+{
+	// lateBy is how late this update was sent (m_LastActionLateBy), maxSyncLag is the most keepalives any player is behind by right now
+	// returns the latency to use from now on
+
+	// the first window starts with the first update so the time spent in the lobby and loading doesn't count
+
+	if( m_WindowStartTicks == 0 )
+		m_WindowStartTicks = GetTicks( );
+
+	++m_Updates;
+
+	if( lateBy > latency / 4 )
+		++m_LateUpdates;
+
+	m_MaxSyncLag = max( m_MaxSyncLag, maxSyncLag );
+	m_MaxPing = max( m_MaxPing, maxPing );
+
+	if( GetTicks( ) - m_WindowStartTicks < LATENCY_WINDOW )
+		return latency;
+
+	uint32_t NewLatency = latency;
+
+	// raise the latency when the host was late sending a quarter of the updates (it's probably starved of resources so sending fewer updates helps)
+	// or a player got a quarter of the way to the lag screen or the lag screen was shown anyway
+
+	if( m_LateUpdates * 4 > m_Updates )
+	{
+		NewLatency = latency + max( latency / 4, (uint32_t)LATENCY_STEP );
+		m_Reason = UTIL_ToString( m_LateUpdates ) + "/" + UTIL_ToString( m_Updates ) + " updates were sent late";
+	}
+	else if( m_LagScreen || m_MaxSyncLag > syncLimit / 4 )
+	{
+		NewLatency = latency + max( latency / 4, (uint32_t)LATENCY_STEP );
+		m_Reason = m_LagScreen ? "the lag screen was shown" : "a player fell " + UTIL_ToString( m_MaxSyncLag ) + " keepalives behind";
+	}
+
+	if( NewLatency != latency )
+		m_CalmWindows = 0;
+	else if( m_LateUpdates == 0 && m_MaxSyncLag <= syncLimit / 8 )
+	{
+		// lower the latency once everyone has kept up for a while
+		// a player with a ping of maxPing is always about maxPing / latency keepalives behind so don't go below the latency which puts that at an eighth of the sync limit
+		// this leaves room to spare before the controller would raise the latency again
+
+		++m_CalmWindows;
+
+		if( m_CalmWindows >= LATENCY_CALM_WINDOWS )
+		{
+			uint32_t Floor = syncLimit >= 8 ? m_MaxPing * 8 / syncLimit : m_MaxPing;
+
+			if( latency > LATENCY_STEP )
+				NewLatency = max( latency - LATENCY_STEP, Floor );
+
+			NewLatency = min( NewLatency, latency );
+			m_Reason = "everyone kept up for " + UTIL_ToString( m_CalmWindows * LATENCY_WINDOW / 1000 ) + " seconds";
+		}
+	}
+	else
+		m_CalmWindows = 0;
+
+	m_WindowStartTicks = GetTicks( );
+	m_Updates = 0;
+	m_LateUpdates = 0;
+	m_MaxSyncLag = 0;
+	m_MaxPing = 0;
+	m_LagScreen = false;
+	return Clamp( NewLatency );
+}
+
+//
+// CTickHistogram
+//
+
+CTickHistogram :: CTickHistogram( ) : m_NumUpdates( 0 ), m_MaxLateBy( 0 )
+{
+	memset( m_Bins, 0, sizeof( m_Bins ) );
+}
+
+CTickHistogram :: ~CTickHistogram( )
+{
+
+}
+
+void CTickHistogram :: Add( uint32_t lateBy )
+{
+	unsigned int Bin = TICKHISTOGRAM_BINS - 1;
+
+	while( Bin > 0 && lateBy < TickHistogramRanges[Bin] )
+		--Bin;
+
+	++m_Bins[Bin];
+	++m_NumUpdates;
+
+	if( lateBy > m_MaxLateBy )
+		m_MaxLateBy = lateBy;
+}
+
+string CTickHistogram :: GetStatus( )
+{
+	// e.g. "3000 action updates, late by 0ms 99.1%, 1ms 0.8%, 3-4ms 0.1%, max 4ms"
+
+	if( m_NumUpdates == 0 )
+		return "no action updates sent yet";
+
+	string Status = UTIL_ToString( m_NumUpdates ) + " action updates, late by ";
+	bool First = true;
+
+	for( unsigned int i = 0; i < TICKHISTOGRAM_BINS; ++i )
+	{
+		if( m_Bins[i] == 0 )
+			continue;
+
+		if( !First )
+			Status += ", ";
+
+		if( i == TICKHISTOGRAM_BINS - 1 )
+			Status += UTIL_ToString( TickHistogramRanges[i] ) + "ms+";
+		else if( TickHistogramRanges[i + 1] - TickHistogramRanges[i] == 1 )
+			Status += UTIL_ToString( TickHistogramRanges[i] ) + "ms";
+		else
+			Status += UTIL_ToString( TickHistogramRanges[i] ) + "-" + UTIL_ToString( TickHistogramRanges[i + 1] - 1 ) + "ms";
+
+		Status += " " + UTIL_ToString( (double)m_Bins[i] * 100 / m_NumUpdates, 1 ) + "%";
+		First = false;
+	}
+
+	return Status + ", max " + UTIL_ToString( m_MaxLateBy ) + "ms";
+}
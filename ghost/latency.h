@@ -0,0 +1,103 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+// the controller looks at the game every this many ms and decides whether to change the latency
+
+#define LATENCY_WINDOW				2000
+
+// the number of windows in a row without any trouble before the latency is lowered (it's lowered once per window after that)
+
+#define LATENCY_CALM_WINDOWS		3
+
+// the latency is lowered by this many ms at a time and raised by a quarter of the latency but at least this many ms at a time
+
+#define LATENCY_STEP				10
+
+// the number of lateness ranges in a tick histogram, see CTickHistogram :: Add
+
+#define TICKHISTOGRAM_BINS			8
+
+//
+// CLatencyController
+//
+
+// adjusts the latency of a game while it's running instead of leaving it at bot_latency for the whole game
+// it raises the latency quickly as soon as the host falls behind on sending actions or a player falls far enough behind that the lag screen is getting close
+// and lowers it slowly again while everyone keeps up, but never below what the slowest player's ping needs
+// a higher latency means fewer keepalives per second so a player who is behind by the same amount of time is behind by fewer keepalives compared to m_SyncLimit
+// the game reports every action update with EventActionsSent and uses the returned latency from then on
+
+class CLatencyController
+{
+private:
+	uint32_t m_Minimum;						// the lowest latency the controller will use
+	uint32_t m_Maximum;						// the highest latency the controller will use
+	uint32_t m_WindowStartTicks;			// GetTicks when the current window started (0 before the first update)
+	uint32_t m_Updates;						// the number of action updates sent in the current window
+	uint32_t m_LateUpdates;					// the number of action updates in the current window which were late by more than a quarter of the latency
+	uint32_t m_MaxSyncLag;					// the most keepalives any player was behind by in the current window
+	uint32_t m_MaxPing;						// the highest ping of any player in the current window
+	uint32_t m_CalmWindows;					// the number of windows in a row without any trouble
+	bool m_LagScreen;						// if the lag screen was shown in the current window
+	string m_Reason;						// why the latency was changed the last time it was changed
+
+public:
+	CLatencyController( uint32_t nMinimum, uint32_t nMaximum );
+	~CLatencyController( );
+
+	uint32_t GetMinimum( )					{ return m_Minimum; }
+	uint32_t GetMaximum( )					{ return m_Maximum; }
+	string GetReason( )						{ return m_Reason; }
+
+	uint32_t Clamp( uint32_t latency );
+	void EventLagScreen( );
+	uint32_t EventActionsSent( uint32_t latency, uint32_t lateBy, uint32_t maxSyncLag, uint32_t maxPing, uint32_t syncLimit );
+};
+
+//
+// CTickHistogram
+//
+
+// counts how late each action update of a game was sent compared to when it was due (m_LastActionLateBy)
+// the lateness is measured with GetTicks so an update in the 0ms range went out less than a millisecond after it was due
+
+class CTickHistogram
+{
+private:
+	uint32_t m_Bins[TICKHISTOGRAM_BINS];	// the number of updates in each lateness range
+	uint32_t m_NumUpdates;					// the number of updates counted
+	uint32_t m_MaxLateBy;					// the latest any update was sent
+
+public:
+	CTickHistogram( );
+	~CTickHistogram( );
+
+	uint32_t GetNumUpdates( )				{ return m_NumUpdates; }
+	uint32_t GetMaxLateBy( )				{ return m_MaxLateBy; }
+
+	void Add( uint32_t lateBy );
+	string GetStatus( );
+};
+
+#endif
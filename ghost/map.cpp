@@ -28,14 +28,352 @@
 #define __STORMLIB_SELF__
 #include <stormlib/StormLib.h>
 
+#include <sys/stat.h>
+
+#ifndef WIN32
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <unistd.h>
+#endif
+
 #define ROTL(x,n) ((x)<<(n))|((x)>>(32-(n)))	// this won't work with signed types
 #define ROTR(x,n) ((x)>>(n))|((x)<<(32-(n)))	// this won't work with signed types
 
+//
+// CMapData
+//
+
+map<string, boost::weak_ptr<CMapData> > CMapData :: m_Open;
+map<string, boost::shared_ptr<CMapData> > CMapData :: m_Warm;
+boost::mutex CMapData :: m_OpenMutex;
+
+CMapData :: CMapData( string nFile ) : m_File( nFile ), m_Data( NULL ), m_Size( 0 ), m_Mapped( false ), m_ModifiedTime( 0 ), m_CRC( 0 )
+{
+	if( m_File.empty( ) )
+		return;
+
+	struct stat fileinfo;
+
+	if( stat( m_File.c_str( ), &fileinfo ) == 0 )
+		m_ModifiedTime = fileinfo.st_mtime;
+
+#ifndef WIN32
+	int FD = open( m_File.c_str( ), O_RDONLY );
+
+	if( FD != -1 )
+	{
+		if( fstat( FD, &fileinfo ) == 0 && fileinfo.st_size > 0 )
+		{
+			void *Data = mmap( NULL, fileinfo.st_size, PROT_READ, MAP_SHARED, FD, 0 );
+
+			if( Data != MAP_FAILED )
+			{
+				m_Data = (unsigned char *)Data;
+				m_Size = fileinfo.st_size;
+				m_Mapped = true;
+				m_ModifiedTime = fileinfo.st_mtime;
+
+				// the map is sent to players from start to finish so tell the kernel to read ahead
+
+				madvise( Data, m_Size, MADV_SEQUENTIAL );
+			}
+		}
+
+		// the mapping keeps its own reference to the file so we don't need the descriptor anymore
+
+		close( FD );
+	}
+
+#endif
+
+	if( !m_Mapped )
+	{
+		// either we can't memory map the file on this platform or mmap failed, read the whole file instead
+
+		m_Buffer = UTIL_FileRead( m_File );
+
+		if( !m_Buffer.empty( ) )
+		{
+			m_Data = (unsigned char *)m_Buffer.data( );
+			m_Size = m_Buffer.size( );
+		}
+	}
+
+	// calculate the CRC of the whole file (for map_info and the map cache) and every map part now so sending a map part doesn't have to
+
+	CCRC32 CRC;
+	CRC.Initialize( );
+
+	if( m_Size > 0 )
+		m_CRC = CRC.FullCRC( m_Data, m_Size );
+
+	m_PartCRCs.reserve( ( m_Size + MAPPART_SIZE - 1 ) / MAPPART_SIZE );
+
+	for( uint32_t i = 0; i < m_Size; i += MAPPART_SIZE )
+		m_PartCRCs.push_back( CRC.FullCRC( m_Data + i, m_Size - i < MAPPART_SIZE ? m_Size - i : MAPPART_SIZE ) );
+}
+
+CMapData :: ~CMapData( )
+{
+#ifndef WIN32
+	if( m_Mapped )
+		munmap( m_Data, m_Size );
+#endif
+}
+
+boost::shared_ptr<CMapData> CMapData :: Open( string file )
+{
+	if( file.empty( ) )
+		return boost::shared_ptr<CMapData>( new CMapData( file ) );
+
+	boost::mutex::scoped_lock lock( m_OpenMutex );
+
+	// reuse the data if this file is already open and hasn't been replaced or changed since it was opened
+
+	map<string, boost::weak_ptr<CMapData> > :: iterator i = m_Open.find( file );
+
+	if( i != m_Open.end( ) )
+	{
+		boost::shared_ptr<CMapData> Data = i->second.lock( );
+		struct stat fileinfo;
+
+		if( Data && stat( file.c_str( ), &fileinfo ) == 0 && (uint32_t)fileinfo.st_size == Data->GetSize( ) && (uint32_t)fileinfo.st_mtime == Data->m_ModifiedTime )
+			return Data;
+	}
+
+	boost::shared_ptr<CMapData> Data( new CMapData( file ) );
+
+	// forget about any files which aren't in use anymore while we're here
+
+	for( i = m_Open.begin( ); i != m_Open.end( ); )
+	{
+		if( i->second.expired( ) )
+			m_Open.erase( i++ );
+		else
+			++i;
+	}
+
+	if( !Data->GetEmpty( ) )
+		m_Open[file] = Data;
+
+	// a warm file which had to be opened again has been replaced (or removed) since it was warmed
+	// keep the new data warm instead so the old file isn't held open until we exit
+
+	map<string, boost::shared_ptr<CMapData> > :: iterator j = m_Warm.find( file );
+
+	if( j != m_Warm.end( ) )
+	{
+		if( Data->GetEmpty( ) )
+			m_Warm.erase( j );
+		else
+			j->second = Data;
+	}
+
+	return Data;
+}
+
+void CMapData :: Warm( boost::shared_ptr<CMapData> data )
+{
+	if( data->GetEmpty( ) )
+		return;
+
+	boost::mutex::scoped_lock lock( m_OpenMutex );
+	m_Warm[data->GetFile( )] = data;
+}
+
+void CMapData :: KeepWarm( const set<string> &files )
+{
+	// stop keeping any file which isn't in files open
+
+	boost::mutex::scoped_lock lock( m_OpenMutex );
+
+	for( map<string, boost::shared_ptr<CMapData> > :: iterator i = m_Warm.begin( ); i != m_Warm.end( ); )
+	{
+		if( files.find( i->first ) == files.end( ) )
+			m_Warm.erase( i++ );
+		else
+			++i;
+	}
+}
+
+//
+// CMapCacheEntry
+//
+
+CMapCacheEntry :: CMapCacheEntry( ) : m_Size( 0 ), m_ModifiedTime( 0 ), m_CRC( 0 ), m_ScriptsCRC( 0 ), m_MapOptions( 0 ), m_MapNumPlayers( 0 ), m_MapNumTeams( 0 ), m_MapFilterType( 0 ), m_EditorVersion( 0 )
+{
+
+}
+
+CMapCacheEntry :: ~CMapCacheEntry( )
+{
+
+}
+
+//
+// CMapCache
+//
+
+CMapCache :: CMapCache( string nFile ) : m_File( nFile )
+{
+	ifstream in;
+	in.open( m_File.c_str( ) );
+
+	if( in.fail( ) )
+	{
+		BOOST_LOG_TRIVIAL(info) << "[MAPCACHE] map cache file [" + m_File + "] doesn't exist yet, it will be created when the first map is loaded";
+		return;
+	}
+
+	string Line;
+
+	while( getline( in, Line ) )
+	{
+		if( !Line.empty( ) && Line[Line.size( ) - 1] == '\r' )
+			Line.erase( Line.size( ) - 1 );
+
+		if( Line.empty( ) || Line[0] == '#' )
+			continue;
+
+		// split the line into its fields
+
+		vector<string> Fields;
+		string :: size_type Start = 0;
+		string :: size_type End;
+
+		while( ( End = Line.find( '\t', Start ) ) != string :: npos )
+		{
+			Fields.push_back( Line.substr( Start, End - Start ) );
+			Start = End + 1;
+		}
+
+		Fields.push_back( Line.substr( Start ) );
+
+		if( Fields.size( ) != 15 )
+		{
+			BOOST_LOG_TRIVIAL(warning) << "[MAPCACHE] ignoring invalid entry in map cache file [" + m_File + "]";
+			continue;
+		}
+
+		CMapCacheEntry Entry;
+		Entry.m_File = Fields[0];
+		Entry.m_Size = UTIL_ToUInt32( Fields[1] );
+		Entry.m_ModifiedTime = UTIL_ToUInt32( Fields[2] );
+		Entry.m_CRC = UTIL_ToUInt32( Fields[3] );
+		Entry.m_ScriptsCRC = UTIL_ToUInt32( Fields[4] );
+		Entry.m_MapCRC = UTIL_ExtractNumbers( Fields[5], 4 );
+		Entry.m_MapSHA1 = UTIL_ExtractNumbers( Fields[6], 20 );
+		Entry.m_MapOptions = UTIL_ToUInt32( Fields[7] );
+		Entry.m_MapWidth = UTIL_ExtractNumbers( Fields[8], 2 );
+		Entry.m_MapHeight = UTIL_ExtractNumbers( Fields[9], 2 );
+		Entry.m_MapNumPlayers = UTIL_ToUInt32( Fields[10] );
+		Entry.m_MapNumTeams = UTIL_ToUInt32( Fields[11] );
+		Entry.m_MapFilterType = UTIL_ToUInt32( Fields[12] );
+		Entry.m_EditorVersion = UTIL_ToUInt32( Fields[13] );
+
+		// the slots are separated by commas
+
+		stringstream SS( Fields[14] );
+		string Slot;
+
+		while( getline( SS, Slot, ',' ) )
+		{
+			BYTEARRAY SlotData = UTIL_ExtractNumbers( Slot, 9 );
+
+			if( SlotData.size( ) == 9 )
+				Entry.m_Slots.push_back( CGameSlot( SlotData ) );
+		}
+
+		m_Entries[Entry.m_File] = Entry;
+	}
+
+	in.close( );
+	BOOST_LOG_TRIVIAL(info) << "[MAPCACHE] loaded " + UTIL_ToString( m_Entries.size( ) ) + " entries from map cache file [" + m_File + "]";
+}
+
+CMapCache :: ~CMapCache( )
+{
+
+}
+
+bool CMapCache :: Get( string file, uint32_t size, uint32_t modifiedTime, uint32_t crc, uint32_t scriptsCRC, CMapCacheEntry &entry )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+	map<string, CMapCacheEntry> :: iterator i = m_Entries.find( file );
+
+	if( i == m_Entries.end( ) )
+		return false;
+
+	if( i->second.m_Size != size || i->second.m_ModifiedTime != modifiedTime || i->second.m_CRC != crc || i->second.m_ScriptsCRC != scriptsCRC )
+	{
+		BOOST_LOG_TRIVIAL(info) << "[MAPCACHE] map file [" + file + "] has changed since it was cached";
+		return false;
+	}
+
+	entry = i->second;
+	return true;
+}
+
+void CMapCache :: Put( CMapCacheEntry &entry )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+	m_Entries[entry.m_File] = entry;
+	Save( );
+}
+
+void CMapCache :: Save( )
+{
+	// write to a temporary file first and then replace the cache file so a crash while saving can't leave a truncated cache behind
+
+	string TempFile = m_File + ".tmp";
+	ofstream out;
+	out.open( TempFile.c_str( ) );
+
+	if( out.fail( ) )
+	{
+		BOOST_LOG_TRIVIAL(warning) << "[MAPCACHE] unable to write map cache file [" + TempFile + "]";
+		return;
+	}
+
+	out << "# GHost++ map cache, this file is rewritten automatically, delete it to clear the cache" << endl;
+	out << "# file\tsize\tmodified time\tmap_info\tscripts crc\tmap_crc\tmap_sha1\tmap_options\tmap_width\tmap_height\tmap_numplayers\tmap_numteams\tmap_filter_type\teditor version\tmap_slots" << endl;
+
+	for( map<string, CMapCacheEntry> :: iterator i = m_Entries.begin( ); i != m_Entries.end( ); ++i )
+	{
+		CMapCacheEntry &Entry = i->second;
+		string Slots;
+
+		for( vector<CGameSlot> :: iterator j = Entry.m_Slots.begin( ); j != Entry.m_Slots.end( ); ++j )
+		{
+			if( !Slots.empty( ) )
+				Slots += ",";
+
+			Slots += UTIL_ByteArrayToDecString( (*j).GetByteArray( ) );
+		}
+
+		out << Entry.m_File << "\t" << Entry.m_Size << "\t" << Entry.m_ModifiedTime << "\t" << Entry.m_CRC << "\t" << Entry.m_ScriptsCRC << "\t";
+		out << UTIL_ByteArrayToDecString( Entry.m_MapCRC ) << "\t" << UTIL_ByteArrayToDecString( Entry.m_MapSHA1 ) << "\t" << Entry.m_MapOptions << "\t";
+		out << UTIL_ByteArrayToDecString( Entry.m_MapWidth ) << "\t" << UTIL_ByteArrayToDecString( Entry.m_MapHeight ) << "\t" << Entry.m_MapNumPlayers << "\t";
+		out << Entry.m_MapNumTeams << "\t" << Entry.m_MapFilterType << "\t" << Entry.m_EditorVersion << "\t" << Slots << endl;
+	}
+
+	out.close( );
+
+	// rename doesn't replace an existing file on Windows
+
+#ifdef WIN32
+	remove( m_File.c_str( ) );
+#endif
+
+	if( rename( TempFile.c_str( ), m_File.c_str( ) ) != 0 )
+		BOOST_LOG_TRIVIAL(warning) << "[MAPCACHE] unable to replace map cache file [" + m_File + "]";
+}
+
 //
 // CMap
 //
 
-CMap :: CMap( CGHost *nGHost ) : m_GHost( nGHost ), m_Valid( true ), m_MapPath( "Maps\\FrozenThrone\\(12)EmeraldGardens.w3x" ), m_MapSize( UTIL_ExtractNumbers( "174 221 4 0", 4 ) ), m_MapInfo( UTIL_ExtractNumbers( "251 57 68 98", 4 ) ), m_MapCRC( UTIL_ExtractNumbers( "108 250 204 59", 4 ) ), m_MapSHA1( UTIL_ExtractNumbers( "35 81 104 182 223 63 204 215 1 17 87 234 220 66 3 185 82 99 6 13", 20 ) ), m_MapSpeed( MAPSPEED_FAST ), m_MapVisibility( MAPVIS_DEFAULT ), m_MapObservers( MAPOBS_NONE ), m_MapFlags( MAPFLAG_TEAMSTOGETHER | MAPFLAG_FIXEDTEAMS ), m_MapFilterMaker( MAPFILTER_MAKER_BLIZZARD ), m_MapFilterType( MAPFILTER_TYPE_MELEE ), m_MapFilterSize( MAPFILTER_SIZE_LARGE ), m_MapFilterObs( MAPFILTER_OBS_NONE ), m_MapOptions( MAPOPT_MELEE ), m_MapWidth( UTIL_ExtractNumbers( "172 0", 2 ) ), m_MapHeight( UTIL_ExtractNumbers( "172 0", 2 ) ), m_MapLoadInGame( false ), m_MapNumPlayers( 12 ), m_MapNumTeams( 12 )
+CMap :: CMap( CGHost *nGHost ) : m_GHost( nGHost ), m_Valid( true ), m_MapPath( "Maps\\FrozenThrone\\(12)EmeraldGardens.w3x" ), m_MapSize( UTIL_ExtractNumbers( "174 221 4 0", 4 ) ), m_MapInfo( UTIL_ExtractNumbers( "251 57 68 98", 4 ) ), m_MapCRC( UTIL_ExtractNumbers( "108 250 204 59", 4 ) ), m_MapSHA1( UTIL_ExtractNumbers( "35 81 104 182 223 63 204 215 1 17 87 234 220 66 3 185 82 99 6 13", 20 ) ), m_MapSpeed( MAPSPEED_FAST ), m_MapVisibility( MAPVIS_DEFAULT ), m_MapObservers( MAPOBS_NONE ), m_MapFlags( MAPFLAG_TEAMSTOGETHER | MAPFLAG_FIXEDTEAMS ), m_MapFilterMaker( MAPFILTER_MAKER_BLIZZARD ), m_MapFilterType( MAPFILTER_TYPE_MELEE ), m_MapFilterSize( MAPFILTER_SIZE_LARGE ), m_MapFilterObs( MAPFILTER_OBS_NONE ), m_MapOptions( MAPOPT_MELEE ), m_MapWidth( UTIL_ExtractNumbers( "172 0", 2 ) ), m_MapHeight( UTIL_ExtractNumbers( "172 0", 2 ) ), m_MapLoadInGame( false ), m_MapData( CMapData :: Open( string( ) ) ), m_MapNumPlayers( 12 ), m_MapNumTeams( 12 )
 {
 	BOOST_LOG_TRIVIAL(info) << "[MAP] using hardcoded Emerald Gardens map data for Warcraft 3 version 1.24 & 1.24b";
 	m_Slots.push_back( CGameSlot( 0, 255, SLOTSTATUS_OPEN, 0, 0, 0, SLOTRACE_RANDOM | SLOTRACE_SELECTABLE ) );
@@ -52,9 +390,9 @@ CMap :: CMap( CGHost *nGHost ) : m_GHost( nGHost ), m_Valid( true ), m_MapPath(
 	m_Slots.push_back( CGameSlot( 0, 255, SLOTSTATUS_OPEN, 0, 11, 11, SLOTRACE_RANDOM | SLOTRACE_SELECTABLE ) );
 }
 
-CMap :: CMap( CGHost *nGHost, CConfig *CFG, string nCFGFile ) : m_GHost( nGHost )
+CMap :: CMap( CGHost *nGHost, CConfig *CFG, string nCFGFile, string mapPath, string mapCFGPath ) : m_GHost( nGHost ), m_MapData( CMapData :: Open( string( ) ) )
 {
-	Load( CFG, nCFGFile );
+	Load( CFG, nCFGFile, mapPath, mapCFGPath );
 }
 
 CMap :: ~CMap( )
@@ -227,26 +565,55 @@ unsigned char CMap :: GetMapLayoutStyle( )
 	return 3;
 }
 
-void CMap :: Load( CConfig *CFG, string nCFGFile )
+void CMap :: Load( CConfig *CFG, string nCFGFile, string mapPath, string mapCFGPath )
 {
+	// this is called on the map loader thread so the map path and the map config path (bot_mappath and bot_mapcfgpath) are passed in rather than read from m_GHost
+
 	m_Valid = true;
 	m_CFGFile = nCFGFile;
 
 	// load the map data
 
 	m_MapLocalPath = CFG->GetString( "map_localpath", string( ) );
-	m_MapData.clear( );
 
 	if( !m_MapLocalPath.empty( ) )
-		m_MapData = UTIL_FileRead( m_GHost->m_MapPath + m_MapLocalPath );
+		m_MapData = CMapData :: Open( mapPath + m_MapLocalPath );
+	else
+		m_MapData = CMapData :: Open( string( ) );
 
-	// load the map MPQ
+	// check the map cache
+	// if we've loaded this exact map file before (with the same common.j and blizzard.j) we already know everything we'd calculate from it
 
-	string MapMPQFileName = m_GHost->m_MapPath + m_MapLocalPath;
+	string CommonJ;
+	string BlizzardJ;
+	uint32_t ScriptsCRC = 0;
+	CMapCacheEntry CacheEntry;
+	bool Cached = false;
+
+	if( !m_MapData->GetEmpty( ) )
+	{
+		CommonJ = UTIL_FileRead( mapCFGPath + "common.j" );
+		BlizzardJ = UTIL_FileRead( mapCFGPath + "blizzard.j" );
+
+		if( m_GHost->m_MapCache )
+		{
+			ScriptsCRC = 0xFFFFFFFF;
+			m_GHost->m_CRC->PartialCRC( &ScriptsCRC, (unsigned char *)CommonJ.data( ), CommonJ.size( ) );
+			m_GHost->m_CRC->PartialCRC( &ScriptsCRC, (unsigned char *)BlizzardJ.data( ), BlizzardJ.size( ) );
+			ScriptsCRC ^= 0xFFFFFFFF;
+			Cached = m_GHost->m_MapCache->Get( m_MapData->GetFile( ), m_MapData->GetSize( ), m_MapData->GetModifiedTime( ), m_MapData->GetCRC( ), ScriptsCRC, CacheEntry );
+		}
+	}
+
+	// load the map MPQ (unless we found the map in the cache)
+
+	string MapMPQFileName = mapPath + m_MapLocalPath;
 	HANDLE MapMPQ;
 	bool MapMPQReady = false;
 
-	if( SFileOpenArchive( MapMPQFileName.c_str( ), 0, MPQ_OPEN_FORCE_MPQ_V1, &MapMPQ ) )
+	if( Cached )
+		BOOST_LOG_TRIVIAL(info) << "[MAP] found map file [" + MapMPQFileName + "] in the map cache";
+	else if( SFileOpenArchive( MapMPQFileName.c_str( ), 0, MPQ_OPEN_FORCE_MPQ_V1, &MapMPQ ) )
 	{
 		BOOST_LOG_TRIVIAL(info) << "[MAP] loading MPQ file [" + MapMPQFileName + "]";
 		MapMPQReady = true;
@@ -261,33 +628,39 @@ void CMap :: Load( CConfig *CFG, string nCFGFile )
 	BYTEARRAY MapCRC;
 	BYTEARRAY MapSHA1;
 
-	if( !m_MapData.empty( ) )
+	if( Cached )
 	{
-		m_GHost->m_SHA->Reset( );
+		MapSize = UTIL_CreateByteArray( m_MapData->GetSize( ), false );
+		MapInfo = UTIL_CreateByteArray( CacheEntry.m_CRC, false );
+		MapCRC = CacheEntry.m_MapCRC;
+		MapSHA1 = CacheEntry.m_MapSHA1;
+		BOOST_LOG_TRIVIAL(info) << "[MAP] cached map_size = " + UTIL_ByteArrayToDecString( MapSize ) + ", map_info = " + UTIL_ByteArrayToDecString( MapInfo ) + ", map_crc = " + UTIL_ByteArrayToDecString( MapCRC ) + ", map_sha1 = " + UTIL_ByteArrayToDecString( MapSHA1 );
+	}
+	else if( !m_MapData->GetEmpty( ) )
+	{
+		// maps are loaded on the map loader thread so we use our own SHA1 rather than the shared one
+
+		CSHA1 SHA;
 
 		// calculate map_size
 
-		MapSize = UTIL_CreateByteArray( (uint32_t)m_MapData.size( ), false );
+		MapSize = UTIL_CreateByteArray( m_MapData->GetSize( ), false );
 		BOOST_LOG_TRIVIAL(info) << "[MAP] calculated map_size = " + UTIL_ByteArrayToDecString( MapSize );
 
 		// calculate map_info (this is actually the CRC)
 
-		MapInfo = UTIL_CreateByteArray( (uint32_t)m_GHost->m_CRC->FullCRC( (unsigned char *)m_MapData.c_str( ), m_MapData.size( ) ), false );
+		MapInfo = UTIL_CreateByteArray( m_MapData->GetCRC( ), false );
 		BOOST_LOG_TRIVIAL(info) << "[MAP] calculated map_info = " + UTIL_ByteArrayToDecString( MapInfo );
 
 		// calculate map_crc (this is not the CRC) and map_sha1
 		// a big thank you to Strilanc for figuring the map_crc algorithm out
 
-		string CommonJ = UTIL_FileRead( m_GHost->m_MapCFGPath + "common.j" );
-
 		if( CommonJ.empty( ) )
-			BOOST_LOG_TRIVIAL(info) << "[MAP] unable to calculate map_crc/sha1 - unable to read file [" + m_GHost->m_MapCFGPath + "common.j]";
+			BOOST_LOG_TRIVIAL(info) << "[MAP] unable to calculate map_crc/sha1 - unable to read file [" + mapCFGPath + "common.j]";
 		else
 		{
-			string BlizzardJ = UTIL_FileRead( m_GHost->m_MapCFGPath + "blizzard.j" );
-
 			if( BlizzardJ.empty( ) )
-				BOOST_LOG_TRIVIAL(info) << "[MAP] unable to calculate map_crc/sha1 - unable to read file [" + m_GHost->m_MapCFGPath + "blizzard.j]";
+				BOOST_LOG_TRIVIAL(info) << "[MAP] unable to calculate map_crc/sha1 - unable to read file [" + mapCFGPath + "blizzard.j]";
 			else
 			{
 				uint32_t Val = 0;
@@ -318,7 +691,7 @@ void CMap :: Load( CConfig *CFG, string nCFGFile )
 								BOOST_LOG_TRIVIAL(info) << "[MAP] overriding default common.j with map copy while calculating map_crc/sha1";
 								OverrodeCommonJ = true;
 								Val = Val ^ XORRotateLeft( (unsigned char *)SubFileData, BytesRead );
-								m_GHost->m_SHA->Update( (unsigned char *)SubFileData, BytesRead );
+								SHA.Update( (unsigned char *)SubFileData, BytesRead );
 							}
 
 							delete [] SubFileData;
@@ -331,7 +704,7 @@ void CMap :: Load( CConfig *CFG, string nCFGFile )
 				if( !OverrodeCommonJ )
 				{
 					Val = Val ^ XORRotateLeft( (unsigned char *)CommonJ.c_str( ), CommonJ.size( ) );
-					m_GHost->m_SHA->Update( (unsigned char *)CommonJ.c_str( ), CommonJ.size( ) );
+					SHA.Update( (unsigned char *)CommonJ.c_str( ), CommonJ.size( ) );
 				}
 
 				if( MapMPQReady )
@@ -354,7 +727,7 @@ void CMap :: Load( CConfig *CFG, string nCFGFile )
 								BOOST_LOG_TRIVIAL(info) << "[MAP] overriding default blizzard.j with map copy while calculating map_crc/sha1";
 								OverrodeBlizzardJ = true;
 								Val = Val ^ XORRotateLeft( (unsigned char *)SubFileData, BytesRead );
-								m_GHost->m_SHA->Update( (unsigned char *)SubFileData, BytesRead );
+								SHA.Update( (unsigned char *)SubFileData, BytesRead );
 							}
 
 							delete [] SubFileData;
@@ -367,12 +740,12 @@ void CMap :: Load( CConfig *CFG, string nCFGFile )
 				if( !OverrodeBlizzardJ )
 				{
 					Val = Val ^ XORRotateLeft( (unsigned char *)BlizzardJ.c_str( ), BlizzardJ.size( ) );
-					m_GHost->m_SHA->Update( (unsigned char *)BlizzardJ.c_str( ), BlizzardJ.size( ) );
+					SHA.Update( (unsigned char *)BlizzardJ.c_str( ), BlizzardJ.size( ) );
 				}
 
 				Val = ROTL( Val, 3 );
 				Val = ROTL( Val ^ 0x03F1379E, 3 );
-				m_GHost->m_SHA->Update( (unsigned char *)"\x9E\x37\xF1\x03", 4 );
+				SHA.Update( (unsigned char *)"\x9E\x37\xF1\x03", 4 );
 
 				if( MapMPQReady )
 				{
@@ -413,7 +786,7 @@ void CMap :: Load( CConfig *CFG, string nCFGFile )
 										FoundScript = true;
 
 									Val = ROTL( Val ^ XORRotateLeft( (unsigned char *)SubFileData, BytesRead ), 3 );
-									m_GHost->m_SHA->Update( (unsigned char *)SubFileData, BytesRead );
+									SHA.Update( (unsigned char *)SubFileData, BytesRead );
 									// DEBUG_Print( "*** found: " + *i );
 								}
 
@@ -434,10 +807,10 @@ void CMap :: Load( CConfig *CFG, string nCFGFile )
 					MapCRC = UTIL_CreateByteArray( Val, false );
 					BOOST_LOG_TRIVIAL(info) << "[MAP] calculated map_crc = " + UTIL_ByteArrayToDecString( MapCRC );
 
-					m_GHost->m_SHA->Final( );
+					SHA.Final( );
 					unsigned char SHA1[20];
 					memset( SHA1, 0, sizeof( unsigned char ) * 20 );
-					m_GHost->m_SHA->GetHash( SHA1 );
+					SHA.GetHash( SHA1 );
 					MapSHA1 = UTIL_CreateByteArray( SHA1, 20 );
 					BOOST_LOG_TRIVIAL(info) << "[MAP] calculated map_sha1 = " + UTIL_ByteArrayToDecString( MapSHA1 );
 				}
@@ -451,7 +824,7 @@ void CMap :: Load( CConfig *CFG, string nCFGFile )
 
 	// try to calculate map_width, map_height, map_slot<x>, map_numplayers, map_numteams
 
-	uint32_t EditorVersion; // used to determine maximum slots when adding observers
+	uint32_t EditorVersion = 0; // used to determine maximum slots when adding observers
 	uint32_t MapOptions = 0;
 	BYTEARRAY MapWidth;
 	BYTEARRAY MapHeight;
@@ -460,7 +833,19 @@ void CMap :: Load( CConfig *CFG, string nCFGFile )
 	uint32_t MapFilterType = MAPFILTER_TYPE_SCENARIO;
 	vector<CGameSlot> Slots;
 
-	if( !m_MapData.empty( ) )
+	if( Cached )
+	{
+		EditorVersion = CacheEntry.m_EditorVersion;
+		MapOptions = CacheEntry.m_MapOptions;
+		MapWidth = CacheEntry.m_MapWidth;
+		MapHeight = CacheEntry.m_MapHeight;
+		MapNumPlayers = CacheEntry.m_MapNumPlayers;
+		MapNumTeams = CacheEntry.m_MapNumTeams;
+		MapFilterType = CacheEntry.m_MapFilterType;
+		Slots = CacheEntry.m_Slots;
+		BOOST_LOG_TRIVIAL(info) << "[MAP] cached map_options = " + UTIL_ToString( MapOptions ) + ", map_width = " + UTIL_ByteArrayToDecString( MapWidth ) + ", map_height = " + UTIL_ByteArrayToDecString( MapHeight ) + ", map_numplayers = " + UTIL_ToString( MapNumPlayers ) + ", map_numteams = " + UTIL_ToString( MapNumTeams ) + ", " + UTIL_ToString( Slots.size( ) ) + " slots";
+	}
+	else if( !m_MapData->GetEmpty( ) )
 	{
 		if( MapMPQReady )
 		{
@@ -696,8 +1081,32 @@ void CMap :: Load( CConfig *CFG, string nCFGFile )
 	// close the map MPQ
 
 	if( MapMPQReady )
+	{
 		SFileCloseArchive( MapMPQ );
 
+		// remember what we calculated so we don't have to do it again next time
+
+		if( m_GHost->m_MapCache && !m_MapData->GetEmpty( ) )
+		{
+			CacheEntry.m_File = m_MapData->GetFile( );
+			CacheEntry.m_Size = m_MapData->GetSize( );
+			CacheEntry.m_ModifiedTime = m_MapData->GetModifiedTime( );
+			CacheEntry.m_CRC = m_MapData->GetCRC( );
+			CacheEntry.m_ScriptsCRC = ScriptsCRC;
+			CacheEntry.m_MapCRC = MapCRC;
+			CacheEntry.m_MapSHA1 = MapSHA1;
+			CacheEntry.m_MapOptions = MapOptions;
+			CacheEntry.m_MapWidth = MapWidth;
+			CacheEntry.m_MapHeight = MapHeight;
+			CacheEntry.m_MapNumPlayers = MapNumPlayers;
+			CacheEntry.m_MapNumTeams = MapNumTeams;
+			CacheEntry.m_MapFilterType = MapFilterType;
+			CacheEntry.m_EditorVersion = EditorVersion;
+			CacheEntry.m_Slots = Slots;
+			m_GHost->m_MapCache->Put( CacheEntry );
+		}
+	}
+
 	m_MapPath = CFG->GetString( "map_path", string( ) );
 
 	if( MapSize.empty( ) )
@@ -893,7 +1302,7 @@ void CMap :: CheckValid( )
 		m_Valid = false;
 		BOOST_LOG_TRIVIAL(warning) << "[MAP] invalid map_size detected";
 	}
-	else if( !m_MapData.empty( ) && m_MapData.size( ) != UTIL_ByteArrayToUInt32( m_MapSize, false ) )
+	else if( !m_MapData->GetEmpty( ) && m_MapData->GetSize( ) != UTIL_ByteArrayToUInt32( m_MapSize, false ) )
 	{
 		m_Valid = false;
 		BOOST_LOG_TRIVIAL(warning) << "[MAP] invalid map_size detected - size mismatch with actual map data";
@@ -85,6 +85,114 @@
 
 #include "gameslot.h"
 
+// the number of map bytes sent in each W3GS_MAPPART packet
+
+#define MAPPART_SIZE 1442
+
+//
+// CMapData
+//
+
+// the contents of a map file, shared by every CMap (and therefore every game) using the same file
+// the file is memory mapped read only so its bytes are stored once no matter how many games are hosting it and the pages are shared with the OS file cache
+// on platforms without mmap the file is read into memory instead, it's still only stored once per file
+// the CRC of every map part is calculated when the file is opened and map parts are sent straight from this data without copying it (see CGameProtocol :: SEND_W3GS_MAPPART)
+// use CMapData :: Open to get the data for a file, it returns the data which is already open for that file as long as the file hasn't changed since
+// a warm file (bot_warmmaps) is kept open even while no map is using it, when it's replaced the next Open of that file keeps the new data warm instead
+// warning: don't modify a map file in place while the bot is running, replace it with a new file instead
+
+class CMapData
+{
+private:
+	string m_File;
+	unsigned char *m_Data;
+	uint32_t m_Size;
+	bool m_Mapped;								// true if m_Data is a memory mapping, false if it points into m_Buffer
+	string m_Buffer;							// the file contents when it couldn't be memory mapped
+	uint32_t m_ModifiedTime;					// the file's modification time when it was opened
+	uint32_t m_CRC;								// the CRC of the whole file (map_info)
+	vector<uint32_t> m_PartCRCs;				// the CRC of each MAPPART_SIZE bytes of the file, the last part may be shorter
+	static map<string, boost::weak_ptr<CMapData> > m_Open;
+	static map<string, boost::shared_ptr<CMapData> > m_Warm;	// the data of the warm files, kept open even if nothing else is using it
+	static boost::mutex m_OpenMutex;
+
+	CMapData( string nFile );
+	CMapData( const CMapData & );
+	CMapData &operator=( const CMapData & );
+
+public:
+	~CMapData( );
+
+	string GetFile( )						{ return m_File; }
+	const unsigned char *GetData( )			{ return m_Data; }
+	uint32_t GetSize( )						{ return m_Size; }
+	bool GetEmpty( )						{ return m_Size == 0; }
+	bool GetMapped( )						{ return m_Mapped; }
+	uint32_t GetModifiedTime( )				{ return m_ModifiedTime; }
+	uint32_t GetCRC( )						{ return m_CRC; }
+	uint32_t GetPartCRC( uint32_t part )	{ return m_PartCRCs[part]; }
+
+	// called from any thread
+
+	static boost::shared_ptr<CMapData> Open( string file );
+	static void Warm( boost::shared_ptr<CMapData> data );
+	static void KeepWarm( const set<string> &files );
+};
+
+//
+// CMapCache
+//
+
+// the values CMap :: Load calculates from a map file
+// an entry is only valid for the exact map file it was calculated from (same path, size, modification time, and CRC) and the same common.j and blizzard.j
+
+class CMapCacheEntry
+{
+public:
+	string m_File;
+	uint32_t m_Size;
+	uint32_t m_ModifiedTime;
+	uint32_t m_CRC;								// map_info
+	uint32_t m_ScriptsCRC;						// the CRC of common.j followed by blizzard.j
+	BYTEARRAY m_MapCRC;
+	BYTEARRAY m_MapSHA1;
+	uint32_t m_MapOptions;
+	BYTEARRAY m_MapWidth;
+	BYTEARRAY m_MapHeight;
+	uint32_t m_MapNumPlayers;
+	uint32_t m_MapNumTeams;
+	uint32_t m_MapFilterType;
+	uint32_t m_EditorVersion;
+	vector<CGameSlot> m_Slots;
+
+	CMapCacheEntry( );
+	~CMapCacheEntry( );
+};
+
+// a cache file of the values calculated from every map file we've loaded so loading the same map again doesn't have to open the MPQ, hash the scripts, and parse war3map.w3i
+// the file is a text file with one tab separated line per map file and is rewritten whenever a new entry is added
+// Get and Put are called from the map loader thread
+
+class CMapCache
+{
+private:
+	string m_File;
+	map<string, CMapCacheEntry> m_Entries;		// keyed by map file path
+	boost::mutex m_Mutex;						// maps are loaded on the map loader thread
+
+	void Save( );
+
+public:
+	CMapCache( string nFile );
+	~CMapCache( );
+
+	string GetFile( )						{ return m_File; }
+	uint32_t GetNumEntries( )				{ return m_Entries.size( ); }
+
+	bool Get( string file, uint32_t size, uint32_t modifiedTime, uint32_t crc, uint32_t scriptsCRC, CMapCacheEntry &entry );
+	void Put( CMapCacheEntry &entry );
+};
+
 //
 // CMap
 //
@@ -120,14 +228,14 @@ private:
 	uint32_t m_MapDefaultPlayerScore;			// config value: map default player score (for matchmaking)
 	string m_MapLocalPath;						// config value: map local path
 	bool m_MapLoadInGame;
-	string m_MapData;							// the map data itself, for sending the map to players
+	boost::shared_ptr<CMapData> m_MapData;		// the map data itself, for sending the map to players (shared by every copy of this map)
 	uint32_t m_MapNumPlayers;
 	uint32_t m_MapNumTeams;
 	vector<CGameSlot> m_Slots;
 
 public:
 	CMap( CGHost *nGHost );
-	CMap( CGHost *nGHost, CConfig *CFG, string nCFGFile );
+	CMap( CGHost *nGHost, CConfig *CFG, string nCFGFile, string mapPath, string mapCFGPath );
 	~CMap( );
 
 	bool GetValid( )						{ return m_Valid; }
@@ -154,12 +262,12 @@ public:
 	uint32_t GetMapDefaultPlayerScore( )	{ return m_MapDefaultPlayerScore; }
 	string GetMapLocalPath( )				{ return m_MapLocalPath; }
 	bool GetMapLoadInGame( )				{ return m_MapLoadInGame; }
-	string *GetMapData( )					{ return &m_MapData; }
+	boost::shared_ptr<CMapData> GetMapData( )	{ return m_MapData; }
 	uint32_t GetMapNumPlayers( )			{ return m_MapNumPlayers; }
 	uint32_t GetMapNumTeams( )				{ return m_MapNumTeams; }
 	vector<CGameSlot> GetSlots( )			{ return m_Slots; }
 
-	void Load( CConfig *CFG, string nCFGFile );
+	void Load( CConfig *CFG, string nCFGFile, string mapPath, string mapCFGPath );
 	void CheckValid( );
 	uint32_t XORRotateLeft( unsigned char *data, uint32_t length );
 };
@@ -0,0 +1,427 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#include "ghost.h"
+#include "util.h"
+#include "mapcatalog.h"
+
+#include <boost/filesystem.hpp>
+
+#ifdef GHOST_INOTIFY
+ #include <errno.h>
+ #include <sys/inotify.h>
+ #include <unistd.h>
+#endif
+
+//
+// CMapCatalog
+//
+
+struct CMapCatalog :: CSuffixLess
+{
+	const vector<string> *m_Names;
+
+	CSuffixLess( const vector<string> *nNames ) : m_Names( nNames ) { }
+
+	const char *Suffix( const CSuffix &suffix ) const
+	{
+		return (*m_Names)[suffix.m_Entry].c_str( ) + suffix.m_Offset;
+	}
+
+	bool operator( )( const CSuffix &a, const CSuffix &b ) const
+	{
+		return strcmp( Suffix( a ), Suffix( b ) ) < 0;
+	}
+
+	bool operator( )( const CSuffix &a, const char *b ) const
+	{
+		return strcmp( Suffix( a ), b ) < 0;
+	}
+};
+
+struct CMapCatalog :: CSuffixFree
+{
+	const vector<string> *m_Names;
+
+	CSuffixFree( const vector<string> *nNames ) : m_Names( nNames ) { }
+
+	bool operator( )( const CSuffix &suffix ) const
+	{
+		return (*m_Names)[suffix.m_Entry].empty( );
+	}
+};
+
+CMapCatalog :: CMapCatalog( string nExtensions )
+{
+	stringstream SS( nExtensions );
+	string Extension;
+
+	while( SS >> Extension )
+		m_Extensions.push_back( Extension );
+
+	m_Exists = false;
+	m_LastScanTime = 0;
+	m_Notify = -1;
+	m_Watch = -1;
+}
+
+CMapCatalog :: ~CMapCatalog( )
+{
+	Unwatch( );
+
+#ifdef GHOST_INOTIFY
+	if( m_Notify != -1 )
+		close( m_Notify );
+#endif
+}
+
+void CMapCatalog :: SetPath( string nPath )
+{
+	if( nPath == m_Path && m_LastScanTime != 0 )
+		return;
+
+	Unwatch( );
+	m_Path = nPath;
+
+	m_Entries.clear( );
+	m_Suffixes.clear( );
+	m_Files.clear( );
+	m_Names.clear( );
+	m_FreeEntries.clear( );
+
+	uint32_t StartTicks = GetTicks( );
+	Watch( );
+	Rescan( );
+	BOOST_LOG_TRIVIAL(info) << "[MAPCATALOG] found " + UTIL_ToString( m_Entries.size( ) ) + " files in [" + m_Path + "] in " + UTIL_ToString( GetTicks( ) - StartTicks ) + " ms" + ( m_Watch == -1 ? ", rescanning every " + UTIL_ToString( MAPCATALOG_RESCAN_INTERVAL ) + " seconds" : string( ) );
+}
+
+void CMapCatalog :: Update( )
+{
+#ifdef GHOST_INOTIFY
+	if( m_Watch != -1 )
+	{
+		// the buffer is declared as uint64_t to get the alignment struct inotify_event needs
+
+		uint64_t Buffer[1024];
+		ssize_t Length;
+
+		while( ( Length = read( m_Notify, Buffer, sizeof( Buffer ) ) ) > 0 )
+		{
+			char *Data = (char *)Buffer;
+
+			for( ssize_t i = 0; i < Length; )
+			{
+				struct inotify_event *Event = (struct inotify_event *)( Data + i );
+				i += sizeof( struct inotify_event ) + Event->len;
+
+				if( Event->mask & IN_Q_OVERFLOW )
+				{
+					// we missed some events
+
+					Rescan( );
+				}
+				else if( Event->wd != m_Watch )
+				{
+					// left over from a watch we removed
+				}
+				else if( Event->mask & ( IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF ) )
+				{
+					// the directory itself is gone, fall back to rescanning until it's back
+
+					BOOST_LOG_TRIVIAL(info) << "[MAPCATALOG] stopped watching [" + m_Path + "], rescanning every " + UTIL_ToString( MAPCATALOG_RESCAN_INTERVAL ) + " seconds";
+					Unwatch( );
+					Rescan( );
+					return;
+				}
+				else if( Event->len > 0 && !( Event->mask & IN_ISDIR ) )
+				{
+					string File = Event->name;
+
+					if( Event->mask & ( IN_CREATE | IN_MOVED_TO ) )
+						Add( File );
+					else if( Event->mask & ( IN_DELETE | IN_MOVED_FROM ) )
+						Remove( File );
+				}
+			}
+		}
+
+		return;
+	}
+#endif
+
+	if( GetTime( ) - m_LastScanTime >= MAPCATALOG_RESCAN_INTERVAL )
+	{
+		Watch( );
+		Rescan( );
+	}
+}
+
+vector<string> CMapCatalog :: Find( string pattern )
+{
+	vector<string> Files;
+
+	if( pattern.empty( ) )
+	{
+		for( map<string, uint32_t> :: iterator i = m_Entries.begin( ); i != m_Entries.end( ); ++i )
+			Files.push_back( i->first );
+	}
+	else
+	{
+		transform( pattern.begin( ), pattern.end( ), pattern.begin( ), (int(*)(int))tolower );
+
+		// every suffix starting with the pattern is in one contiguous run starting at lower_bound
+
+		CSuffixLess Less( &m_Names );
+		vector<uint32_t> Matches;
+
+		for( vector<CSuffix> :: iterator i = lower_bound( m_Suffixes.begin( ), m_Suffixes.end( ), pattern.c_str( ), Less ); i != m_Suffixes.end( ); ++i )
+		{
+			if( strncmp( Less.Suffix( *i ), pattern.c_str( ), pattern.size( ) ) )
+				break;
+
+			Matches.push_back( i->m_Entry );
+		}
+
+		// a name containing the pattern more than once is matched once for each
+
+		sort( Matches.begin( ), Matches.end( ) );
+		Matches.erase( unique( Matches.begin( ), Matches.end( ) ), Matches.end( ) );
+
+		for( vector<uint32_t> :: iterator i = Matches.begin( ); i != Matches.end( ); ++i )
+			Files.push_back( m_Files[*i] );
+	}
+
+	// sort by name ignoring case
+
+	vector<pair<string, string> > Sorted;
+
+	for( vector<string> :: iterator i = Files.begin( ); i != Files.end( ); ++i )
+	{
+		string Name = *i;
+		transform( Name.begin( ), Name.end( ), Name.begin( ), (int(*)(int))tolower );
+		Sorted.push_back( make_pair( Name, *i ) );
+	}
+
+	sort( Sorted.begin( ), Sorted.end( ) );
+
+	for( uint32_t i = 0; i < Sorted.size( ); ++i )
+		Files[i] = Sorted[i].second;
+
+	return Files;
+}
+
+string CMapCatalog :: GetRandom( )
+{
+	if( m_Entries.empty( ) )
+		return string( );
+
+	// free entries are reused so there shouldn't be many holes, just try again when we hit one
+
+	while( true )
+	{
+		uint32_t Entry = rand( ) % m_Files.size( );
+
+		if( !m_Files[Entry].empty( ) )
+			return m_Files[Entry];
+	}
+}
+
+bool CMapCatalog :: Match( string file )
+{
+	transform( file.begin( ), file.end( ), file.begin( ), (int(*)(int))tolower );
+
+	for( vector<string> :: iterator i = m_Extensions.begin( ); i != m_Extensions.end( ); ++i )
+	{
+		if( file.size( ) > i->size( ) && file.compare( file.size( ) - i->size( ), i->size( ), *i ) == 0 )
+			return true;
+	}
+
+	return false;
+}
+
+void CMapCatalog :: Add( string file )
+{
+	uint32_t OldSize = m_Suffixes.size( );
+
+	if( Insert( file ) )
+		MergeSuffixes( OldSize );
+}
+
+bool CMapCatalog :: Insert( string file )
+{
+	if( !Match( file ) || m_Entries.find( file ) != m_Entries.end( ) )
+		return false;
+
+	uint32_t Entry;
+
+	if( m_FreeEntries.empty( ) )
+	{
+		Entry = m_Files.size( );
+		m_Files.push_back( string( ) );
+		m_Names.push_back( string( ) );
+	}
+	else
+	{
+		Entry = m_FreeEntries.back( );
+		m_FreeEntries.pop_back( );
+	}
+
+	string Name = file;
+	transform( Name.begin( ), Name.end( ), Name.begin( ), (int(*)(int))tolower );
+	m_Files[Entry] = file;
+	m_Names[Entry] = Name;
+	m_Entries[file] = Entry;
+
+	// append the new name's suffixes, they're left unsorted until MergeSuffixes is called
+
+	for( uint32_t i = 0; i < Name.size( ); ++i )
+	{
+		CSuffix Suffix;
+		Suffix.m_Entry = Entry;
+		Suffix.m_Offset = i;
+		m_Suffixes.push_back( Suffix );
+	}
+
+	return true;
+}
+
+void CMapCatalog :: MergeSuffixes( uint32_t sorted )
+{
+	// sort the suffixes appended after the first sorted suffixes and merge them into the suffix array
+
+	CSuffixLess Less( &m_Names );
+	sort( m_Suffixes.begin( ) + sorted, m_Suffixes.end( ), Less );
+	inplace_merge( m_Suffixes.begin( ), m_Suffixes.begin( ) + sorted, m_Suffixes.end( ), Less );
+}
+
+void CMapCatalog :: Remove( string file )
+{
+	map<string, uint32_t> :: iterator i = m_Entries.find( file );
+
+	if( i == m_Entries.end( ) )
+		return;
+
+	Erase( i );
+	m_Suffixes.erase( remove_if( m_Suffixes.begin( ), m_Suffixes.end( ), CSuffixFree( &m_Names ) ), m_Suffixes.end( ) );
+}
+
+void CMapCatalog :: Erase( map<string, uint32_t> :: iterator i )
+{
+	// the entry's suffixes are left in the suffix array, the caller removes every suffix of a free entry afterwards
+
+	uint32_t Entry = i->second;
+	m_Files[Entry].clear( );
+	m_Names[Entry].clear( );
+	m_FreeEntries.push_back( Entry );
+	m_Entries.erase( i );
+}
+
+void CMapCatalog :: Rescan( )
+{
+	m_LastScanTime = GetTime( );
+	set<string> Found;
+
+	// add every new file first and sort their suffixes all at once, sorting and merging after each file is quadratic in the number of files
+
+	uint32_t OldSize = m_Suffixes.size( );
+
+	try
+	{
+		m_Exists = !m_Path.empty( ) && boost::filesystem::is_directory( m_Path );
+
+		if( m_Exists )
+		{
+			boost::filesystem::directory_iterator EndIterator;
+
+			for( boost::filesystem::directory_iterator i( m_Path ); i != EndIterator; ++i )
+			{
+				if( !boost::filesystem::is_directory( i->status( ) ) )
+				{
+					string File = i->path( ).filename( ).string( );
+					Found.insert( File );
+					Insert( File );
+				}
+			}
+		}
+	}
+	catch( const exception &ex )
+	{
+		BOOST_LOG_TRIVIAL(info) << "[MAPCATALOG] error listing files in [" + m_Path + "] - caught exception [" + ex.what( ) + "]";
+		MergeSuffixes( OldSize );
+		return;
+	}
+
+	MergeSuffixes( OldSize );
+
+	// likewise remove the suffixes of every missing file in one pass
+
+	bool Removed = false;
+
+	for( map<string, uint32_t> :: iterator i = m_Entries.begin( ); i != m_Entries.end( ); )
+	{
+		if( Found.find( i->first ) == Found.end( ) )
+		{
+			Erase( i++ );
+			Removed = true;
+		}
+		else
+			++i;
+	}
+
+	if( Removed )
+		m_Suffixes.erase( remove_if( m_Suffixes.begin( ), m_Suffixes.end( ), CSuffixFree( &m_Names ) ), m_Suffixes.end( ) );
+}
+
+void CMapCatalog :: Watch( )
+{
+#ifdef GHOST_INOTIFY
+	if( m_Watch != -1 || m_Path.empty( ) )
+		return;
+
+	if( m_Notify == -1 )
+	{
+		m_Notify = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+
+		if( m_Notify == -1 )
+		{
+			BOOST_LOG_TRIVIAL(warning) << "[MAPCATALOG] unable to initialize inotify, error " + UTIL_ToString( errno );
+			return;
+		}
+	}
+
+	m_Watch = inotify_add_watch( m_Notify, m_Path.c_str( ), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR );
+
+	// the directory not existing (yet) isn't worth a warning, we'll try again on the next rescan
+
+	if( m_Watch == -1 && errno != ENOENT && errno != ENOTDIR )
+		BOOST_LOG_TRIVIAL(warning) << "[MAPCATALOG] unable to watch [" + m_Path + "], error " + UTIL_ToString( errno );
+#endif
+}
+
+void CMapCatalog :: Unwatch( )
+{
+#ifdef GHOST_INOTIFY
+	if( m_Watch != -1 )
+	{
+		inotify_rm_watch( m_Notify, m_Watch );
+		m_Watch = -1;
+	}
+#endif
+}
@@ -0,0 +1,94 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#ifndef MAPCATALOG_H
+#define MAPCATALOG_H
+
+#ifdef __linux__
+ #define GHOST_INOTIFY
+#endif
+
+// how often (in seconds) the directory is rescanned when it can't be watched
+
+#define MAPCATALOG_RESCAN_INTERVAL 60
+
+//
+// CMapCatalog
+//
+
+// an in memory list of the files in a directory (the maps or the map configs) so !map, !load and the random autohost map don't have to walk the directory every time
+// the names are indexed with a suffix array, every suffix of every lower case name in sorted order, so all the names containing a pattern are found with one binary search
+// on Linux the directory is watched with inotify and the catalog is updated as files come and go, elsewhere (or if the directory can't be watched) it's rescanned every MAPCATALOG_RESCAN_INTERVAL seconds
+// the catalog is only used from the main thread
+
+class CMapCatalog
+{
+private:
+	struct CSuffix
+	{
+		uint32_t m_Entry;					// index into m_Files and m_Names
+		uint32_t m_Offset;					// where the suffix starts in the entry's lower case name
+	};
+
+	struct CSuffixLess;
+	struct CSuffixFree;
+
+	string m_Path;
+	vector<string> m_Extensions;			// the lower case extensions of the files we want (e.g. ".w3x")
+	bool m_Exists;							// whether the directory existed when it was last scanned
+	vector<string> m_Files;					// the file names, an empty name is a free entry
+	vector<string> m_Names;					// the lower case file names
+	vector<uint32_t> m_FreeEntries;
+	map<string, uint32_t> m_Entries;		// file name to entry
+	vector<CSuffix> m_Suffixes;				// the suffix array
+	uint32_t m_LastScanTime;
+	int m_Notify;							// the inotify descriptor, -1 if not watching
+	int m_Watch;							// the inotify watch on m_Path, -1 if not watching
+
+public:
+	CMapCatalog( string nExtensions );
+	~CMapCatalog( );
+
+	string GetPath( )						{ return m_Path; }
+	bool GetExists( )						{ return m_Exists; }
+	uint32_t GetNumFiles( )					{ return m_Entries.size( ); }
+
+	void SetPath( string nPath );
+	void Update( );
+
+	// returns the file names (without the path) containing pattern, ignoring case and sorted by name
+	// an empty pattern returns every file
+
+	vector<string> Find( string pattern );
+	string GetRandom( );
+
+private:
+	bool Match( string file );
+	void Add( string file );
+	bool Insert( string file );
+	void MergeSuffixes( uint32_t sorted );
+	void Remove( string file );
+	void Erase( map<string, uint32_t> :: iterator i );
+	void Rescan( );
+	void Watch( );
+	void Unwatch( );
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#include "ghost.h"
+#include "util.h"
+#include "config.h"
+#include "gameslot.h"
+#include "map.h"
+#include "maploader.h"
+
+//
+// CMapLoad
+//
+
+CMapLoad :: CMapLoad( CConfig &nCFG, string nCFGFile, CBNET *nBNET, string nUser, bool nWhisper, bool nAutoHost, bool nWarm ) : m_CFG( nCFG ), m_CFGFile( nCFGFile ), m_BNET( nBNET ), m_User( nUser ), m_Whisper( nWhisper ), m_AutoHost( nAutoHost ), m_Warm( nWarm ), m_Map( NULL )
+{
+
+}
+
+CMapLoad :: ~CMapLoad( )
+{
+	delete m_Map;
+}
+
+//
+// CMapLoader
+//
+
+CMapLoader :: CMapLoader( CGHost *nGHost ) : m_GHost( nGHost ), m_NumPendingMaps( 0 ), m_Exiting( false ), m_Busy( false )
+{
+	m_Thread = new boost::thread( &CMapLoader :: loop, this );
+}
+
+CMapLoader :: ~CMapLoader( )
+{
+	{
+		boost::mutex::scoped_lock lock( m_Mutex );
+		m_Exiting = true;
+		m_Condition.notify_all( );
+	}
+
+	// the map being loaded right now (if any) is finished first, the rest are thrown away
+
+	m_Thread->join( );
+	delete m_Thread;
+
+	while( !m_Pending.empty( ) )
+	{
+		delete m_Pending.front( );
+		m_Pending.pop( );
+	}
+
+	while( !m_PendingWarm.empty( ) )
+	{
+		delete m_PendingWarm.front( );
+		m_PendingWarm.pop( );
+	}
+
+	while( !m_Finished.empty( ) )
+	{
+		delete m_Finished.front( );
+		m_Finished.pop( );
+	}
+}
+
+void CMapLoader :: Load( CMapLoad *load )
+{
+	// the loader thread must not read the paths from m_GHost since they can change while it's loading
+
+	load->m_MapPath = m_GHost->m_MapPath;
+	load->m_MapCFGPath = m_GHost->m_MapCFGPath;
+
+	boost::mutex::scoped_lock lock( m_Mutex );
+
+	if( load->m_Warm )
+		m_PendingWarm.push( load );
+	else
+		m_Pending.push( load );
+
+	if( !load->m_Warm && !load->m_AutoHost )
+		++m_NumPendingMaps;
+
+	m_Condition.notify_all( );
+}
+
+CMapLoad *CMapLoader :: GetFinished( )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+
+	if( m_Finished.empty( ) )
+		return NULL;
+
+	CMapLoad *Load = m_Finished.front( );
+	m_Finished.pop( );
+
+	if( !Load->m_Warm && !Load->m_AutoHost )
+		--m_NumPendingMaps;
+
+	return Load;
+}
+
+uint32_t CMapLoader :: GetNumPendingMaps( )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+	return m_NumPendingMaps;
+}
+
+void CMapLoader :: Wait( )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+
+	while( !m_Pending.empty( ) || m_Busy )
+		m_Condition.wait( lock );
+}
+
+void CMapLoader :: loop( )
+{
+	boost::mutex::scoped_lock lock( m_Mutex );
+
+	while( true )
+	{
+		while( m_Pending.empty( ) && m_PendingWarm.empty( ) && !m_Exiting )
+			m_Condition.wait( lock );
+
+		if( m_Exiting )
+			break;
+
+		CMapLoad *Load;
+
+		if( !m_Pending.empty( ) )
+		{
+			Load = m_Pending.front( );
+			m_Pending.pop( );
+		}
+		else
+		{
+			Load = m_PendingWarm.front( );
+			m_PendingWarm.pop( );
+		}
+
+		m_Busy = true;
+		lock.unlock( );
+
+		uint32_t StartTicks = GetTicks( );
+		Load->m_Map = new CMap( m_GHost, &Load->m_CFG, Load->m_CFGFile, Load->m_MapPath, Load->m_MapCFGPath );
+		BOOST_LOG_TRIVIAL(info) << "[MAPLOADER] loaded [" + Load->m_CFGFile + "] in " + UTIL_ToString( GetTicks( ) - StartTicks ) + " ms";
+
+		lock.lock( );
+		m_Busy = false;
+		m_Finished.push( Load );
+		m_Condition.notify_all( );
+	}
+}
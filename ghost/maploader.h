@@ -0,0 +1,91 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#ifndef MAPLOADER_H
+#define MAPLOADER_H
+
+class CBNET;
+class CMap;
+
+//
+// CMapLoad
+//
+
+// a request to load a map on the map loader thread
+// the main thread fills in everything except the paths and m_Map and hands it to the map loader, it gets it back from GetFinished once m_Map has been loaded
+
+class CMapLoad
+{
+public:
+	CConfig m_CFG;							// the map config (read from a map config file or created in memory for a map file)
+	string m_CFGFile;
+	CBNET *m_BNET;							// the battle.net connection to report back to, NULL if no user asked for this map
+	string m_User;
+	bool m_Whisper;
+	bool m_AutoHost;						// true if this is the next map to autohost rather than the current map
+	bool m_Warm;							// true if this map is only loaded to keep its data open (bot_warmmaps)
+	string m_MapPath;						// bot_mappath and bot_mapcfgpath when the load was queued, the main thread changes them on !reload
+	string m_MapCFGPath;
+	CMap *m_Map;							// the loaded map (owned by the load until the main thread takes it)
+
+	CMapLoad( CConfig &nCFG, string nCFGFile, CBNET *nBNET, string nUser, bool nWhisper, bool nAutoHost, bool nWarm = false );
+	~CMapLoad( );
+};
+
+//
+// CMapLoader
+//
+
+// loads maps on a background thread so reading, hashing, and parsing a large map never stalls the main loop (battle.net, GProxy++ reconnects, autohost)
+// maps are loaded one at a time in the order they were requested except that warm maps (bot_warmmaps) are only loaded when no other map is waiting
+// otherwise a !map or the next autohost map requested right after starting would have to wait for every warm map to be read and hashed first
+
+class CMapLoader
+{
+public:
+	CGHost *m_GHost;
+
+private:
+	queue<CMapLoad *> m_Pending;			// loads waiting for the loader thread
+	queue<CMapLoad *> m_PendingWarm;		// warm loads waiting for the loader thread, these go after everything in m_Pending
+	queue<CMapLoad *> m_Finished;			// loads waiting for the main thread
+	uint32_t m_NumPendingMaps;				// user loads (not warm or autohost maps) that haven't been returned by GetFinished yet
+	boost::mutex m_Mutex;					// mutex for everything below
+	boost::condition_variable m_Condition;	// signalled when a load is queued or finished
+	boost::thread *m_Thread;
+	bool m_Exiting;
+	bool m_Busy;							// true while the loader thread is loading a map
+
+public:
+	CMapLoader( CGHost *nGHost );
+	~CMapLoader( );
+
+	// called from the main thread
+
+	void Load( CMapLoad *load );
+	CMapLoad *GetFinished( );
+	uint32_t GetNumPendingMaps( );
+	void Wait( );
+
+private:
+	void loop( );
+};
+
+#endif
@@ -0,0 +1,519 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#include "ghost.h"
+#include "util.h"
+#include "socket.h"
+#include "reactor.h"
+
+#include <string.h>
+
+#ifndef WIN32
+ #include <fcntl.h>
+#endif
+
+//
+// CSocketReactor
+//
+
+CSocketReactor :: CSocketReactor( )
+{
+
+}
+
+CSocketReactor :: ~CSocketReactor( )
+{
+	// detach any sockets which are still registered so they don't try to remove themselves from a deleted reactor later
+
+	for( set<CSocket *> :: iterator i = m_Sockets.begin( ); i != m_Sockets.end( ); ++i )
+	{
+		(*i)->SetReactor( NULL );
+		(*i)->SetReadable( false );
+		(*i)->SetWritable( true );
+		(*i)->SetWantWrite( false );
+	}
+}
+
+CSocketReactor *CSocketReactor :: Create( string type )
+{
+#ifdef GHOST_EPOLL
+	if( type != "select" )
+	{
+		CEPollReactor *Reactor = new CEPollReactor( );
+
+		if( Reactor->GetValid( ) )
+			return Reactor;
+
+		BOOST_LOG_TRIVIAL(warning) << "[REACTOR] unable to create epoll reactor, falling back to select";
+		delete Reactor;
+	}
+#else
+	if( type == "epoll" )
+		BOOST_LOG_TRIVIAL(warning) << "[REACTOR] epoll is not supported on this platform, falling back to select";
+#endif
+
+	return new CSelectReactor( );
+}
+
+bool CSocketReactor :: Add( CSocket *socket )
+{
+	if( !socket || socket->GetFD( ) == INVALID_SOCKET )
+		return false;
+
+	if( socket->GetReactor( ) == this )
+		return true;
+
+	if( socket->GetReactor( ) )
+		socket->GetReactor( )->Remove( socket );
+
+	// if the socket can't be registered it keeps working without a reactor, it's just polled on every loop like it's always ready
+
+	if( !AddFD( socket ) )
+		return false;
+
+	m_Sockets.insert( socket );
+	socket->SetReactor( this );
+	socket->SetReadable( false );
+	socket->SetWritable( true );
+	socket->SetWantWrite( false );
+	return true;
+}
+
+void CSocketReactor :: Remove( CSocket *socket )
+{
+	if( !socket || socket->GetReactor( ) != this )
+		return;
+
+	RemoveFD( socket );
+	m_Sockets.erase( socket );
+
+	vector<CSocket *> :: iterator i = find( m_Ready.begin( ), m_Ready.end( ), socket );
+
+	if( i != m_Ready.end( ) )
+		m_Ready.erase( i );
+
+	socket->SetReactor( NULL );
+	socket->SetReadable( false );
+	socket->SetWritable( true );
+	socket->SetWantWrite( false );
+}
+
+void CSocketReactor :: WantWrite( CSocket *socket, bool wantWrite )
+{
+	if( !socket || socket->GetReactor( ) != this || socket->GetWantWrite( ) == wantWrite )
+		return;
+
+	ModifyFD( socket, wantWrite );
+	socket->SetWantWrite( wantWrite );
+}
+
+int CSocketReactor :: WaitUntil( uint32_t deadline )
+{
+	// block until a socket is ready or GetTicks reaches deadline, whichever comes first
+	// this only has the resolution of GetTicks so it can wake up to a millisecond late, reactors which can wait for an absolute time override it
+
+	uint32_t Ticks = GetTicks( );
+	return Wait( (int32_t)( deadline - Ticks ) > 0 ? (long)( deadline - Ticks ) * 1000 : 0 );
+}
+
+void CSocketReactor :: MarkReady( CSocket *socket, bool readable, bool writable )
+{
+	if( readable && !socket->GetReadable( ) )
+	{
+		socket->SetReadable( true );
+		m_Ready.push_back( socket );
+	}
+
+	if( writable && socket->GetWantWrite( ) )
+	{
+		socket->SetWritable( true );
+		WantWrite( socket, false );
+	}
+}
+
+void CSocketReactor :: ClearReady( )
+{
+	for( vector<CSocket *> :: iterator i = m_Ready.begin( ); i != m_Ready.end( ); ++i )
+		(*i)->SetReadable( false );
+
+	m_Ready.clear( );
+}
+
+//
+// CSelectReactor
+//
+
+CSelectReactor :: CSelectReactor( ) : CSocketReactor( )
+{
+#ifndef WIN32
+	if( pipe( m_WakePipe ) == -1 )
+	{
+		BOOST_LOG_TRIVIAL(warning) << "[REACTOR] error (pipe) - " + string( strerror( errno ) ) + ", waking the reactor from another thread won't work";
+		m_WakePipe[0] = -1;
+		m_WakePipe[1] = -1;
+	}
+	else
+	{
+		for( int i = 0; i < 2; ++i )
+		{
+			fcntl( m_WakePipe[i], F_SETFL, fcntl( m_WakePipe[i], F_GETFL ) | O_NONBLOCK );
+			fcntl( m_WakePipe[i], F_SETFD, FD_CLOEXEC );
+		}
+	}
+#endif
+}
+
+CSelectReactor :: ~CSelectReactor( )
+{
+#ifndef WIN32
+	if( m_WakePipe[0] != -1 )
+	{
+		close( m_WakePipe[0] );
+		close( m_WakePipe[1] );
+	}
+#endif
+}
+
+bool CSelectReactor :: AddFD( CSocket *socket )
+{
+#ifdef WIN32
+	if( m_Sockets.size( ) >= FD_SETSIZE )
+#else
+	if( socket->GetFD( ) >= FD_SETSIZE )
+#endif
+	{
+		BOOST_LOG_TRIVIAL(warning) << "[REACTOR] unable to register socket with select reactor, FD_SETSIZE (" + UTIL_ToString( FD_SETSIZE ) + ") exceeded";
+		return false;
+	}
+
+	return true;
+}
+
+void CSelectReactor :: RemoveFD( CSocket * )
+{
+
+}
+
+void CSelectReactor :: ModifyFD( CSocket *, bool )
+{
+
+}
+
+int CSelectReactor :: Wait( long usecBlock )
+{
+	ClearReady( );
+
+#ifdef WIN32
+	// we can't be woken up so don't sleep for long
+
+	if( usecBlock > SELECT_WAKE_INTERVAL * 1000 )
+		usecBlock = SELECT_WAKE_INTERVAL * 1000;
+
+	if( m_Sockets.empty( ) )
+	{
+		// select will return immediately on some platforms if there aren't any sockets and we'll chew up the CPU so just sleep instead
+
+		MILLISLEEP( usecBlock / 1000 );
+		return 0;
+	}
+#else
+	if( m_Sockets.empty( ) && m_WakePipe[0] == -1 )
+	{
+		MILLISLEEP( usecBlock / 1000 );
+		return 0;
+	}
+#endif
+
+	int nfds = 0;
+	fd_set fd;
+	fd_set send_fd;
+	FD_ZERO( &fd );
+	FD_ZERO( &send_fd );
+
+#ifndef WIN32
+	if( m_WakePipe[0] != -1 )
+	{
+		FD_SET( m_WakePipe[0], &fd );
+		nfds = m_WakePipe[0];
+	}
+#endif
+
+	for( set<CSocket *> :: iterator i = m_Sockets.begin( ); i != m_Sockets.end( ); ++i )
+	{
+		FD_SET( (*i)->GetFD( ), &fd );
+
+		if( (*i)->GetWantWrite( ) )
+			FD_SET( (*i)->GetFD( ), &send_fd );
+
+#ifndef WIN32
+		if( (*i)->GetFD( ) > nfds )
+			nfds = (*i)->GetFD( );
+#endif
+	}
+
+	struct timeval tv;
+	tv.tv_sec = usecBlock / 1000000;
+	tv.tv_usec = usecBlock % 1000000;
+
+#ifdef WIN32
+	int Ready = select( 1, &fd, &send_fd, NULL, &tv );
+#else
+	int Ready = select( nfds + 1, &fd, &send_fd, NULL, &tv );
+#endif
+
+	if( Ready <= 0 )
+		return 0;
+
+#ifndef WIN32
+	if( m_WakePipe[0] != -1 && FD_ISSET( m_WakePipe[0], &fd ) )
+	{
+		// empty the pipe so it doesn't stay readable, any number of Wake calls only wake us up once
+
+		char Buffer[64];
+
+		while( read( m_WakePipe[0], Buffer, sizeof( Buffer ) ) > 0 )
+			;
+
+		--Ready;
+	}
+#endif
+
+	for( set<CSocket *> :: iterator i = m_Sockets.begin( ); i != m_Sockets.end( ); ++i )
+		MarkReady( *i, FD_ISSET( (*i)->GetFD( ), &fd ) ? true : false, FD_ISSET( (*i)->GetFD( ), &send_fd ) ? true : false );
+
+	return Ready;
+}
+
+void CSelectReactor :: Wake( )
+{
+#ifndef WIN32
+	// if the pipe is full the reactor is going to wake up anyway
+
+	if( m_WakePipe[1] != -1 )
+	{
+		char Byte = 0;
+
+		if( write( m_WakePipe[1], &Byte, 1 ) == -1 && errno != EAGAIN )
+			BOOST_LOG_TRIVIAL(warning) << "[REACTOR] error (wake pipe write) - " + string( strerror( errno ) );
+	}
+#endif
+}
+
+#ifdef GHOST_EPOLL
+
+//
+// CEPollReactor
+//
+
+CEPollReactor :: CEPollReactor( ) : CSocketReactor( ), m_EPoll( epoll_create1( EPOLL_CLOEXEC ) ), m_TimerFD( -1 ), m_WakeFD( -1 )
+{
+	if( m_EPoll == -1 )
+		BOOST_LOG_TRIVIAL(warning) << "[REACTOR] error (epoll_create) - " + string( strerror( errno ) );
+	else
+	{
+		// the timerfd is registered with a NULL pointer so Wait can tell it apart from the sockets
+
+		m_TimerFD = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+
+		if( m_TimerFD == -1 )
+			BOOST_LOG_TRIVIAL(warning) << "[REACTOR] error (timerfd_create) - " + string( strerror( errno ) ) + ", deadlines will only have millisecond resolution";
+		else
+		{
+			struct epoll_event Event;
+			memset( &Event, 0, sizeof( Event ) );
+			Event.events = EPOLLIN;
+			Event.data.ptr = NULL;
+
+			if( epoll_ctl( m_EPoll, EPOLL_CTL_ADD, m_TimerFD, &Event ) == -1 )
+			{
+				BOOST_LOG_TRIVIAL(warning) << "[REACTOR] error (epoll_ctl add timerfd) - " + string( strerror( errno ) ) + ", deadlines will only have millisecond resolution";
+				close( m_TimerFD );
+				m_TimerFD = -1;
+			}
+		}
+
+		// the eventfd is registered with a pointer to m_WakeFD for the same reason
+
+		m_WakeFD = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+		if( m_WakeFD == -1 )
+			BOOST_LOG_TRIVIAL(warning) << "[REACTOR] error (eventfd) - " + string( strerror( errno ) ) + ", waking the reactor from another thread won't work";
+		else
+		{
+			struct epoll_event Event;
+			memset( &Event, 0, sizeof( Event ) );
+			Event.events = EPOLLIN;
+			Event.data.ptr = &m_WakeFD;
+
+			if( epoll_ctl( m_EPoll, EPOLL_CTL_ADD, m_WakeFD, &Event ) == -1 )
+			{
+				BOOST_LOG_TRIVIAL(warning) << "[REACTOR] error (epoll_ctl add eventfd) - " + string( strerror( errno ) ) + ", waking the reactor from another thread won't work";
+				close( m_WakeFD );
+				m_WakeFD = -1;
+			}
+		}
+	}
+
+	m_Events.resize( 64 );
+}
+
+CEPollReactor :: ~CEPollReactor( )
+{
+	if( m_TimerFD != -1 )
+		close( m_TimerFD );
+
+	if( m_WakeFD != -1 )
+		close( m_WakeFD );
+
+	if( m_EPoll != -1 )
+		close( m_EPoll );
+}
+
+bool CEPollReactor :: AddFD( CSocket *socket )
+{
+	struct epoll_event Event;
+	memset( &Event, 0, sizeof( Event ) );
+	Event.events = EPOLLIN;
+	Event.data.ptr = socket;
+
+	if( epoll_ctl( m_EPoll, EPOLL_CTL_ADD, socket->GetFD( ), &Event ) == -1 )
+	{
+		BOOST_LOG_TRIVIAL(warning) << "[REACTOR] error (epoll_ctl add) - " + string( strerror( errno ) );
+		return false;
+	}
+
+	return true;
+}
+
+void CEPollReactor :: RemoveFD( CSocket *socket )
+{
+	// kernels before 2.6.9 require a non-null event pointer even though it's ignored
+
+	struct epoll_event Event;
+	memset( &Event, 0, sizeof( Event ) );
+	epoll_ctl( m_EPoll, EPOLL_CTL_DEL, socket->GetFD( ), &Event );
+}
+
+void CEPollReactor :: ModifyFD( CSocket *socket, bool wantWrite )
+{
+	struct epoll_event Event;
+	memset( &Event, 0, sizeof( Event ) );
+	Event.events = wantWrite ? ( EPOLLIN | EPOLLOUT ) : EPOLLIN;
+	Event.data.ptr = socket;
+
+	if( epoll_ctl( m_EPoll, EPOLL_CTL_MOD, socket->GetFD( ), &Event ) == -1 )
+		BOOST_LOG_TRIVIAL(warning) << "[REACTOR] error (epoll_ctl mod) - " + string( strerror( errno ) );
+}
+
+int CEPollReactor :: Wait( long usecBlock )
+{
+	ClearReady( );
+
+	// epoll only has millisecond resolution, round up so we never wake up before a deadline
+
+	int Ready = epoll_wait( m_EPoll, &m_Events[0], m_Events.size( ), ( usecBlock + 999 ) / 1000 );
+
+	if( Ready <= 0 )
+		return 0;
+
+	int Sockets = Ready;
+
+	for( int i = 0; i < Ready; ++i )
+	{
+		if( !m_Events[i].data.ptr )
+		{
+			// the timerfd expired, read the expiration count so it doesn't stay readable
+
+			uint64_t Expirations;
+
+			if( read( m_TimerFD, &Expirations, sizeof( Expirations ) ) == -1 && errno != EAGAIN )
+				BOOST_LOG_TRIVIAL(warning) << "[REACTOR] error (timerfd read) - " + string( strerror( errno ) );
+
+			--Sockets;
+			continue;
+		}
+
+		if( m_Events[i].data.ptr == &m_WakeFD )
+		{
+			// Wake was called, reading the eventfd resets its counter no matter how many times it was called
+
+			uint64_t Wakes;
+
+			if( read( m_WakeFD, &Wakes, sizeof( Wakes ) ) == -1 && errno != EAGAIN )
+				BOOST_LOG_TRIVIAL(warning) << "[REACTOR] error (eventfd read) - " + string( strerror( errno ) );
+
+			--Sockets;
+			continue;
+		}
+
+		uint32_t Events = m_Events[i].events;
+		MarkReady( (CSocket *)m_Events[i].data.ptr, ( Events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) ) ? true : false, ( Events & ( EPOLLOUT | EPOLLHUP | EPOLLERR ) ) ? true : false );
+	}
+
+	// every event slot was used so there may be more events waiting, make room for them next time
+
+	if( Ready == (int)m_Events.size( ) )
+		m_Events.resize( m_Events.size( ) * 2 );
+
+	return Sockets;
+}
+
+int CEPollReactor :: WaitUntil( uint32_t deadline )
+{
+	if( m_TimerFD == -1 )
+		return CSocketReactor :: WaitUntil( deadline );
+
+	// GetTicks is CLOCK_MONOTONIC in milliseconds truncated to 32 bits so the deadline is turned back into a full CLOCK_MONOTONIC time relative to now
+	// arming the timerfd again also clears an expiration left over from the last wait if a socket woke us up first
+
+	struct timespec Now;
+	clock_gettime( CLOCK_MONOTONIC, &Now );
+	uint64_t NowTicks = (uint64_t)Now.tv_sec * 1000 + Now.tv_nsec / 1000000;
+	int32_t Remaining = (int32_t)( deadline - (uint32_t)NowTicks );
+
+	if( Remaining <= 0 )
+		return Wait( 0 );
+
+	uint64_t Deadline = NowTicks + Remaining;
+	struct itimerspec Timer;
+	memset( &Timer, 0, sizeof( Timer ) );
+	Timer.it_value.tv_sec = Deadline / 1000;
+	Timer.it_value.tv_nsec = ( Deadline % 1000 ) * 1000000;
+
+	if( timerfd_settime( m_TimerFD, TFD_TIMER_ABSTIME, &Timer, NULL ) == -1 )
+		return CSocketReactor :: WaitUntil( deadline );
+
+	// the timerfd wakes us up at the deadline, the epoll_wait timeout is only a backstop
+
+	return Wait( ( Remaining + 1 ) * 1000 );
+}
+
+void CEPollReactor :: Wake( )
+{
+	if( m_WakeFD == -1 )
+		return;
+
+	uint64_t One = 1;
+
+	if( write( m_WakeFD, &One, sizeof( One ) ) == -1 && errno != EAGAIN )
+		BOOST_LOG_TRIVIAL(warning) << "[REACTOR] error (eventfd write) - " + string( strerror( errno ) );
+}
+
+#endif
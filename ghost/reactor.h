@@ -0,0 +1,134 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#ifdef __linux__
+ #define GHOST_EPOLL
+ #include <sys/epoll.h>
+ #include <sys/eventfd.h>
+ #include <sys/timerfd.h>
+#endif
+
+class CSocket;
+
+//
+// CSocketReactor
+//
+
+// a reactor owns the readiness state of every socket belonging to one update loop (the main loop or a game loop)
+// sockets are registered once when they become usable (listening, accepted, or connected) instead of being thrown into a giant select statement on every loop
+// after Wait returns every socket which received an event has been flagged, see CSocket :: GetReadable and CSocket :: GetWritable
+// sockets are considered writable until a send would block, only then do we ask the reactor to tell us when they drain
+// Wake is the only function which may be called from another thread, it makes the current (or next) Wait return right away
+
+class CSocketReactor
+{
+protected:
+	set<CSocket *> m_Sockets;				// all registered sockets
+	vector<CSocket *> m_Ready;				// sockets flagged readable by the last Wait, cleared at the start of the next Wait
+
+	virtual bool AddFD( CSocket *socket ) = 0;
+	virtual void RemoveFD( CSocket *socket ) = 0;
+	virtual void ModifyFD( CSocket *socket, bool wantWrite ) = 0;
+	void MarkReady( CSocket *socket, bool readable, bool writable );
+	void ClearReady( );
+
+public:
+	CSocketReactor( );
+	virtual ~CSocketReactor( );
+
+	static CSocketReactor *Create( string type );
+
+	virtual string GetName( ) = 0;
+	virtual unsigned int GetNumSockets( )		{ return m_Sockets.size( ); }
+	virtual bool Add( CSocket *socket );
+	virtual void Remove( CSocket *socket );
+	virtual void WantWrite( CSocket *socket, bool wantWrite );
+	virtual int Wait( long usecBlock ) = 0;
+	virtual int WaitUntil( uint32_t deadline );
+	virtual void Wake( ) = 0;
+};
+
+//
+// CSelectReactor
+//
+
+// the portable fallback, this rebuilds the fd_sets on every Wait and is limited by FD_SETSIZE
+// Wake writes to a pipe which is always in the read set, on Windows select only takes sockets so there Wait never blocks for more than SELECT_WAKE_INTERVAL ms instead
+
+#define SELECT_WAKE_INTERVAL 50
+
+class CSelectReactor : public CSocketReactor
+{
+protected:
+#ifndef WIN32
+	int m_WakePipe[2];						// Wake writes to m_WakePipe[1] and Wait watches m_WakePipe[0], both -1 if the pipe couldn't be created
+#endif
+
+	virtual bool AddFD( CSocket *socket );
+	virtual void RemoveFD( CSocket *socket );
+	virtual void ModifyFD( CSocket *socket, bool wantWrite );
+
+public:
+	CSelectReactor( );
+	virtual ~CSelectReactor( );
+
+	virtual string GetName( )					{ return "select"; }
+	virtual int Wait( long usecBlock );
+	virtual void Wake( );
+};
+
+#ifdef GHOST_EPOLL
+
+//
+// CEPollReactor
+//
+
+// the epoll reactor also owns a timerfd so WaitUntil wakes up right at the deadline instead of up to a millisecond late (epoll_wait only takes whole milliseconds)
+// and an eventfd for Wake
+
+class CEPollReactor : public CSocketReactor
+{
+protected:
+	int m_EPoll;
+	int m_TimerFD;							// CLOCK_MONOTONIC timerfd armed with the deadline passed to WaitUntil, -1 if it couldn't be created
+	int m_WakeFD;							// eventfd written to by Wake, -1 if it couldn't be created
+	vector<struct epoll_event> m_Events;
+
+	virtual bool AddFD( CSocket *socket );
+	virtual void RemoveFD( CSocket *socket );
+	virtual void ModifyFD( CSocket *socket, bool wantWrite );
+
+public:
+	CEPollReactor( );
+	virtual ~CEPollReactor( );
+
+	virtual string GetName( )					{ return "epoll"; }
+	virtual bool GetValid( )					{ return m_EPoll != -1; }
+	virtual int Wait( long usecBlock );
+	virtual int WaitUntil( uint32_t deadline );
+	virtual void Wake( );
+};
+
+#endif
+
+#endif
@@ -60,52 +60,31 @@ void CReplay :: AddLeaveGameDuringLoading( uint32_t reason, unsigned char PID, u
 	m_LoadingBlocks.push( Block );
 }
 
-void CReplay :: AddTimeSlot2( queue<CIncomingAction *> actions )
+void CReplay :: AddTimeSlot2( const unsigned char *actions, uint32_t length )
 {
-	BYTEARRAY Block;
-	Block.push_back( REPLAY_TIMESLOT2 );
-	UTIL_AppendByteArray( Block, (uint16_t)0, false );
-	UTIL_AppendByteArray( Block, (uint16_t)0, false );
-
-	while( !actions.empty( ) )
-	{
-		CIncomingAction *Action = actions.front( );
-		actions.pop( );
-		Block.push_back( Action->GetPID( ) );
-		UTIL_AppendByteArray( Block, (uint16_t)Action->GetAction( )->size( ), false );
-		UTIL_AppendByteArrayFast( Block, *Action->GetAction( ) );
-	}
-
-	// assign length
-
-	BYTEARRAY LengthBytes = UTIL_CreateByteArray( (uint16_t)( Block.size( ) - 3 ), false );
-	Block[1] = LengthBytes[0];
-	Block[2] = LengthBytes[1];
-	m_CompiledBlocks += string( Block.begin( ), Block.end( ) );
+	// the actions are already encoded the same way as in the W3GS_INCOMING_ACTION2 packet (see CGameProtocol :: EncodeIncomingActions)
+
+	m_CompiledBlocks.push_back( REPLAY_TIMESLOT2 );
+	m_CompiledBlocks.push_back( (char)( length + 2 ) );
+	m_CompiledBlocks.push_back( (char)( ( length + 2 ) >> 8 ) );
+	m_CompiledBlocks.push_back( 0 );
+	m_CompiledBlocks.push_back( 0 );
+	m_CompiledBlocks.append( (const char *)actions, length );
 }
 
-void CReplay :: AddTimeSlot( uint16_t timeIncrement, queue<CIncomingAction *> actions )
+void CReplay :: AddTimeSlot( uint16_t timeIncrement, const unsigned char *actions, uint32_t length )
 {
-	BYTEARRAY Block;
-	Block.push_back( REPLAY_TIMESLOT );
-	UTIL_AppendByteArray( Block, (uint16_t)0, false );
-	UTIL_AppendByteArray( Block, timeIncrement, false );
+	// the actions are already encoded the same way as in the W3GS_INCOMING_ACTION packet (see CGameProtocol :: EncodeIncomingActions)
 
-	while( !actions.empty( ) )
-	{
-		CIncomingAction *Action = actions.front( );
-		actions.pop( );
-		Block.push_back( Action->GetPID( ) );
-		UTIL_AppendByteArray( Block, (uint16_t)Action->GetAction( )->size( ), false );
-		UTIL_AppendByteArrayFast( Block, *Action->GetAction( ) );
-	}
+	m_CompiledBlocks.push_back( REPLAY_TIMESLOT );
+	m_CompiledBlocks.push_back( (char)( length + 2 ) );
+	m_CompiledBlocks.push_back( (char)( ( length + 2 ) >> 8 ) );
+	m_CompiledBlocks.push_back( (char)timeIncrement );
+	m_CompiledBlocks.push_back( (char)( timeIncrement >> 8 ) );
 
-	// assign length
+	if( length > 0 )
+		m_CompiledBlocks.append( (const char *)actions, length );
 
-	BYTEARRAY LengthBytes = UTIL_CreateByteArray( (uint16_t)( Block.size( ) - 3 ), false );
-	Block[1] = LengthBytes[0];
-	Block[2] = LengthBytes[1];
-	m_CompiledBlocks += string( Block.begin( ), Block.end( ) );
 	m_ReplayLength += timeIncrement;
 }
 
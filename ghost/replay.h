@@ -27,7 +27,6 @@
 // CReplay
 //
 
-class CIncomingAction;
 
 class CReplay : public CPacked
 {
@@ -91,8 +90,8 @@ public:
 
 	void AddLeaveGame( uint32_t reason, unsigned char PID, uint32_t result );
 	void AddLeaveGameDuringLoading( uint32_t reason, unsigned char PID, uint32_t result );
-	void AddTimeSlot2( queue<CIncomingAction *> actions );
-	void AddTimeSlot( uint16_t timeIncrement, queue<CIncomingAction *> actions );
+	void AddTimeSlot2( const unsigned char *actions, uint32_t length );
+	void AddTimeSlot( uint16_t timeIncrement, const unsigned char *actions, uint32_t length );
 	void AddChatMessage( unsigned char PID, unsigned char flags, uint32_t chatMode, string message );
 	void AddLoadingBlock( BYTEARRAY &loadingBlock );
 	void BuildReplay( string gameName, string statString, uint32_t war3Version, uint16_t buildNumber );
@@ -19,9 +19,261 @@
 
 #include "sha1.h"
 
+#ifdef SHA1_SHANI
+ #ifdef _MSC_VER
+  #include <intrin.h>
+ #else
+  #include <cpuid.h>
+ #endif
+
+ #include <emmintrin.h>
+ #include <tmmintrin.h>
+ #include <smmintrin.h>
+ #include <immintrin.h>
+
+ #ifdef __GNUC__
+  #define SHA1_SHANI_TARGET __attribute__(( target("sha,ssse3,sse4.1") ))
+ #else
+  #define SHA1_SHANI_TARGET
+ #endif
+
+// SHA-1 transformation using the SHA extensions, four rounds per instruction
+// the message schedule for rounds 16-79 is built in place in MSG0-MSG3 (sha1msg1, xor, sha1msg2) while the rounds run
+
+SHA1_SHANI_TARGET static void TransformSHANI(uint32_t state[5], unsigned char *data, uint32_t blocks)
+{
+	const __m128i MASK = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+	__m128i ABCD, ABCD_SAVE, E0, E0_SAVE, E1;
+	__m128i MSG0, MSG1, MSG2, MSG3;
+
+	ABCD = _mm_shuffle_epi32(_mm_loadu_si128((__m128i *)state), 0x1B);
+	E0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+	for (; blocks > 0; --blocks, data += 64)
+	{
+		ABCD_SAVE = ABCD;
+		E0_SAVE = E0;
+
+		// rounds 0-3
+
+		MSG0 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *)(data + 0)), MASK);
+		E0 = _mm_add_epi32(E0, MSG0);
+		E1 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+
+		// rounds 4-7
+
+		MSG1 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *)(data + 16)), MASK);
+		E1 = _mm_sha1nexte_epu32(E1, MSG1);
+		E0 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 0);
+		MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+
+		// rounds 8-11
+
+		MSG2 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *)(data + 32)), MASK);
+		E0 = _mm_sha1nexte_epu32(E0, MSG2);
+		E1 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+		MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+		MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+		// rounds 12-15
+
+		MSG3 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *)(data + 48)), MASK);
+		E1 = _mm_sha1nexte_epu32(E1, MSG3);
+		E0 = ABCD;
+		MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 0);
+		MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+		MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+		// rounds 16-19
+
+		E0 = _mm_sha1nexte_epu32(E0, MSG0);
+		E1 = ABCD;
+		MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+		MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+		MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+		// rounds 20-23
+
+		E1 = _mm_sha1nexte_epu32(E1, MSG1);
+		E0 = ABCD;
+		MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 1);
+		MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+		MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+		// rounds 24-27
+
+		E0 = _mm_sha1nexte_epu32(E0, MSG2);
+		E1 = ABCD;
+		MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 1);
+		MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+		MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+		// rounds 28-31
+
+		E1 = _mm_sha1nexte_epu32(E1, MSG3);
+		E0 = ABCD;
+		MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 1);
+		MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+		MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+		// rounds 32-35
+
+		E0 = _mm_sha1nexte_epu32(E0, MSG0);
+		E1 = ABCD;
+		MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 1);
+		MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+		MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+		// rounds 36-39
+
+		E1 = _mm_sha1nexte_epu32(E1, MSG1);
+		E0 = ABCD;
+		MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 1);
+		MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+		MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+		// rounds 40-43
+
+		E0 = _mm_sha1nexte_epu32(E0, MSG2);
+		E1 = ABCD;
+		MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 2);
+		MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+		MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+		// rounds 44-47
+
+		E1 = _mm_sha1nexte_epu32(E1, MSG3);
+		E0 = ABCD;
+		MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 2);
+		MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+		MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+		// rounds 48-51
+
+		E0 = _mm_sha1nexte_epu32(E0, MSG0);
+		E1 = ABCD;
+		MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 2);
+		MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+		MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+		// rounds 52-55
+
+		E1 = _mm_sha1nexte_epu32(E1, MSG1);
+		E0 = ABCD;
+		MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 2);
+		MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+		MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+		// rounds 56-59
+
+		E0 = _mm_sha1nexte_epu32(E0, MSG2);
+		E1 = ABCD;
+		MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 2);
+		MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+		MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+		// rounds 60-63
+
+		E1 = _mm_sha1nexte_epu32(E1, MSG3);
+		E0 = ABCD;
+		MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+		MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+		MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+		// rounds 64-67
+
+		E0 = _mm_sha1nexte_epu32(E0, MSG0);
+		E1 = ABCD;
+		MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 3);
+		MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+		MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+		// rounds 68-71
+
+		E1 = _mm_sha1nexte_epu32(E1, MSG1);
+		E0 = ABCD;
+		MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+		MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+		// rounds 72-75
+
+		E0 = _mm_sha1nexte_epu32(E0, MSG2);
+		E1 = ABCD;
+		MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 3);
+
+		// rounds 76-79
+
+		E1 = _mm_sha1nexte_epu32(E1, MSG3);
+		E0 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+
+		E0 = _mm_sha1nexte_epu32(E0, E0_SAVE);
+		ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+	}
+
+	_mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(ABCD, 0x1B));
+	state[4] = _mm_extract_epi32(E0, 3);
+}
 
-CSHA1::CSHA1()
+static bool SHANISupported()
 {
+	// CPUID leaf 7 EBX bit 29 is SHA, leaf 1 ECX bit 9 is SSSE3 and bit 19 is SSE4.1
+	unsigned int ECX1, EBX7;
+
+ #ifdef _MSC_VER
+	int CPUInfo[4];
+	__cpuid(CPUInfo, 0);
+
+	if (CPUInfo[0] < 7)
+		return false;
+
+	__cpuid(CPUInfo, 1);
+	ECX1 = CPUInfo[2];
+	__cpuidex(CPUInfo, 7, 0);
+	EBX7 = CPUInfo[1];
+ #else
+	unsigned int EAX, EBX, ECX, EDX;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return false;
+
+	__cpuid(1, EAX, EBX, ECX, EDX);
+	ECX1 = ECX;
+	__cpuid_count(7, 0, EAX, EBX, ECX, EDX);
+	EBX7 = EBX;
+ #endif
+
+	return (EBX7 & (1 << 29)) && (ECX1 & (1 << 9)) && (ECX1 & (1 << 19));
+}
+#endif
+
+CSHA1::CSHA1(bool useSHANI)
+{
+#ifdef SHA1_SHANI
+	m_SHANI = useSHANI && SHANISupported();
+#else
+	m_SHANI = false;
+#endif
+
 	Reset();
 }
 
@@ -44,53 +296,69 @@ void CSHA1::Reset()
 	m_count[1] = 0;
 }
 
-void CSHA1::Transform(uint32_t state[5], unsigned char buffer[64])
+void CSHA1::Transform(uint32_t state[5], unsigned char *data, uint32_t blocks)
 {
+#ifdef SHA1_SHANI
+	if (m_SHANI)
+	{
+		TransformSHANI(state, data, blocks);
+		return;
+	}
+#endif
+
 	uint32_t a = 0, b = 0, c = 0, d = 0, e = 0;
+	uint32_t sa = state[0], sb = state[1], sc = state[2], sd = state[3], se = state[4];
+
+	// The workspace is on the stack so several CSHA1's can be used at once from different threads
+	SHA1_WORKSPACE_BLOCK workspace;
+	SHA1_WORKSPACE_BLOCK* block = &workspace;
+
+	for (; blocks > 0; --blocks, data += 64)
+	{
+		memcpy(block, data, 64);
+
+		// Copy state to working vars
+		a = sa;
+		b = sb;
+		c = sc;
+		d = sd;
+		e = se;
+
+		// 4 rounds of 20 operations each. Loop unrolled.
+		R0(a,b,c,d,e, 0); R0(e,a,b,c,d, 1); R0(d,e,a,b,c, 2); R0(c,d,e,a,b, 3);
+		R0(b,c,d,e,a, 4); R0(a,b,c,d,e, 5); R0(e,a,b,c,d, 6); R0(d,e,a,b,c, 7);
+		R0(c,d,e,a,b, 8); R0(b,c,d,e,a, 9); R0(a,b,c,d,e,10); R0(e,a,b,c,d,11);
+		R0(d,e,a,b,c,12); R0(c,d,e,a,b,13); R0(b,c,d,e,a,14); R0(a,b,c,d,e,15);
+		R1(e,a,b,c,d,16); R1(d,e,a,b,c,17); R1(c,d,e,a,b,18); R1(b,c,d,e,a,19);
+		R2(a,b,c,d,e,20); R2(e,a,b,c,d,21); R2(d,e,a,b,c,22); R2(c,d,e,a,b,23);
+		R2(b,c,d,e,a,24); R2(a,b,c,d,e,25); R2(e,a,b,c,d,26); R2(d,e,a,b,c,27);
+		R2(c,d,e,a,b,28); R2(b,c,d,e,a,29); R2(a,b,c,d,e,30); R2(e,a,b,c,d,31);
+		R2(d,e,a,b,c,32); R2(c,d,e,a,b,33); R2(b,c,d,e,a,34); R2(a,b,c,d,e,35);
+		R2(e,a,b,c,d,36); R2(d,e,a,b,c,37); R2(c,d,e,a,b,38); R2(b,c,d,e,a,39);
+		R3(a,b,c,d,e,40); R3(e,a,b,c,d,41); R3(d,e,a,b,c,42); R3(c,d,e,a,b,43);
+		R3(b,c,d,e,a,44); R3(a,b,c,d,e,45); R3(e,a,b,c,d,46); R3(d,e,a,b,c,47);
+		R3(c,d,e,a,b,48); R3(b,c,d,e,a,49); R3(a,b,c,d,e,50); R3(e,a,b,c,d,51);
+		R3(d,e,a,b,c,52); R3(c,d,e,a,b,53); R3(b,c,d,e,a,54); R3(a,b,c,d,e,55);
+		R3(e,a,b,c,d,56); R3(d,e,a,b,c,57); R3(c,d,e,a,b,58); R3(b,c,d,e,a,59);
+		R4(a,b,c,d,e,60); R4(e,a,b,c,d,61); R4(d,e,a,b,c,62); R4(c,d,e,a,b,63);
+		R4(b,c,d,e,a,64); R4(a,b,c,d,e,65); R4(e,a,b,c,d,66); R4(d,e,a,b,c,67);
+		R4(c,d,e,a,b,68); R4(b,c,d,e,a,69); R4(a,b,c,d,e,70); R4(e,a,b,c,d,71);
+		R4(d,e,a,b,c,72); R4(c,d,e,a,b,73); R4(b,c,d,e,a,74); R4(a,b,c,d,e,75);
+		R4(e,a,b,c,d,76); R4(d,e,a,b,c,77); R4(c,d,e,a,b,78); R4(b,c,d,e,a,79);
+
+		// Add the working vars back into the state
+		sa += a;
+		sb += b;
+		sc += c;
+		sd += d;
+		se += e;
+	}
 
-	SHA1_WORKSPACE_BLOCK* block;
-	static unsigned char workspace[64];
-	block = (SHA1_WORKSPACE_BLOCK *)workspace;
-	memcpy(block, buffer, 64);
-
-	// Copy state[] to working vars
-	a = state[0];
-	b = state[1];
-	c = state[2];
-	d = state[3];
-	e = state[4];
-
-	// 4 rounds of 20 operations each. Loop unrolled.
-	R0(a,b,c,d,e, 0); R0(e,a,b,c,d, 1); R0(d,e,a,b,c, 2); R0(c,d,e,a,b, 3);
-	R0(b,c,d,e,a, 4); R0(a,b,c,d,e, 5); R0(e,a,b,c,d, 6); R0(d,e,a,b,c, 7);
-	R0(c,d,e,a,b, 8); R0(b,c,d,e,a, 9); R0(a,b,c,d,e,10); R0(e,a,b,c,d,11);
-	R0(d,e,a,b,c,12); R0(c,d,e,a,b,13); R0(b,c,d,e,a,14); R0(a,b,c,d,e,15);
-	R1(e,a,b,c,d,16); R1(d,e,a,b,c,17); R1(c,d,e,a,b,18); R1(b,c,d,e,a,19);
-	R2(a,b,c,d,e,20); R2(e,a,b,c,d,21); R2(d,e,a,b,c,22); R2(c,d,e,a,b,23);
-	R2(b,c,d,e,a,24); R2(a,b,c,d,e,25); R2(e,a,b,c,d,26); R2(d,e,a,b,c,27);
-	R2(c,d,e,a,b,28); R2(b,c,d,e,a,29); R2(a,b,c,d,e,30); R2(e,a,b,c,d,31);
-	R2(d,e,a,b,c,32); R2(c,d,e,a,b,33); R2(b,c,d,e,a,34); R2(a,b,c,d,e,35);
-	R2(e,a,b,c,d,36); R2(d,e,a,b,c,37); R2(c,d,e,a,b,38); R2(b,c,d,e,a,39);
-	R3(a,b,c,d,e,40); R3(e,a,b,c,d,41); R3(d,e,a,b,c,42); R3(c,d,e,a,b,43);
-	R3(b,c,d,e,a,44); R3(a,b,c,d,e,45); R3(e,a,b,c,d,46); R3(d,e,a,b,c,47);
-	R3(c,d,e,a,b,48); R3(b,c,d,e,a,49); R3(a,b,c,d,e,50); R3(e,a,b,c,d,51);
-	R3(d,e,a,b,c,52); R3(c,d,e,a,b,53); R3(b,c,d,e,a,54); R3(a,b,c,d,e,55);
-	R3(e,a,b,c,d,56); R3(d,e,a,b,c,57); R3(c,d,e,a,b,58); R3(b,c,d,e,a,59);
-	R4(a,b,c,d,e,60); R4(e,a,b,c,d,61); R4(d,e,a,b,c,62); R4(c,d,e,a,b,63);
-	R4(b,c,d,e,a,64); R4(a,b,c,d,e,65); R4(e,a,b,c,d,66); R4(d,e,a,b,c,67);
-	R4(c,d,e,a,b,68); R4(b,c,d,e,a,69); R4(a,b,c,d,e,70); R4(e,a,b,c,d,71);
-	R4(d,e,a,b,c,72); R4(c,d,e,a,b,73); R4(b,c,d,e,a,74); R4(a,b,c,d,e,75);
-	R4(e,a,b,c,d,76); R4(d,e,a,b,c,77); R4(c,d,e,a,b,78); R4(b,c,d,e,a,79);
-
-	// Add the working vars back into state[]
-	state[0] += a;
-	state[1] += b;
-	state[2] += c;
-	state[3] += d;
-	state[4] += e;
-
-	// Wipe variables
-	a = 0; b = 0; c = 0; d = 0; e = 0;
+	state[0] = sa;
+	state[1] = sb;
+	state[2] = sc;
+	state[3] = sd;
+	state[4] = se;
 }
 
 // Use this function to hash in binary data and strings
@@ -107,12 +375,11 @@ void CSHA1::Update(unsigned char* data, unsigned int len)
 	if((j + len) > 63)
 	{
 		memcpy(&m_buffer[j], data, (i = 64 - j));
-		Transform(m_state, m_buffer);
+		Transform(m_state, m_buffer, 1);
 
-		for (; i+63 < len; i += 64)
-		{
-			Transform(m_state, &data[i]);
-		}
+		// Hash all the whole blocks left in one go
+		Transform(m_state, &data[i], (len - i) / 64);
+		i += (len - i) & ~63;
 
 		j = 0;
 	}
@@ -130,10 +397,12 @@ void CSHA1::Final()
 		finalcount[i] = (unsigned char)((m_count[(i >= 4 ? 0 : 1)]
 			>> ((3 - (i & 3)) * 8) ) & 255); // Endian independent
 
-	Update((unsigned char *)"\200", 1);
-
-	while ((m_count[0] & 504) != 448)
-		Update((unsigned char *)"\0", 1);
+	// Pad with 0x80 followed by zeros until 8 bytes short of a block boundary
+	unsigned char padding[64];
+	memset(padding, 0, 64);
+	padding[0] = 0x80;
+	j = (m_count[0] >> 3) & 63;
+	Update(padding, j < 56 ? 56 - j : 120 - j);
 
 	Update(finalcount, 8); // Cause a SHA1Transform()
 
@@ -148,8 +417,6 @@ void CSHA1::Final()
 	memset(m_state, 0, 20);
 	memset(m_count, 0, 8);
 	memset(finalcount, 0, 8);
-
-	Transform(m_state, m_buffer);
 }
 
 // Get the final hash as a pre-formatted string
@@ -33,6 +33,13 @@
 
 #define MAX_FILE_READ_BUFFER 8000
 
+// SHA1_SHANI is defined when we know how to build the SHA extensions version for this compiler and CPU architecture
+// whether the CPU we're running on actually supports it is checked in the constructor
+
+#if ( defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) ) ) || ( defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) ) )
+ #define SHA1_SHANI
+#endif
+
 class CSHA1
 {
 public:
@@ -64,8 +71,8 @@ public:
 	// Two different formats for ReportHash(...)
 	enum { REPORT_HEX = 0, REPORT_DIGIT = 1 };
 
-	// Constructor and Destructor
-	CSHA1();
+	// Constructor and Destructor, useSHANI false forces the scalar version (for testing)
+	CSHA1(bool useSHANI = true);
 	virtual ~CSHA1();
 
 	uint32_t m_state[5];
@@ -83,9 +90,14 @@ public:
 	void ReportHash(char *szReport, unsigned char uReportType = REPORT_HEX);
 	void GetHash(unsigned char *uDest);
 
+	// True if the CPU supports the SHA extensions
+	bool GetSHANI() { return m_SHANI; }
+
 private:
-	// Private SHA-1 transformation
-	void Transform(uint32_t state[5], unsigned char buffer[64]);
+	bool m_SHANI;
+
+	// Private SHA-1 transformation of any number of consecutive 64 byte blocks
+	void Transform(uint32_t state[5], unsigned char *data, uint32_t blocks);
 };
 
 #endif // ___SHA1_H___
@@ -21,29 +21,136 @@
 #include "ghost.h"
 #include "util.h"
 #include "socket.h"
+#include "reactor.h"
+#include "capture.h"
 
 #include <string.h>
 
+#ifndef WIN32
+ #include <poll.h>
+#endif
+
 #ifndef WIN32
  int GetLastSocketError( ) { return errno; }
 #endif
 
+//
+// CByteBuffer
+//
+
+CByteBuffer :: CByteBuffer( ) : m_Data( NULL ), m_Capacity( 0 ), m_Start( 0 ), m_End( 0 )
+{
+
+}
+
+CByteBuffer :: ~CByteBuffer( )
+{
+	delete [] m_Data;
+}
+
+char *CByteBuffer :: Reserve( uint32_t length )
+{
+	// make room for at least length bytes after the unread data and return a pointer to it
+	// the caller writes into the returned space and then calls Commit with the number of bytes actually written
+
+	if( m_Capacity - m_End >= length )
+		return m_Data + m_End;
+
+	uint32_t Size = m_End - m_Start;
+
+	if( Size + length <= m_Capacity && m_Start >= Size )
+	{
+		// there's enough room if we move the unread data back to the start
+
+		memmove( m_Data, m_Data + m_Start, Size );
+	}
+	else
+	{
+		uint32_t Capacity = m_Capacity < 1024 ? 1024 : m_Capacity;
+
+		while( Capacity < Size + length )
+			Capacity *= 2;
+
+		char *Data = new char[Capacity];
+
+		if( Size > 0 )
+			memcpy( Data, m_Data + m_Start, Size );
+
+		delete [] m_Data;
+		m_Data = Data;
+		m_Capacity = Capacity;
+	}
+
+	m_Start = 0;
+	m_End = Size;
+	return m_Data + m_End;
+}
+
+void CByteBuffer :: Append( const char *data, uint32_t length )
+{
+	if( length == 0 )
+		return;
+
+	memcpy( Reserve( length ), data, length );
+	Commit( length );
+}
+
+void CByteBuffer :: Consume( uint32_t length )
+{
+	if( length >= m_End - m_Start )
+	{
+		m_Start = 0;
+		m_End = 0;
+	}
+	else
+		m_Start += length;
+}
+
+//
+// CPacket
+//
+
+CPacket :: CPacket( ) : m_Data( new BYTEARRAY( ) ), m_Payload( NULL ), m_PayloadSize( 0 )
+{
+
+}
+
+CPacket :: CPacket( BYTEARRAY nData ) : m_Data( new BYTEARRAY( ) ), m_Payload( NULL ), m_PayloadSize( 0 )
+{
+	// nData is our own copy (usually constructed straight from a temporary) so its storage can be taken over
+
+	m_Data->swap( nData );
+}
+
+CPacket :: CPacket( BYTEARRAY nData, boost::shared_ptr<void> nPayloadOwner, const unsigned char *nPayload, uint32_t nPayloadSize ) : m_Data( new BYTEARRAY( ) ), m_PayloadOwner( nPayloadOwner ), m_Payload( nPayload ), m_PayloadSize( nPayloadSize )
+{
+	m_Data->swap( nData );
+}
+
+CPacket :: ~CPacket( )
+{
+
+}
+
 //
 // CSocket
 //
 
-CSocket :: CSocket( ) :  m_Socket( INVALID_SOCKET ), m_HasError( false ), m_Error( 0 )
+CSocket :: CSocket( ) :  m_Socket( INVALID_SOCKET ), m_HasError( false ), m_Error( 0 ), m_Reactor( NULL ), m_Readable( false ), m_Writable( true ), m_WantWrite( false )
 {
 	memset( &m_SIN, 0, sizeof( m_SIN ) );
 }
 
-CSocket :: CSocket( SOCKET nSocket, struct sockaddr_in nSIN ) : m_Socket( nSocket ), m_SIN( nSIN ), m_HasError( false ), m_Error( 0 )
+CSocket :: CSocket( SOCKET nSocket, struct sockaddr_in nSIN ) : m_Socket( nSocket ), m_SIN( nSIN ), m_HasError( false ), m_Error( 0 ), m_Reactor( NULL ), m_Readable( false ), m_Writable( true ), m_WantWrite( false )
 {
 
 }
 
 CSocket :: ~CSocket( )
 {
+	if( m_Reactor )
+		m_Reactor->Remove( this );
+
 	if( m_Socket != INVALID_SOCKET )
 		closesocket( m_Socket );
 }
@@ -111,20 +218,6 @@ string CSocket :: GetErrorString( )
 	return "UNKNOWN ERROR (" + UTIL_ToString( m_Error ) + ")";
 }
 
-void CSocket :: SetFD( fd_set *fd, fd_set *send_fd, int *nfds )
-{
-	if( m_Socket == INVALID_SOCKET )
-		return;
-
-	FD_SET( m_Socket, fd );
-	FD_SET( m_Socket, send_fd );
-
-#ifndef WIN32
-	if( m_Socket > *nfds )
-		*nfds = m_Socket;
-#endif
-}
-
 void CSocket :: Allocate( int type )
 {
 	m_Socket = socket( AF_INET, type, 0 );
@@ -140,6 +233,12 @@ void CSocket :: Allocate( int type )
 
 void CSocket :: Reset( )
 {
+	// the reactor must forget about the old descriptor before it's closed
+	// the new socket is registered again by whoever owns it once it's usable (e.g. after connecting)
+
+	if( m_Reactor )
+		m_Reactor->Remove( this );
+
 	if( m_Socket != INVALID_SOCKET )
 		closesocket( m_Socket );
 
@@ -153,7 +252,9 @@ void CSocket :: Reset( )
 // CTCPSocket
 //
 
-CTCPSocket :: CTCPSocket( ) : CSocket( ), m_Connected( false ), m_LastRecv( GetTime( ) ), m_LastSend( GetTime( ) )
+CPacketCapture *CTCPSocket :: m_Capture = NULL;
+
+CTCPSocket :: CTCPSocket( ) : CSocket( ), m_Connected( false ), m_CaptureID( m_Capture ? m_Capture->GetNewConnectionID( ) : 0 ), m_SendOffset( 0 ), m_SendPriority( 0 ), m_RecvSize( SOCKET_RECV_MIN ), m_TotalRecvBytes( 0 ), m_TotalRecvCalls( 0 ), m_TotalRecvRounds( 0 ), m_LastRecv( GetTime( ) ), m_LastSend( GetTime( ) )
 {
 	Allocate( SOCK_STREAM );
 
@@ -167,7 +268,7 @@ CTCPSocket :: CTCPSocket( ) : CSocket( ), m_Connected( false ), m_LastRecv( GetT
 #endif
 }
 
-CTCPSocket :: CTCPSocket( SOCKET nSocket, struct sockaddr_in nSIN ) : CSocket( nSocket, nSIN )
+CTCPSocket :: CTCPSocket( SOCKET nSocket, struct sockaddr_in nSIN ) : CSocket( nSocket, nSIN ), m_CaptureID( m_Capture ? m_Capture->GetNewConnectionID( ) : 0 ), m_SendOffset( 0 ), m_SendPriority( 0 ), m_RecvSize( SOCKET_RECV_MIN ), m_TotalRecvBytes( 0 ), m_TotalRecvCalls( 0 ), m_TotalRecvRounds( 0 )
 {
 	m_Connected = true;
 	m_LastRecv = GetTime( );
@@ -194,8 +295,11 @@ void CTCPSocket :: Reset( )
 
 	Allocate( SOCK_STREAM );
 	m_Connected = false;
-	m_RecvBuffer.clear( );
-	m_SendBuffer.clear( );
+	m_RecvBuffer.Clear( );
+	m_RecvSize = SOCKET_RECV_MIN;
+	m_SendQueue.clear( );
+	m_SendOffset = 0;
+	m_SendPriority = 0;
 	m_LastRecv = GetTime( );
 	m_LastSend = GetTime( );
 
@@ -208,59 +312,100 @@ void CTCPSocket :: Reset( )
 	fcntl( m_Socket, F_SETFL, fcntl( m_Socket, F_GETFL ) | O_NONBLOCK );
 #endif
 
-	if( !m_LogFile.empty( ) )
-	{
-		ofstream Log;
-		Log.open( m_LogFile.c_str( ), ios :: app );
-
-		if( !Log.fail( ) )
-		{
-			Log << "----------RESET----------" << endl;
-			Log.close( );
-		}
-	}
+	if( m_Capture )
+		m_CaptureID = m_Capture->GetNewConnectionID( );
 }
 
 void CTCPSocket :: PutBytes( string bytes )
 {
-	m_SendBuffer += bytes;
+	if( !bytes.empty( ) )
+		Queue( CPacket( BYTEARRAY( bytes.begin( ), bytes.end( ) ) ), false );
 }
 
 void CTCPSocket :: PutBytes( BYTEARRAY bytes )
 {
-	m_SendBuffer += string( bytes.begin( ), bytes.end( ) );
+	if( !bytes.empty( ) )
+		Queue( CPacket( bytes ), false );
+}
+
+void CTCPSocket :: PutBytes( CPacket packet )
+{
+	// only the reference is queued, the packet's bytes aren't copied
+
+	if( !packet.GetEmpty( ) )
+		Queue( packet, false );
 }
 
-void CTCPSocket :: DoRecv( fd_set *fd )
+void CTCPSocket :: PutBulkBytes( CPacket packet )
+{
+	// bulk data (map parts) is sent after everything queued with PutBytes, even the packets queued later
+	// this keeps a slow downloader's lobby packets from waiting behind a whole download window of map data
+	// bulk packets are still sent in the order they were queued, and so are the others
+
+	if( !packet.GetEmpty( ) )
+		Queue( packet, true );
+}
+
+void CTCPSocket :: Queue( CPacket packet, bool bulk )
+{
+	if( bulk )
+	{
+		m_SendQueue.push_back( packet );
+		return;
+	}
+
+	// queue the packet after the other non bulk packets but ahead of any bulk data
+	// a packet which has been partly sent has to stay in front no matter what it is
+
+	uint32_t Position = m_SendPriority;
+
+	if( Position == 0 && m_SendOffset > 0 )
+		Position = 1;
+
+	m_SendQueue.insert( m_SendQueue.begin( ) + Position, packet );
+	m_SendPriority = Position + 1;
+}
+
+void CTCPSocket :: DoRecv( )
 {
 	if( m_Socket == INVALID_SOCKET || m_HasError || !m_Connected )
 		return;
 
-	if( FD_ISSET( m_Socket, fd ) )
+	if( !GetReadable( ) )
+		return;
+
+	// data is waiting, receive it straight into the receive buffer
+	// keep going until the kernel has nothing left so a burst is drained in one go instead of one recv per loop
+	// a recv which doesn't fill the space we offered means the kernel's queue is empty so we stop there without another call to confirm it
+
+	uint32_t Received = 0;
+
+	while( Received < SOCKET_RECV_FAIRNESS )
 	{
-		// data is waiting, receive it
+		uint32_t Length = m_RecvSize;
+		char *buffer = m_RecvBuffer.Reserve( Length );
+		int c = recv( m_Socket, buffer, Length, 0 );
+		++m_TotalRecvCalls;
 
-		char buffer[1024];
-		int c = recv( m_Socket, buffer, 1024, 0 );
-		
 		if( c > 0 )
 		{
 			// success! add the received data to the buffer
 
-			if( !m_LogFile.empty( ) )
-			{
-				ofstream Log;
-				Log.open( m_LogFile.c_str( ), ios :: app );
+			if( m_Capture )
+				m_Capture->Capture( m_CaptureID, CAPTURE_RECV, m_SIN.sin_addr.s_addr, ntohs( m_SIN.sin_port ), (unsigned char *)buffer, c );
 
-				if( !Log.fail( ) )
-				{
-					Log << "					RECEIVE <<< " << UTIL_ByteArrayToHexString( UTIL_CreateByteArray( (unsigned char *)buffer, c ) ) << endl;
-					Log.close( );
-				}
-			}
-
-			m_RecvBuffer += string( buffer, c );
+			m_RecvBuffer.Commit( c );
+			m_TotalRecvBytes += c;
 			m_LastRecv = GetTime( );
+			Received += c;
+
+			if( (uint32_t)c < Length )
+				break;
+
+			// we filled all the space we offered so there's probably more waiting, ask for more next time
+
+			if( m_RecvSize < SOCKET_RECV_MAX )
+				m_RecvSize *= 2;
 		}
 		else if( c == SOCKET_ERROR && GetLastSocketError( ) != EWOULDBLOCK )
 		{
@@ -269,6 +414,12 @@ void CTCPSocket :: DoRecv( fd_set *fd )
 			m_HasError = true;
 			m_Error = GetLastSocketError( );
 			BOOST_LOG_TRIVIAL(warning) << "[TCPSOCKET] error (recv) - " + GetErrorString( );
+
+			// stop watching the socket, otherwise the reactor would keep waking us up for the error
+
+			if( m_Reactor )
+				m_Reactor->Remove( this );
+
 			return;
 		}
 		else if( c == 0 )
@@ -277,39 +428,156 @@ void CTCPSocket :: DoRecv( fd_set *fd )
 
 			BOOST_LOG_TRIVIAL(warning) << "[TCPSOCKET] closed by remote host";
 			m_Connected = false;
+
+			if( m_Reactor )
+				m_Reactor->Remove( this );
+
+			break;
 		}
+		else
+			break;
 	}
+
+	if( Received > 0 )
+		++m_TotalRecvRounds;
+
+	// shrink the recv size again once the bursts are over so a quiet socket doesn't keep offering (and reserving) a large buffer
+
+	if( Received < m_RecvSize / 4 && m_RecvSize > SOCKET_RECV_MIN )
+		m_RecvSize /= 2;
 }
 
-void CTCPSocket :: DoSend( fd_set *send_fd )
+void CTCPSocket :: DoSend( )
 {
-	if( m_Socket == INVALID_SOCKET || m_HasError || !m_Connected || m_SendBuffer.empty( ) )
+	if( m_Socket == INVALID_SOCKET || m_HasError || !m_Connected || m_SendQueue.empty( ) )
 		return;
 
-	if( FD_ISSET( m_Socket, send_fd ) )
+	while( !m_SendQueue.empty( ) && GetWritable( ) )
 	{
 		// socket is ready, send it
+		// the queued packets are handed to the kernel straight from their shared storage in one vectored send starting at the send cursor
+		// each packet is one or two buffers, its own bytes and its payload (if any)
+
+#ifdef WIN32
+		WSABUF Buffers[SOCKET_MAX_IOV];
+#else
+		struct iovec Buffers[SOCKET_MAX_IOV];
+#endif
+		unsigned int Count = 0;
+		uint32_t Length = 0;
+		uint32_t Offset = m_SendOffset;
+
+		for( deque<CPacket> :: iterator i = m_SendQueue.begin( ); i != m_SendQueue.end( ) && Count + 2 <= SOCKET_MAX_IOV; ++i )
+		{
+			const unsigned char *Data[2] = { i->GetData( ), i->GetPayload( ) };
+			uint32_t Size[2] = { i->GetDataSize( ), i->GetPayloadSize( ) };
+
+			for( int j = 0; j < 2; ++j )
+			{
+				// skip whatever the send cursor has already passed
+
+				if( Offset >= Size[j] )
+				{
+					Offset -= Size[j];
+					continue;
+				}
+
+#ifdef WIN32
+				Buffers[Count].buf = (char *)Data[j] + Offset;
+				Buffers[Count].len = Size[j] - Offset;
+#else
+				Buffers[Count].iov_base = (void *)( Data[j] + Offset );
+				Buffers[Count].iov_len = Size[j] - Offset;
+#endif
+				Length += Size[j] - Offset;
+				Offset = 0;
+				++Count;
+			}
+		}
+
+#ifdef WIN32
+		DWORD Sent = 0;
+		int s = WSASend( m_Socket, Buffers, Count, &Sent, 0, NULL, NULL ) == 0 ? (int)Sent : SOCKET_ERROR;
+#else
+		struct msghdr Message;
+		memset( &Message, 0, sizeof( Message ) );
+		Message.msg_iov = Buffers;
+		Message.msg_iovlen = Count;
+		int s = sendmsg( m_Socket, &Message, MSG_NOSIGNAL );
+#endif
 
-		int s = send( m_Socket, m_SendBuffer.c_str( ), (int)m_SendBuffer.size( ), MSG_NOSIGNAL );
-		
 		if( s > 0 )
 		{
-			// success! only some of the data may have been sent, remove it from the buffer
+			// success! only some of the data may have been sent, remove it from the queue
 
-			if( !m_LogFile.empty( ) )
+			if( m_Capture )
 			{
-				ofstream Log;
-				Log.open( m_LogFile.c_str( ), ios :: app );
+				Offset = m_SendOffset;
+				uint32_t Captured = 0;
 
-				if( !Log.fail( ) )
+				for( deque<CPacket> :: iterator i = m_SendQueue.begin( ); i != m_SendQueue.end( ) && Captured < (uint32_t)s; ++i )
 				{
-					Log << "SEND >>> " << UTIL_ByteArrayToHexString( BYTEARRAY( m_SendBuffer.begin( ), m_SendBuffer.begin( ) + s ) ) << endl;
-					Log.close( );
+					const unsigned char *Data[2] = { i->GetData( ), i->GetPayload( ) };
+					uint32_t Size[2] = { i->GetDataSize( ), i->GetPayloadSize( ) };
+
+					for( int j = 0; j < 2 && Captured < (uint32_t)s; ++j )
+					{
+						if( Offset >= Size[j] )
+						{
+							Offset -= Size[j];
+							continue;
+						}
+
+						uint32_t CaptureSize = Size[j] - Offset;
+
+						if( CaptureSize > s - Captured )
+							CaptureSize = s - Captured;
+
+						m_Capture->Capture( m_CaptureID, CAPTURE_SEND, m_SIN.sin_addr.s_addr, ntohs( m_SIN.sin_port ), Data[j] + Offset, CaptureSize );
+						Captured += CaptureSize;
+						Offset = 0;
+					}
+				}
+			}
+
+			// advance the send cursor past the packets which were sent completely and into the first one which wasn't
+
+			uint32_t Advance = s;
+
+			while( Advance > 0 )
+			{
+				uint32_t Remaining = m_SendQueue.front( ).GetSize( ) - m_SendOffset;
+
+				if( Advance >= Remaining )
+				{
+					m_SendQueue.pop_front( );
+					m_SendOffset = 0;
+					Advance -= Remaining;
+
+					if( m_SendPriority > 0 )
+						--m_SendPriority;
+				}
+				else
+				{
+					m_SendOffset += Advance;
+					Advance = 0;
 				}
 			}
 
-			m_SendBuffer = m_SendBuffer.substr( s );
 			m_LastSend = GetTime( );
+
+			// the kernel's send buffer is full, don't try again until the reactor says it has drained
+
+			if( (uint32_t)s < Length )
+			{
+				if( m_Reactor )
+				{
+					m_Writable = false;
+					m_Reactor->WantWrite( this, true );
+				}
+
+				return;
+			}
 		}
 		else if( s == SOCKET_ERROR && GetLastSocketError( ) != EWOULDBLOCK )
 		{
@@ -318,6 +586,20 @@ void CTCPSocket :: DoSend( fd_set *send_fd )
 			m_HasError = true;
 			m_Error = GetLastSocketError( );
 			BOOST_LOG_TRIVIAL(warning) << "[TCPSOCKET] error (send) - " + GetErrorString( );
+
+			if( m_Reactor )
+				m_Reactor->Remove( this );
+
+			return;
+		}
+		else
+		{
+			if( s == SOCKET_ERROR && m_Reactor )
+			{
+				m_Writable = false;
+				m_Reactor->WantWrite( this, true );
+			}
+
 			return;
 		}
 	}
@@ -325,6 +607,9 @@ void CTCPSocket :: DoSend( fd_set *send_fd )
 
 void CTCPSocket :: Disconnect( )
 {
+	if( m_Reactor )
+		m_Reactor->Remove( this );
+
 	if( m_Socket != INVALID_SOCKET )
 		shutdown( m_Socket, SHUT_RDWR );
 
@@ -435,6 +720,9 @@ bool CTCPClient :: CheckConnect( )
 	if( m_Socket == INVALID_SOCKET || m_HasError || !m_Connecting )
 		return false;
 
+	// check if the socket is connected
+
+#ifdef WIN32
 	fd_set fd;
 	FD_ZERO( &fd );
 	FD_SET( m_Socket, &fd );
@@ -443,13 +731,7 @@ bool CTCPClient :: CheckConnect( )
 	tv.tv_sec = 0;
 	tv.tv_usec = 0;
 
-	// check if the socket is connected
-
-#ifdef WIN32
 	if( select( 1, NULL, &fd, NULL, &tv ) == SOCKET_ERROR )
-#else
-	if( select( m_Socket + 1, NULL, &fd, NULL, &tv ) == SOCKET_ERROR )
-#endif
 	{
 		m_HasError = true;
 		m_Error = GetLastSocketError( );
@@ -457,6 +739,23 @@ bool CTCPClient :: CheckConnect( )
 	}
 
 	if( FD_ISSET( m_Socket, &fd ) )
+#else
+	// use poll rather than select here since the descriptor may be larger than FD_SETSIZE
+
+	struct pollfd PollFD;
+	PollFD.fd = m_Socket;
+	PollFD.events = POLLOUT;
+	PollFD.revents = 0;
+
+	if( poll( &PollFD, 1, 0 ) == SOCKET_ERROR )
+	{
+		m_HasError = true;
+		m_Error = GetLastSocketError( );
+		return false;
+	}
+
+	if( PollFD.revents & ( POLLOUT | POLLERR | POLLHUP ) )
+#endif
 	{
 		m_Connecting = false;
 		m_Connected = true;
@@ -526,12 +825,12 @@ bool CTCPServer :: Listen( string address, uint16_t port )
 	return true;
 }
 
-CTCPSocket *CTCPServer :: Accept( fd_set *fd )
+CTCPSocket *CTCPServer :: Accept( )
 {
 	if( m_Socket == INVALID_SOCKET || m_HasError )
 		return NULL;
 
-	if( FD_ISSET( m_Socket, fd ) )
+	if( GetReadable( ) )
 	{
 		// a connection is waiting, accept it
 
@@ -751,14 +1050,14 @@ bool CUDPServer :: Bind( string address, uint16_t port )
 	return Bind( sin );
 }
 
-void CUDPServer :: RecvFrom( fd_set *fd, struct sockaddr_in *sin, string *message )
+void CUDPServer :: RecvFrom( struct sockaddr_in *sin, string *message )
 {
 	if( m_Socket == INVALID_SOCKET || m_HasError || !sin || !message )
 		return;
 
 	int AddrLen = sizeof( *sin );
 
-	if( FD_ISSET( m_Socket, fd ) )
+	if( GetReadable( ) )
 	{
 		// data is waiting, receive it
 
@@ -71,6 +71,7 @@
  #include <sys/ioctl.h>
  #include <sys/socket.h>
  #include <sys/types.h>
+ #include <sys/uio.h>
  #include <unistd.h>
 
  typedef int SOCKET;
@@ -95,6 +96,90 @@
  #define SHUT_RDWR 2
 #endif
 
+// the maximum number of buffers handed to the kernel in one vectored send (a packet is one buffer, or two if it has a payload)
+
+#define SOCKET_MAX_IOV 64
+
+// DoRecv keeps receiving until the kernel has nothing left for us but never more than SOCKET_RECV_FAIRNESS bytes at a time so one busy socket can't starve the others
+// the size of each recv adapts between SOCKET_RECV_MIN and SOCKET_RECV_MAX bytes depending on how much data arrives at once
+
+#define SOCKET_RECV_MIN 1024
+#define SOCKET_RECV_MAX 65536
+#define SOCKET_RECV_FAIRNESS 262144
+
+class CSocketReactor;
+class CPacketCapture;
+
+//
+// CByteBuffer
+//
+
+// a growable byte buffer used for the socket receive buffers
+// data is appended at the end and consumed from the front, consuming only moves the read offset so it's O(1) no matter how much is queued
+// the unread data is always contiguous so it can be handed to send and parsed in place
+// the space in front of the unread data is reclaimed by moving the unread data back to the start, but only once at least as much has been consumed as is left so the copying is amortized O(1) per byte
+// the storage is kept when the buffer empties so a busy socket stops allocating once its buffers have grown to fit its traffic
+
+class CByteBuffer
+{
+private:
+	char *m_Data;
+	uint32_t m_Capacity;
+	uint32_t m_Start;						// offset of the first unread byte
+	uint32_t m_End;							// offset one past the last unread byte
+
+	CByteBuffer( const CByteBuffer & );
+	CByteBuffer &operator=( const CByteBuffer & );
+
+public:
+	CByteBuffer( );
+	~CByteBuffer( );
+
+	char *GetData( )						{ return m_Data + m_Start; }
+	uint32_t GetSize( )						{ return m_End - m_Start; }
+	uint32_t GetCapacity( )					{ return m_Capacity; }
+	bool GetEmpty( )						{ return m_End == m_Start; }
+
+	char *Reserve( uint32_t length );
+	void Commit( uint32_t length )			{ m_End += length; }
+	void Append( const char *data, uint32_t length );
+	void Consume( uint32_t length );
+	void Clear( )							{ m_Start = 0; m_End = 0; }
+};
+
+//
+// CPacket
+//
+
+// an immutable reference counted packet
+// copying a CPacket only copies the reference so the same packet can be queued on any number of sockets (and GProxy++ buffers) while its bytes are stored once
+// constructing a CPacket from a BYTEARRAY takes over the array's storage instead of copying it
+// a packet can also have a payload which is sent after its own bytes but isn't stored in the packet, e.g. a map part's map data is sent straight from the memory mapped map file
+// the packet holds a reference to whatever owns the payload so the payload stays valid for as long as the packet is queued anywhere
+// the reference count is thread safe but the bytes must never be modified once the packet has been created
+
+class CPacket
+{
+private:
+	boost::shared_ptr<BYTEARRAY> m_Data;
+	boost::shared_ptr<void> m_PayloadOwner;		// keeps the payload alive, empty if there's no payload
+	const unsigned char *m_Payload;
+	uint32_t m_PayloadSize;
+
+public:
+	CPacket( );
+	CPacket( BYTEARRAY nData );
+	CPacket( BYTEARRAY nData, boost::shared_ptr<void> nPayloadOwner, const unsigned char *nPayload, uint32_t nPayloadSize );
+	~CPacket( );
+
+	const unsigned char *GetData( )			{ return m_Data->empty( ) ? NULL : &(*m_Data)[0]; }
+	uint32_t GetDataSize( )					{ return m_Data->size( ); }
+	const unsigned char *GetPayload( )		{ return m_Payload; }
+	uint32_t GetPayloadSize( )				{ return m_PayloadSize; }
+	uint32_t GetSize( )						{ return m_Data->size( ) + m_PayloadSize; }
+	bool GetEmpty( )						{ return GetSize( ) == 0; }
+};
+
 //
 // CSocket
 //
@@ -106,6 +191,10 @@ protected:
 	struct sockaddr_in m_SIN;
 	bool m_HasError;
 	int m_Error;
+	CSocketReactor *m_Reactor;					// the reactor this socket is registered with, if any
+	bool m_Readable;							// set by the reactor when data is waiting
+	bool m_Writable;							// cleared when a send would block, set again by the reactor when the socket drains
+	bool m_WantWrite;							// whether the reactor is watching this socket for writability
 
 public:
 	CSocket( );
@@ -118,7 +207,15 @@ public:
 	virtual bool HasError( )						{ return m_HasError; }
 	virtual int GetError( )							{ return m_Error; }
 	virtual string GetErrorString( );
-	virtual void SetFD( fd_set *fd, fd_set *send_fd, int *nfds );
+	virtual SOCKET GetFD( )							{ return m_Socket; }
+	virtual CSocketReactor *GetReactor( )			{ return m_Reactor; }
+	virtual bool GetReadable( )						{ return !m_Reactor || m_Readable; }
+	virtual bool GetWritable( )						{ return !m_Reactor || m_Writable; }
+	virtual bool GetWantWrite( )					{ return m_WantWrite; }
+	virtual void SetReactor( CSocketReactor *nReactor )	{ m_Reactor = nReactor; }
+	virtual void SetReadable( bool nReadable )		{ m_Readable = nReadable; }
+	virtual void SetWritable( bool nWritable )		{ m_Writable = nWritable; }
+	virtual void SetWantWrite( bool nWantWrite )	{ m_WantWrite = nWantWrite; }
 	virtual void Allocate( int type );
 	virtual void Reset( );
 };
@@ -131,11 +228,18 @@ class CTCPSocket : public CSocket
 {
 protected:
 	bool m_Connected;
-	string m_LogFile;
+	uint32_t m_CaptureID;						// identifies this connection in the packet capture, a reset connection gets a new one
+	static CPacketCapture *m_Capture;			// the packet capture shared by every TCP socket, NULL when capturing is disabled
 
 private:
-	string m_RecvBuffer;
-	string m_SendBuffer;
+	CByteBuffer m_RecvBuffer;
+	deque<CPacket> m_SendQueue;					// packets waiting to be sent, shared with anything else which queued the same packet
+	uint32_t m_SendOffset;						// the send cursor, number of bytes of the first packet in m_SendQueue which have already been sent
+	uint32_t m_SendPriority;					// the number of packets at the front of m_SendQueue which go before any queued bulk data, see PutBulkBytes
+	uint32_t m_RecvSize;						// how many bytes to ask for in the next recv, grows to fit the bursts we see
+	uint32_t m_TotalRecvBytes;					// total bytes received
+	uint32_t m_TotalRecvCalls;					// total number of recv calls (including the ones which found nothing)
+	uint32_t m_TotalRecvRounds;					// total number of DoRecv calls which received something
 	uint32_t m_LastRecv;
 	uint32_t m_LastSend;
 
@@ -146,18 +250,29 @@ public:
 
 	virtual void Reset( );
 	virtual bool GetConnected( )				{ return m_Connected; }
-	virtual string *GetBytes( )					{ return &m_RecvBuffer; }
+	virtual CByteBuffer *GetBytes( )			{ return &m_RecvBuffer; }
 	virtual void PutBytes( string bytes );
 	virtual void PutBytes( BYTEARRAY bytes );
-	virtual void ClearRecvBuffer( )				{ m_RecvBuffer.clear( ); }
-	virtual void ClearSendBuffer( )				{ m_SendBuffer.clear( ); }
+	virtual void PutBytes( CPacket packet );
+	virtual void PutBulkBytes( CPacket packet );
+	virtual void ClearRecvBuffer( )				{ m_RecvBuffer.Clear( ); }
+	virtual void ClearSendBuffer( )				{ m_SendQueue.clear( ); m_SendOffset = 0; m_SendPriority = 0; }
+	virtual bool GetSendPending( )				{ return !m_SendQueue.empty( ); }
+	virtual uint32_t GetTotalRecvBytes( )		{ return m_TotalRecvBytes; }
+	virtual uint32_t GetTotalRecvCalls( )		{ return m_TotalRecvCalls; }
+	virtual uint32_t GetTotalRecvRounds( )		{ return m_TotalRecvRounds; }
 	virtual uint32_t GetLastRecv( )				{ return m_LastRecv; }
 	virtual uint32_t GetLastSend( )				{ return m_LastSend; }
-	virtual void DoRecv( fd_set *fd );
-	virtual void DoSend( fd_set *send_fd );
+	virtual void DoRecv( );
+	virtual void DoSend( );
 	virtual void Disconnect( );
 	virtual void SetNoDelay( bool noDelay );
-	virtual void SetLogFile( string nLogFile )	{ m_LogFile = nLogFile; }
+
+private:
+	void Queue( CPacket packet, bool bulk );
+
+public:
+	static void SetCapture( CPacketCapture *nCapture )	{ m_Capture = nCapture; }
 };
 
 //
@@ -191,7 +306,7 @@ public:
 	virtual ~CTCPServer( );
 
 	virtual bool Listen( string address, uint16_t port );
-	virtual CTCPSocket *Accept( fd_set *fd );
+	virtual CTCPSocket *Accept( );
 };
 
 //
@@ -225,7 +340,7 @@ public:
 
 	virtual bool Bind( struct sockaddr_in sin );
 	virtual bool Bind( string address, uint16_t port );
-	virtual void RecvFrom( fd_set *fd, struct sockaddr_in *sin, string *message );
+	virtual void RecvFrom( struct sockaddr_in *sin, string *message );
 };
 
 #endif
@@ -21,6 +21,7 @@
 #include "ghost.h"
 #include "util.h"
 #include "ghostdb.h"
+#include "socket.h"
 #include "gameplayer.h"
 #include "gameprotocol.h"
 #include "game_base.h"
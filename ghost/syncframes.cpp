@@ -0,0 +1,138 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+
+#include "ghost.h"
+#include "util.h"
+#include "syncframes.h"
+
+//
+// CSyncFrames
+//
+
+CSyncFrames :: CSyncFrames( ) : m_FirstFrame( 0 ), m_Players( 0 ), m_NumSkipped( 0 )
+{
+
+}
+
+CSyncFrames :: ~CSyncFrames( )
+{
+
+}
+
+void CSyncFrames :: AddPlayer( unsigned char PID )
+{
+	if( PID >= SYNCFRAMES_MAX_PIDS )
+	{
+		BOOST_LOG_TRIVIAL(warning) << "[SYNC] unable to check player with PID " + UTIL_ToString( PID ) + " for desyncs, PID is too high";
+		return;
+	}
+
+	m_Players |= (uint32_t)1 << PID;
+}
+
+void CSyncFrames :: RemovePlayer( unsigned char PID )
+{
+	// the frames waiting for this player might be complete now, the caller should check GetFrameReady
+
+	if( PID < SYNCFRAMES_MAX_PIDS )
+		m_Players &= ~( (uint32_t)1 << PID );
+}
+
+void CSyncFrames :: AddCheckSum( unsigned char PID, uint32_t frame, uint32_t checkSum )
+{
+	// checksums for frames which have already been compared or from players who aren't tracked are ignored
+
+	if( !GetPlayer( PID ) || frame < m_FirstFrame )
+		return;
+
+	uint32_t Index = frame - m_FirstFrame;
+
+	if( Index >= m_Frames.size( ) )
+		m_Frames.resize( Index + 1 );
+
+	CSyncFrame &Frame = m_Frames[Index];
+	Frame.m_Mask |= (uint32_t)1 << PID;
+	Frame.m_CheckSums[PID] = checkSum;
+}
+
+bool CSyncFrames :: GetFrameReady( )
+{
+	// the first frame is ready once every player has sent a checksum for it
+
+	return !m_Frames.empty( ) && m_Players != 0 && ( m_Frames.front( ).m_Mask & m_Players ) == m_Players;
+}
+
+bool CSyncFrames :: GetFrameInSync( )
+{
+	// check if every player sent the same checksum for the first frame, only call this when GetFrameReady is true
+
+	CSyncFrame &Frame = m_Frames.front( );
+	bool FoundPlayer = false;
+	uint32_t FirstCheckSum = 0;
+
+	for( unsigned char i = 0; i < SYNCFRAMES_MAX_PIDS; ++i )
+	{
+		if( !( m_Players & ( (uint32_t)1 << i ) ) )
+			continue;
+
+		if( !FoundPlayer )
+		{
+			FoundPlayer = true;
+			FirstCheckSum = Frame.m_CheckSums[i];
+		}
+		else if( Frame.m_CheckSums[i] != FirstCheckSum )
+			return false;
+	}
+
+	return true;
+}
+
+uint32_t CSyncFrames :: GetCheckSum( unsigned char PID )
+{
+	// return the checksum the player sent for the first frame, only call this when GetFrameReady is true and the player is tracked
+
+	return m_Frames.front( ).m_CheckSums[PID];
+}
+
+bool CSyncFrames :: GetMissing( unsigned char PID )
+{
+	// check if the first frame is still waiting for the player's checksum
+
+	return GetPlayer( PID ) && !m_Frames.empty( ) && !( m_Frames.front( ).m_Mask & ( (uint32_t)1 << PID ) );
+}
+
+void CSyncFrames :: PopFrame( )
+{
+	if( !m_Frames.empty( ) )
+	{
+		m_Frames.pop_front( );
+		++m_FirstFrame;
+	}
+}
+
+void CSyncFrames :: SkipFrame( )
+{
+	if( !m_Frames.empty( ) )
+	{
+		PopFrame( );
+		++m_NumSkipped;
+	}
+}
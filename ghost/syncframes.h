@@ -0,0 +1,85 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+
+#ifndef SYNCFRAMES_H
+#define SYNCFRAMES_H
+
+// the readiness mask of a frame has one bit per PID so only PIDs below this are tracked (PIDs are handed out lowest first, see CBaseGame :: GetNewPID)
+
+#define SYNCFRAMES_MAX_PIDS		32
+
+// the most frames waiting for checksums before the oldest one is skipped, this is twice the highest sync limit (see !synclimit) so it only happens when a checksum is never coming
+
+#define SYNCFRAMES_MAX_FRAMES	20000
+
+//
+// CSyncFrame
+//
+
+// the checksums the players sent for one frame
+// a frame is one W3GS_INCOMING_ACTION packet, each player answers every one of them with a W3GS_OUTGOING_KEEPALIVE packet holding the checksum of their game state
+
+class CSyncFrame
+{
+public:
+	uint32_t m_Mask;								// which PIDs have sent their checksum for this frame
+	uint32_t m_CheckSums[SYNCFRAMES_MAX_PIDS];		// the checksum of each PID, only valid if its bit in m_Mask is set
+
+	CSyncFrame( ) : m_Mask( 0 ) { }
+};
+
+//
+// CSyncFrames
+//
+
+// the frames of a game whose checksums haven't all arrived yet
+// each checksum is slotted into its frame by the number of keepalives the player has sent so far and the frame is compared exactly once, when the last player's checksum arrives
+// frames are compared in order so a frame which is complete still waits for the frames before it
+
+class CSyncFrames
+{
+private:
+	deque<CSyncFrame> m_Frames;				// the pending frames, m_Frames[0] is frame m_FirstFrame
+	uint32_t m_FirstFrame;					// the oldest frame which hasn't been compared yet
+	uint32_t m_Players;						// which PIDs have to send a checksum for a frame to be complete
+	uint32_t m_NumSkipped;					// the number of frames skipped without being compared
+
+public:
+	CSyncFrames( );
+	~CSyncFrames( );
+
+	uint32_t GetFirstFrame( )				{ return m_FirstFrame; }
+	uint32_t GetNumFrames( )				{ return m_Frames.size( ); }
+	uint32_t GetNumSkipped( )				{ return m_NumSkipped; }
+	bool GetPlayer( unsigned char PID )		{ return PID < SYNCFRAMES_MAX_PIDS && ( m_Players & ( (uint32_t)1 << PID ) ); }
+
+	void AddPlayer( unsigned char PID );
+	void RemovePlayer( unsigned char PID );
+	void AddCheckSum( unsigned char PID, uint32_t frame, uint32_t checkSum );
+	bool GetFrameReady( );
+	bool GetFrameInSync( );
+	uint32_t GetCheckSum( unsigned char PID );
+	bool GetMissing( unsigned char PID );
+	void PopFrame( );
+	void SkipFrame( );
+};
+
+#endif
@@ -0,0 +1,260 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#include "ghost.h"
+#include "timerwheel.h"
+
+//
+// CTimer
+//
+
+CTimer :: CTimer( ) : m_Wheel( NULL ), m_Head( NULL ), m_Prev( NULL ), m_Next( NULL ), m_Deadline( 0 ), m_Expired( false )
+{
+
+}
+
+CTimer :: ~CTimer( )
+{
+	if( m_Wheel )
+		m_Wheel->Cancel( this );
+}
+
+//
+// CTimerWheel
+//
+
+CTimerWheel :: CTimerWheel( ) : m_Now( GetTicks( ) ), m_NumTimers( 0 )
+{
+	for( unsigned int i = 0; i < TIMERWHEEL_LEVELS; ++i )
+	{
+		for( unsigned int j = 0; j < TIMERWHEEL_SLOTS; ++j )
+			m_Slots[i][j] = NULL;
+	}
+}
+
+CTimerWheel :: ~CTimerWheel( )
+{
+	// detach any timers which are still pending so they don't try to cancel themselves on a deleted wheel later
+
+	for( unsigned int i = 0; i < TIMERWHEEL_LEVELS; ++i )
+	{
+		for( unsigned int j = 0; j < TIMERWHEEL_SLOTS; ++j )
+		{
+			while( m_Slots[i][j] )
+				Unlink( m_Slots[i][j] );
+		}
+	}
+}
+
+void CTimerWheel :: Insert( CTimer *timer )
+{
+	// timers which are already due go in the next slot to be processed
+
+	uint32_t Delta = timer->m_Deadline - m_Now;
+
+	if( (int32_t)Delta < 0 )
+	{
+		timer->m_Deadline = m_Now;
+		Delta = 0;
+	}
+
+	// find the lowest level which can hold the deadline
+
+	unsigned int Level = 0;
+
+	while( Level < TIMERWHEEL_LEVELS - 1 && Delta >= ( (uint32_t)1 << ( ( Level + 1 ) * TIMERWHEEL_SLOTBITS ) ) )
+		++Level;
+
+	unsigned int Slot = ( timer->m_Deadline >> ( Level * TIMERWHEEL_SLOTBITS ) ) & ( TIMERWHEEL_SLOTS - 1 );
+	timer->m_Prev = NULL;
+	timer->m_Next = m_Slots[Level][Slot];
+
+	if( timer->m_Next )
+		timer->m_Next->m_Prev = timer;
+
+	m_Slots[Level][Slot] = timer;
+	timer->m_Head = &m_Slots[Level][Slot];
+	timer->m_Wheel = this;
+	++m_NumTimers;
+}
+
+void CTimerWheel :: Unlink( CTimer *timer )
+{
+	if( timer->m_Prev )
+		timer->m_Prev->m_Next = timer->m_Next;
+	else
+		*timer->m_Head = timer->m_Next;
+
+	if( timer->m_Next )
+		timer->m_Next->m_Prev = timer->m_Prev;
+
+	timer->m_Head = NULL;
+	timer->m_Prev = NULL;
+	timer->m_Next = NULL;
+	timer->m_Wheel = NULL;
+	--m_NumTimers;
+}
+
+void CTimerWheel :: Cascade( unsigned int level )
+{
+	// move every timer in the current slot of this level down to a lower level
+
+	unsigned int Slot = ( m_Now >> ( level * TIMERWHEEL_SLOTBITS ) ) & ( TIMERWHEEL_SLOTS - 1 );
+	CTimer *Timer = m_Slots[level][Slot];
+	m_Slots[level][Slot] = NULL;
+
+	while( Timer )
+	{
+		CTimer *Next = Timer->m_Next;
+		--m_NumTimers;
+		Insert( Timer );
+		Timer = Next;
+	}
+}
+
+uint32_t CTimerWheel :: GetNextDeadline( uint32_t ticks, uint32_t maxTicks )
+{
+	// return the GetTicks value at which the next timer expires or ticks + maxTicks if that's sooner
+	// a timer which is already due returns ticks itself
+	// within a level the slots are visited in deadline order so the first non-empty slot of each level holds that level's earliest timer
+
+	if( m_NumTimers == 0 )
+		return ticks + maxTicks;
+
+	uint32_t Ticks = ticks;
+	uint32_t Timeout = maxTicks;
+
+	for( unsigned int i = 0; i < TIMERWHEEL_LEVELS; ++i )
+	{
+		unsigned int Current = ( m_Now >> ( i * TIMERWHEEL_SLOTBITS ) ) & ( TIMERWHEEL_SLOTS - 1 );
+
+		// the current slot of a higher level has already been cascaded unless we're sitting right on its boundary
+		// the last level can hold timers which wrapped around so every slot has to be checked there
+
+		unsigned int First = ( i == 0 || ( m_Now & ( ( (uint32_t)1 << ( i * TIMERWHEEL_SLOTBITS ) ) - 1 ) ) == 0 ) ? 0 : 1;
+
+		for( unsigned int j = First; j < First + TIMERWHEEL_SLOTS; ++j )
+		{
+			CTimer *Timer = m_Slots[i][( Current + j ) & ( TIMERWHEEL_SLOTS - 1 )];
+
+			if( !Timer )
+				continue;
+
+			for( ; Timer; Timer = Timer->m_Next )
+			{
+				uint32_t Remaining = (int32_t)( Timer->m_Deadline - Ticks ) > 0 ? Timer->m_Deadline - Ticks : 0;
+
+				if( Remaining < Timeout )
+					Timeout = Remaining;
+			}
+
+			if( i < TIMERWHEEL_LEVELS - 1 )
+				break;
+		}
+
+		if( Timeout == 0 )
+			break;
+	}
+
+	return Ticks + Timeout;
+}
+
+void CTimerWheel :: Schedule( CTimer *timer, uint32_t ticks )
+{
+	// note: a timer scheduled for a tick which has already been processed expires on the next advance after that tick
+
+	if( timer->m_Wheel )
+		timer->m_Wheel->Cancel( timer );
+
+	timer->m_Deadline = GetTicks( ) + ticks;
+	timer->m_Expired = false;
+	Insert( timer );
+}
+
+void CTimerWheel :: Cancel( CTimer *timer )
+{
+	if( timer->m_Wheel == this )
+		Unlink( timer );
+}
+
+uint32_t CTimerWheel :: Advance( )
+{
+	// process every tick up to and including now, expiring the timers in each slot as we go
+	// returns the number of timers which expired
+
+	uint32_t Ticks = GetTicks( );
+	uint32_t Expired = 0;
+
+	if( m_NumTimers == 0 )
+	{
+		m_Now = Ticks + 1;
+		return 0;
+	}
+
+	while( (int32_t)( Ticks - m_Now ) >= 0 )
+	{
+		unsigned int Slot = m_Now & ( TIMERWHEEL_SLOTS - 1 );
+
+		// when the first level wraps around pull the next slot of the higher levels down
+
+		for( unsigned int i = 1; i < TIMERWHEEL_LEVELS && Slot == 0; ++i )
+		{
+			Cascade( i );
+			Slot = ( m_Now >> ( i * TIMERWHEEL_SLOTBITS ) ) & ( TIMERWHEEL_SLOTS - 1 );
+		}
+
+		Slot = m_Now & ( TIMERWHEEL_SLOTS - 1 );
+
+		while( m_Slots[0][Slot] )
+		{
+			CTimer *Timer = m_Slots[0][Slot];
+			Unlink( Timer );
+			Timer->m_Expired = true;
+			++Expired;
+		}
+
+		++m_Now;
+
+		if( m_NumTimers == 0 )
+		{
+			m_Now = Ticks + 1;
+			break;
+		}
+	}
+
+	return Expired;
+}
+
+uint32_t CTimerWheel :: TicksUntil( uint32_t ticks, uint32_t interval )
+{
+	uint32_t Elapsed = GetTicks( ) - ticks;
+
+	if( Elapsed >= interval )
+		return TIMERWHEEL_OVERDUE;
+	else
+		return interval - Elapsed;
+}
+
+uint32_t CTimerWheel :: TicksUntilTime( uint32_t time, uint32_t interval )
+{
+	// GetTime is GetTicks / 1000 so "GetTime( ) - time >= interval" becomes true exactly when GetTicks reaches ( time + interval ) * 1000
+
+	return TicksUntil( time * 1000, interval * 1000 );
+}
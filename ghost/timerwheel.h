@@ -0,0 +1,98 @@
+/*
+
+   Copyright [2008] [Trevor Hogan]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+*/
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#define TIMERWHEEL_LEVELS		4
+#define TIMERWHEEL_SLOTBITS		6
+#define TIMERWHEEL_SLOTS		( 1 << TIMERWHEEL_SLOTBITS )
+#define TIMERWHEEL_OVERDUE		50
+
+class CTimerWheel;
+
+//
+// CTimer
+//
+
+// a deadline registered with a timer wheel
+// the owner embeds the timer and checks GetExpired after the wheel has been advanced, there are no callbacks
+
+class CTimer
+{
+	friend class CTimerWheel;
+
+protected:
+	CTimerWheel *m_Wheel;					// the wheel this timer is scheduled on, NULL if it isn't pending
+	CTimer **m_Head;						// the head of the slot this timer is linked into
+	CTimer *m_Prev;
+	CTimer *m_Next;
+	uint32_t m_Deadline;					// GetTicks when the timer expires
+	bool m_Expired;							// set by the wheel when the deadline passes, cleared when the timer is scheduled again
+
+public:
+	CTimer( );
+	~CTimer( );
+
+	bool GetPending( )						{ return m_Wheel != NULL; }
+	bool GetExpired( )						{ return m_Expired; }
+	uint32_t GetDeadline( )					{ return m_Deadline; }
+	void ClearExpired( )					{ m_Expired = false; }
+};
+
+//
+// CTimerWheel
+//
+
+// a hierarchical timing wheel with a resolution of 1ms
+// there are four levels of 64 slots each covering 64ms, 4s, 4.5m and 4.6h respectively
+// scheduling and cancelling a timer is O(1) and advancing the wheel only touches the slots which passed since the last advance
+// timers further out than the last level are parked in the last level and cascaded down again when their slot comes up
+// warning: the wheel isn't thread safe, it must only be used by the thread which owns it
+
+class CTimerWheel
+{
+protected:
+	CTimer *m_Slots[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS];
+	uint32_t m_Now;							// the next tick to be processed, every tick before this has been processed
+	uint32_t m_NumTimers;					// number of pending timers
+
+	void Insert( CTimer *timer );
+	void Unlink( CTimer *timer );
+	void Cascade( unsigned int level );
+
+public:
+	CTimerWheel( );
+	~CTimerWheel( );
+
+	uint32_t GetNumTimers( )				{ return m_NumTimers; }
+	uint32_t GetNextDeadline( uint32_t ticks, uint32_t maxTicks );
+	void Schedule( CTimer *timer, uint32_t ticks );
+	void Cancel( CTimer *timer );
+	uint32_t Advance( );
+
+	// helpers for turning the "GetTicks( ) - m_LastSomethingTicks >= interval" style timers used everywhere into deadlines
+	// a timer which is already overdue wasn't necessarily reset by the code handling it so it's polled every TIMERWHEEL_OVERDUE ms (like the old game loop did) instead of immediately
+
+	static uint32_t TicksUntil( uint32_t ticks, uint32_t interval );
+	static uint32_t TicksUntilTime( uint32_t time, uint32_t interval );
+};
+
+#endif